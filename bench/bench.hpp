@@ -0,0 +1,102 @@
+#ifndef ORMPP_BENCH_HPP
+#define ORMPP_BENCH_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ormpp::bench {
+
+// Incremented by the replaced global operator new in bench_ormpp.cpp.
+inline std::atomic<uint64_t> alloc_count{0};
+
+struct options {
+  size_t iterations = 10000;
+  size_t warmup = 100;
+  std::string filter;
+};
+
+struct result {
+  std::string name;
+  size_t iterations = 0;
+  double ops_per_sec = 0;
+  double p50_us = 0;
+  double p99_us = 0;
+  double allocs_per_op = 0;
+};
+
+inline double percentile(std::vector<double> &samples, double pct) {
+  if (samples.empty()) {
+    return 0;
+  }
+  size_t idx = static_cast<size_t>(pct * (samples.size() - 1));
+  std::nth_element(samples.begin(), samples.begin() + idx, samples.end());
+  return samples[idx];
+}
+
+inline void print_header() {
+  std::printf("%-44s %10s %14s %10s %10s %12s\n", "benchmark", "iters",
+              "ops/sec", "p50(us)", "p99(us)", "allocs/op");
+}
+
+inline void print(const result &r) {
+  std::printf("%-44s %10zu %14.0f %10.2f %10.2f %12.2f\n", r.name.data(),
+              r.iterations, r.ops_per_sec, r.p50_us, r.p99_us,
+              r.allocs_per_op);
+  std::fflush(stdout);
+}
+
+// Runs fn once per iteration after a warmup phase; every call is timed on its
+// own so that the tail latency is visible next to the throughput.
+template <typename F>
+inline bool run(const options &opt, std::string_view name, F &&fn,
+                size_t iterations = 0) {
+  if (!opt.filter.empty() && name.find(opt.filter) == std::string_view::npos) {
+    return false;
+  }
+
+  if (iterations == 0) {
+    iterations = opt.iterations;
+  }
+
+  for (size_t i = 0; i < opt.warmup; ++i) {
+    fn(i);
+  }
+
+  std::vector<double> samples;
+  samples.reserve(iterations);
+
+  using clock = std::chrono::steady_clock;
+  uint64_t allocs_before = alloc_count.load(std::memory_order_relaxed);
+  auto begin = clock::now();
+  for (size_t i = 0; i < iterations; ++i) {
+    auto start = clock::now();
+    fn(i);
+    samples.push_back(
+        std::chrono::duration<double, std::micro>(clock::now() - start)
+            .count());
+  }
+  double total = std::chrono::duration<double>(clock::now() - begin).count();
+  uint64_t allocs =
+      alloc_count.load(std::memory_order_relaxed) - allocs_before;
+
+  result r;
+  r.name = name;
+  r.iterations = iterations;
+  r.ops_per_sec = total > 0 ? iterations / total : 0;
+  r.allocs_per_op = static_cast<double>(allocs) / iterations;
+  r.p50_us = percentile(samples, 0.50);
+  r.p99_us = percentile(samples, 0.99);
+  print(r);
+  return true;
+}
+
+}  // namespace ormpp::bench
+
+#endif  // ORMPP_BENCH_HPP
@@ -0,0 +1,329 @@
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifdef ORMPP_ENABLE_MYSQL
+#include "mysql.hpp"
+#endif
+
+#ifdef ORMPP_ENABLE_SQLITE3
+#include "sqlite.hpp"
+#endif
+
+#ifdef ORMPP_ENABLE_PG
+#include "postgresql.hpp"
+#endif
+
+#ifdef ORMPP_ENABLE_MYSQL_ASYNC
+#include <asio.hpp>
+#include <future>
+#include <thread>
+
+#include "async_connection_pool.hpp"
+#include "mysql_async.hpp"
+#endif
+
+#include "bench.hpp"
+#include "connection_pool.hpp"
+#include "dbng.hpp"
+#include "ormpp_cfg.hpp"
+
+// Count every heap allocation so that allocs/op can be reported. The
+// deletes are kept out of line, inlined into the callers gcc pairs the
+// free() with the standard operator new and warns (-Wmismatched-new-delete).
+#if defined(__GNUC__)
+#define ORMPP_BENCH_NOINLINE __attribute__((noinline))
+#else
+#define ORMPP_BENCH_NOINLINE
+#endif
+
+void *operator new(std::size_t size) {
+  ormpp::bench::alloc_count.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+ORMPP_BENCH_NOINLINE void operator delete(void *p) noexcept { std::free(p); }
+
+ORMPP_BENCH_NOINLINE void operator delete(void *p, std::size_t) noexcept {
+  std::free(p);
+}
+
+using namespace ormpp;
+using namespace ormpp::bench;
+
+struct bench_person {
+  int id;
+  std::string name;
+  int age;
+  double score;
+};
+REGISTER_AUTO_KEY(bench_person, id)
+
+namespace {
+
+constexpr size_t batch_size = 100;
+constexpr size_t table_rows = 1000;
+
+ormpp_cfg load_config() {
+  ormpp_cfg cfg{"127.0.0.1", "root", "", "test_ormppdb", 5, 4, 3306};
+  for (auto path :
+       {"../cfg/ormpp.cfg", "cfg/ormpp.cfg", "../../cfg/ormpp.cfg"}) {
+    if (config_manager::from_file(cfg, path)) {
+      break;
+    }
+  }
+
+  if (auto host = std::getenv("ORMPP_BENCH_HOST")) {
+    cfg.db_ip = host;
+  }
+  if (auto user = std::getenv("ORMPP_BENCH_USER")) {
+    cfg.user_name = user;
+  }
+  if (auto pwd = std::getenv("ORMPP_BENCH_PASSWORD")) {
+    cfg.pwd = pwd;
+  }
+  if (auto db = std::getenv("ORMPP_BENCH_DB")) {
+    cfg.db_name = db;
+  }
+  return cfg;
+}
+
+// only the server backends take a port
+#if defined(ORMPP_ENABLE_MYSQL) || defined(ORMPP_ENABLE_PG) || \
+    defined(ORMPP_ENABLE_MYSQL_ASYNC)
+int env_port(const char *key, int def) {
+  auto val = std::getenv(key);
+  return val ? std::atoi(val) : def;
+}
+#endif
+
+bench_person make_person(size_t i) {
+  return bench_person{0, "person_" + std::to_string(i % 97),
+                      static_cast<int>(i % 100), 1.5 * (i % 10)};
+}
+
+template <typename DB>
+void reset_table(dbng<DB> &db) {
+  db.execute("drop table if exists bench_person");
+  db.template create_datatable<bench_person>(ormpp_auto_key{"id"});
+}
+
+template <typename DB>
+void seed_table(dbng<DB> &db) {
+  std::vector<bench_person> v;
+  v.reserve(table_rows);
+  for (size_t i = 0; i < table_rows; ++i) {
+    v.push_back(make_person(i));
+  }
+  db.insert(v);
+}
+
+// Benchmarks shared by every synchronous backend, the label prefixes each
+// benchmark name so that runs of different backends can be diffed.
+template <typename DB>
+void bench_crud(const options &opt, const std::string &label, dbng<DB> &db) {
+  reset_table(db);
+  run(opt, label + " insert", [&](size_t i) { db.insert(make_person(i)); });
+
+  reset_table(db);
+  std::vector<bench_person> batch;
+  batch.reserve(batch_size);
+  for (size_t i = 0; i < batch_size; ++i) {
+    batch.push_back(make_person(i));
+  }
+  run(
+      opt, label + " insert vector(100)",
+      [&](size_t) { db.insert(batch); },
+      std::max<size_t>(opt.iterations / batch_size, 1));
+
+  reset_table(db);
+  seed_table(db);
+  run(opt, label + " query_s by id", [&](size_t i) {
+    auto v = db.template query_s<bench_person>(
+        "id=?", static_cast<int>(i % table_rows) + 1);
+  });
+
+  run(
+      opt, label + " query_s limit 100",
+      [&](size_t) {
+        auto v = db.template query_s<bench_person>("limit 100");
+      },
+      std::max<size_t>(opt.iterations / 10, 1));
+
+  run(opt, label + " builder collect", [&](size_t i) {
+    auto v = db.select(all)
+                 .template from<bench_person>()
+                 .where(col(&bench_person::id) == static_cast<int>(i % 100))
+                 .collect();
+  });
+
+  db.execute("drop table if exists bench_person");
+}
+
+template <typename DB>
+void bench_pool(const options &opt, const std::string &label,
+                connection_pool<dbng<DB>> &pool) {
+  run(opt, label + " connection_pool::get", [&](size_t) {
+    auto conn = pool.get();
+  });
+}
+
+#ifdef ORMPP_ENABLE_SQLITE3
+void bench_builder(const options &opt, dbng<sqlite> &db) {
+  run(opt, "builder where to_sql", [](size_t i) {
+    auto sql = (col(&bench_person::age) > static_cast<int>(i % 100) &&
+                col(&bench_person::name).like("person_%"))
+                   .to_sql();
+  });
+
+  run(opt, "builder select/where/order/limit", [&](size_t i) {
+    auto q = db.select(col(&bench_person::id), col(&bench_person::name))
+                 .from<bench_person>()
+                 .where(col(&bench_person::age) > static_cast<int>(i % 100))
+                 .order_by(col(&bench_person::id).desc())
+                 .limit(10);
+  });
+
+  run(opt, "generate_insert_sql", [](size_t) {
+    auto sql = generate_insert_sql<bench_person>(DBType::sqlite, true);
+  });
+}
+
+void bench_sqlite(const options &opt) {
+  dbng<sqlite> db;
+  if (!db.connect(":memory:")) {
+    std::cout << "sqlite: connect failed, skipped\n";
+    return;
+  }
+  bench_builder(opt, db);
+  bench_crud(opt, "sqlite", db);
+
+  auto &pool = connection_pool<dbng<sqlite>>::instance();
+  pool.init(4, "", "", "", ":memory:");
+  bench_pool(opt, "sqlite", pool);
+}
+#endif
+
+#ifdef ORMPP_ENABLE_MYSQL
+void bench_mysql(const options &opt, const ormpp_cfg &cfg) {
+  int port = env_port("ORMPP_BENCH_MYSQL_PORT", cfg.db_port);
+  dbng<mysql> db;
+  if (!db.connect(cfg.db_ip, cfg.user_name, cfg.pwd, cfg.db_name, cfg.timeout,
+                  port)) {
+    std::cout << "mysql: not available, skipped\n";
+    return;
+  }
+  bench_crud(opt, "mysql", db);
+
+  auto &pool = connection_pool<dbng<mysql>>::instance();
+  pool.init(4, cfg.db_ip, cfg.user_name, cfg.pwd, cfg.db_name, cfg.timeout,
+            port);
+  bench_pool(opt, "mysql", pool);
+}
+#endif
+
+#ifdef ORMPP_ENABLE_PG
+void bench_postgresql(const options &opt, const ormpp_cfg &cfg) {
+  int port = env_port("ORMPP_BENCH_PG_PORT", 5432);
+  dbng<postgresql> db;
+  if (!db.connect(cfg.db_ip, cfg.user_name, cfg.pwd, cfg.db_name, cfg.timeout,
+                  port)) {
+    std::cout << "postgresql: not available, skipped\n";
+    return;
+  }
+  bench_crud(opt, "postgresql", db);
+
+  auto &pool = connection_pool<dbng<postgresql>>::instance();
+  pool.init(4, cfg.db_ip, cfg.user_name, cfg.pwd, cfg.db_name, cfg.timeout,
+            port);
+  bench_pool(opt, "postgresql", pool);
+}
+#endif
+
+#ifdef ORMPP_ENABLE_MYSQL_ASYNC
+// The pool lives on its own io_context thread, every sample therefore also
+// includes the hop from the benchmark thread to the pool strand and back.
+void bench_async_pool(const options &opt, const ormpp_cfg &cfg) {
+  int port = env_port("ORMPP_BENCH_MYSQL_PORT", cfg.db_port);
+  asio::io_context ctx;
+  auto guard = asio::make_work_guard(ctx);
+  std::thread thd([&ctx] {
+    ctx.run();
+  });
+
+  auto pool =
+      std::make_shared<async_connection_pool<mysql_async>>(ctx.get_executor());
+  bool ok = asio::co_spawn(ctx,
+                           pool->init(4, cfg.db_ip, cfg.user_name, cfg.pwd,
+                                      cfg.db_name, cfg.timeout, port),
+                           asio::use_future)
+                .get();
+  if (ok) {
+    run(opt, "mysql_async async_connection_pool::get", [&](size_t) {
+      asio::co_spawn(
+          ctx,
+          [pool]() -> asio::awaitable<void> {
+            auto conn = co_await pool->get();
+          },
+          asio::use_future)
+          .get();
+    });
+    asio::co_spawn(ctx, pool->close_all(), asio::use_future).get();
+  }
+  else {
+    std::cout << "mysql_async: not available, skipped\n";
+  }
+
+  guard.reset();
+  thd.join();
+}
+#endif
+
+options parse_options(int argc, char **argv) {
+  options opt;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    if (arg == "--iterations" && i + 1 < argc) {
+      opt.iterations = std::max(std::atoi(argv[++i]), 1);
+    }
+    else if (arg == "--warmup" && i + 1 < argc) {
+      opt.warmup = std::max(std::atoi(argv[++i]), 0);
+    }
+    else if (arg == "--filter" && i + 1 < argc) {
+      opt.filter = argv[++i];
+    }
+    else {
+      std::cout << "usage: " << argv[0]
+                << " [--iterations n] [--warmup n] [--filter substr]\n";
+      std::exit(arg == "--help" ? 0 : 1);
+    }
+  }
+  return opt;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  auto opt = parse_options(argc, argv);
+  [[maybe_unused]] auto cfg = load_config();
+
+  print_header();
+#ifdef ORMPP_ENABLE_SQLITE3
+  bench_sqlite(opt);
+#endif
+#ifdef ORMPP_ENABLE_MYSQL
+  bench_mysql(opt, cfg);
+#endif
+#ifdef ORMPP_ENABLE_PG
+  bench_postgresql(opt, cfg);
+#endif
+#ifdef ORMPP_ENABLE_MYSQL_ASYNC
+  bench_async_pool(opt, cfg);
+#endif
+  return 0;
+}
@@ -91,8 +91,15 @@ if(ENABLE_LOG)
     add_definitions(-DORMPP_ENABLE_LOG)
 endif()
 
+# per statement tracing hooks, see ormpp/query_trace.hpp
+option(ENABLE_TRACE "Enable query tracing hooks" OFF)
+if(ENABLE_TRACE)
+    add_definitions(-DORMPP_ENABLE_TRACE)
+endif()
+
 option(ENABLE_MYSQL_ASYNC "Enable standalone Asio based mysql async client" OFF)
-if (ENABLE_MYSQL_ASYNC)
+option(ENABLE_SQLITE_ASYNC "Enable standalone Asio based sqlite async engine" OFF)
+if (ENABLE_MYSQL_ASYNC OR ENABLE_SQLITE_ASYNC)
     set(ORMPP_ASIO_INCLUDE_DIR "" CACHE PATH "Path to standalone Asio include directory")
 
     # Try to find Asio from various sources
@@ -123,21 +130,30 @@ if (ENABLE_MYSQL_ASYNC)
     if (ORMPP_ASIO_INCLUDE_DIR)
         include_directories(${ORMPP_ASIO_INCLUDE_DIR})
 
-        # Find OpenSSL (required for async MySQL)
-        find_package(OpenSSL QUIET)
-        if (OpenSSL_FOUND)
-            include_directories(${OpenSSL_INCLUDE_DIRS})
-            add_definitions(-DORMPP_ENABLE_MYSQL_ASYNC)
-            message(STATUS "ENABLE_MYSQL_ASYNC: ON")
+        # sqlite async only needs Asio, the database itself is bundled
+        if (ENABLE_SQLITE_ASYNC)
+            add_definitions(-DORMPP_ENABLE_SQLITE_ASYNC)
+            message(STATUS "ENABLE_SQLITE_ASYNC: ON")
             message(STATUS "  Asio include: ${ORMPP_ASIO_INCLUDE_DIR}")
-            message(STATUS "  OpenSSL include: ${OpenSSL_INCLUDE_DIRS}")
-        else()
-            message(WARNING "ENABLE_MYSQL_ASYNC is ON but OpenSSL was not found. MySQL async will be disabled.")
-            message(STATUS "ENABLE_MYSQL_ASYNC: OFF (OpenSSL not found)")
+        endif()
+
+        # Find OpenSSL (required for async MySQL)
+        if (ENABLE_MYSQL_ASYNC)
+            find_package(OpenSSL QUIET)
+            if (OpenSSL_FOUND)
+                include_directories(${OpenSSL_INCLUDE_DIRS})
+                add_definitions(-DORMPP_ENABLE_MYSQL_ASYNC)
+                message(STATUS "ENABLE_MYSQL_ASYNC: ON")
+                message(STATUS "  Asio include: ${ORMPP_ASIO_INCLUDE_DIR}")
+                message(STATUS "  OpenSSL include: ${OpenSSL_INCLUDE_DIRS}")
+            else()
+                message(WARNING "ENABLE_MYSQL_ASYNC is ON but OpenSSL was not found. MySQL async will be disabled.")
+                message(STATUS "ENABLE_MYSQL_ASYNC: OFF (OpenSSL not found)")
+            endif()
         endif()
     else()
-        message(WARNING "ENABLE_MYSQL_ASYNC is ON but Asio headers were not found. MySQL async will be disabled.")
-        message(STATUS "ENABLE_MYSQL_ASYNC: OFF (Asio not found)")
+        message(WARNING "ENABLE_MYSQL_ASYNC or ENABLE_SQLITE_ASYNC is ON but Asio headers were not found. Async engines will be disabled.")
+        message(STATUS "Async engines: OFF (Asio not found)")
         message(STATUS "  You can install Asio via:")
         message(STATUS "    - Ubuntu/Debian: sudo apt-get install libasio-dev")
         message(STATUS "    - macOS: brew install asio")
@@ -5,8 +5,10 @@
 #include <asio/bind_executor.hpp>
 #include <asio/co_spawn.hpp>
 #include <asio/detached.hpp>
+#include <asio/error_code.hpp>
 #include <asio/post.hpp>
 #include <asio/strand.hpp>
+#include <asio/system_error.hpp>
 #include <atomic>
 #include <coroutine>
 #include <exception>
@@ -507,4 +509,66 @@ inline auto from_asio_safe(asio::awaitable<T, asio::any_io_executor> awaitable,
   return SafeAsioAwaitableAdapter<T>(std::move(awaitable), std::move(executor));
 }
 
+// Native awaiter for a single asio asynchronous operation, for coroutines which
+// are not asio::awaitable (async_simple::coro::Lazy).
+//
+// init(handler) starts the operation and its completion handler resumes the
+// awaiting coroutine inline, on the thread running the io object's executor.
+// Nothing is allocated besides the handler storage asio recycles, and there is
+// no strand, spawned coroutine or executor hop, which makes it suitable for
+// the per packet reads and writes of a protocol engine. R is the value passed
+// to the handler after the error code (void for none). A failed operation
+// throws asio::system_error, like asio::use_awaitable.
+//
+// The awaiting coroutine must stay alive until the operation completes, close
+// the io object to make it complete early.
+template <typename R, typename Init>
+class AsioOperationAwaiter {
+ private:
+  using stored_type = std::conditional_t<std::is_void_v<R>, std::monostate, R>;
+
+  Init init_;
+  asio::error_code ec_;
+  std::optional<stored_type> result_;
+
+ public:
+  explicit AsioOperationAwaiter(Init init) : init_(std::move(init)) {}
+
+  bool await_ready() const noexcept { return false; }
+
+  void await_suspend(std::coroutine_handle<> handle) {
+    if constexpr (std::is_void_v<R>) {
+      init_([this, handle](const asio::error_code& ec) {
+        ec_ = ec;
+        handle.resume();
+      });
+    }
+    else {
+      init_([this, handle](const asio::error_code& ec, R result) {
+        ec_ = ec;
+        result_.emplace(std::move(result));
+        handle.resume();
+      });
+    }
+  }
+
+  R await_resume() {
+    if (ec_) {
+      throw asio::system_error(ec_);
+    }
+    if constexpr (!std::is_void_v<R>) {
+      return std::move(*result_);
+    }
+  }
+
+  auto coAwait([[maybe_unused]] async_simple::Executor* executor) noexcept {
+    return std::move(*this);
+  }
+};
+
+template <typename R, typename Init>
+inline auto async_op(Init init) {
+  return AsioOperationAwaiter<R, Init>(std::move(init));
+}
+
 }  // namespace adapter
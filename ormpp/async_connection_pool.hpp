@@ -13,8 +13,11 @@
 #include <string>
 #include <tuple>
 #include <utility>
+#include <vector>
 
 #include "async_traits.hpp"
+#include "async_transaction.hpp"
+#include "db_error.hpp"
 
 namespace ormpp {
 
@@ -24,6 +27,17 @@ struct pool_options {
       false;  // Allow temporary connections when pool is full
   size_t max_dynamic_connections = 10;  // Max temporary connections
   bool log_pool_exhaustion = true;      // Log when pool is exhausted
+
+  // Background maintenance, disabled when zero. Idle connections are pinged
+  // every health_check_interval instead of on checkout, so get() is a plain
+  // pop of a connection known to be alive.
+  std::chrono::seconds health_check_interval{0};
+  // Idle connections older than this are closed by the maintenance, zero
+  // keeps them forever. Needs health_check_interval.
+  std::chrono::seconds max_idle_time{0};
+  // The maintenance never closes idle connections below this count and
+  // connects replacements for failed or closed ones up to it.
+  size_t min_connections = 0;
 };
 
 // Async connection pool for databases that support async operations
@@ -38,7 +52,10 @@ class async_connection_pool
 
   explicit async_connection_pool(executor_type executor,
                                  pool_options options = {})
-      : executor_(std::move(executor)), strand_(executor_), options_(options) {}
+      : executor_(std::move(executor)),
+        strand_(executor_),
+        options_(options),
+        maintenance_timer_(std::make_shared<asio::steady_timer>(executor_)) {}
 
   // Destructor - automatically cleanup connections
   ~async_connection_pool() {
@@ -50,6 +67,8 @@ class async_connection_pool
                   << std::endl;
       }
     }
+    // wakes the maintenance up, it finds the pool gone and stops
+    maintenance_timer_->cancel();
     available_connections_.clear();
   }
 
@@ -80,6 +99,7 @@ class async_connection_pool
     database_ = db;
     timeout_ = timeout;
     port_ = port;
+    open_count_ = 0;
 
     // Create initial connections
     for (size_t i = 0; i < pool_size_; ++i) {
@@ -92,13 +112,69 @@ class async_connection_pool
         co_return false;
       }
 
-      available_connections_.push_back(std::move(conn));
+      add_idle(std::move(conn));
+      ++open_count_;
     }
 
     initialized_ = true;
+    if (options_.health_check_interval.count() > 0 && !maintaining_) {
+      maintaining_ = true;
+      asio::co_spawn(executor_, maintain(this->weak_from_this()),
+                     asio::detached);
+    }
     co_return true;
   }
 
+  // Get an available connection without waiting, nullptr when none is idle.
+  // Dynamic expansion is left to get().
+  awaitable<std::shared_ptr<DB>> try_get() {
+    // Try to get an available connection (thread-safe via strand)
+    co_await asio::post(strand_, asio::use_awaitable);
+
+    while (initialized_ && !closing_ && !available_connections_.empty()) {
+      // most recently returned first, the others stay idle and are the ones
+      // the maintenance checks and reaps
+      auto connection = std::move(available_connections_.back().connection);
+      available_connections_.pop_back();
+      in_use_count_++;
+
+      if (maintenance_enabled()) {
+        co_return make_connection_handle(std::move(connection), false);
+      }
+
+      // Verify connection is still alive
+      bool alive = co_await connection->ping();
+      if (!alive) {
+        // Reconnect
+        alive = co_await connection->connect(host_, user_, passwd_, database_,
+                                             timeout_, port_);
+        if (!alive) {
+          co_await asio::post(strand_, asio::use_awaitable);
+          if (in_use_count_ > 0) {
+            --in_use_count_;
+          }
+          drop_open();
+          co_await connection->disconnect();
+          continue;
+        }
+      }
+
+      co_await asio::post(strand_, asio::use_awaitable);
+      if (!initialized_ || closing_) {
+        if (in_use_count_ > 0) {
+          --in_use_count_;
+        }
+        drop_open();
+        co_await connection->disconnect();
+        co_return nullptr;
+      }
+
+      co_return make_connection_handle(std::move(connection), false);
+    }
+
+    co_return nullptr;
+  }
+
   // Get a connection from the pool (with timeout)
   // Returns a shared_ptr with custom deleter that automatically returns
   // connection to pool
@@ -108,44 +184,19 @@ class async_connection_pool
     size_t wait_count = 0;
 
     while (std::chrono::steady_clock::now() < deadline) {
-      // Try to get an available connection (thread-safe via strand)
-      co_await asio::post(strand_, asio::use_awaitable);
-
+      auto connection = co_await try_get();
+      if (connection) {
+        co_return connection;
+      }
       if (!initialized_ || closing_) {
         co_return nullptr;
       }
 
-      if (!available_connections_.empty()) {
-        auto connection = std::move(available_connections_.front());
-        available_connections_.pop_front();
-        in_use_count_++;
-
-        // Verify connection is still alive
-        bool alive = co_await connection->ping();
-        if (!alive) {
-          // Reconnect
-          alive = co_await connection->connect(host_, user_, passwd_, database_,
-                                               timeout_, port_);
-          if (!alive) {
-            co_await asio::post(strand_, asio::use_awaitable);
-            if (in_use_count_ > 0) {
-              --in_use_count_;
-            }
-            co_await connection->disconnect();
-            continue;
-          }
-        }
-
-        co_await asio::post(strand_, asio::use_awaitable);
-        if (!initialized_ || closing_) {
-          if (in_use_count_ > 0) {
-            --in_use_count_;
-          }
-          co_await connection->disconnect();
-          continue;
-        }
-
-        co_return make_connection_handle(std::move(connection), false);
+      // Below pool size after failures or idle reaping, connect a
+      // replacement instead of waiting
+      connection = co_await create_replacement_connection();
+      if (connection) {
+        co_return connection;
       }
 
       // Pool is exhausted
@@ -191,6 +242,15 @@ class async_connection_pool
     co_return nullptr;
   }
 
+  // Get a connection and start a transaction pinned to it, empty when no
+  // connection could be had or BEGIN failed. See async_transaction.
+  awaitable<async_transaction<DB>> transaction(
+      std::chrono::seconds timeout = std::chrono::seconds(10)) {
+    auto connection = co_await get(timeout);
+    auto op = async_transaction<DB>::begin(std::move(connection));
+    co_return co_await std::move(op);
+  }
+
   // Get pool statistics
   // Returns: (pool_size, available, in_use, dynamic_count)
   awaitable<std::tuple<size_t, size_t, size_t, size_t>> get_stats() {
@@ -266,10 +326,13 @@ class async_connection_pool
 
     co_await asio::post(strand_, asio::use_awaitable);
 
+    maintenance_timer_->cancel();
+
     // Disconnect all available connections
-    for (auto& conn : available_connections_) {
-      co_await conn->disconnect();
+    for (auto& idle : available_connections_) {
+      co_await idle.connection->disconnect();
     }
+    open_count_ -= (std::min)(open_count_, available_connections_.size());
     available_connections_.clear();
 
     initialized_ = false;
@@ -281,6 +344,45 @@ class async_connection_pool
   }
 
  private:
+  struct idle_connection {
+    std::unique_ptr<DB> connection;
+    std::chrono::steady_clock::time_point since;
+  };
+
+  bool maintenance_enabled() const {
+    return options_.health_check_interval.count() > 0;
+  }
+
+  void add_idle(std::unique_ptr<DB> connection) {
+    auto now = std::chrono::steady_clock::now();
+    available_connections_.push_back(
+        idle_connection{std::move(connection), now});
+  }
+
+  // A connection whose last call lost the link or the protocol state, or
+  // which was closed (a timed out statement), is not pooled again. get()
+  // connects a replacement.
+  static bool is_broken(const DB& connection) {
+    if constexpr (requires { connection.is_open(); }) {
+      if (!connection.is_open()) {
+        return true;
+      }
+    }
+    if constexpr (requires { connection.get_error(); }) {
+      auto code = connection.get_error().code;
+      return code == db_errc::connection || code == db_errc::protocol;
+    }
+    else {
+      return false;
+    }
+  }
+
+  void drop_open() {
+    if (open_count_ > 0) {
+      --open_count_;
+    }
+  }
+
   std::shared_ptr<DB> make_connection_handle(std::unique_ptr<DB> connection,
                                              bool dynamic) {
     auto raw = connection.release();
@@ -323,16 +425,152 @@ class async_connection_pool
       --in_use_count_;
     }
 
-    if (initialized_ && !closing_) {
-      available_connections_.push_back(std::move(connection));
+    if (initialized_ && !closing_ && !is_broken(*connection)) {
+      add_idle(std::move(connection));
+    }
+    else {
+      drop_open();
     }
   }
 
   awaitable<void> disconnect_available_connections() {
-    for (auto& conn : available_connections_) {
-      co_await conn->disconnect();
+    for (auto& idle : available_connections_) {
+      co_await idle.connection->disconnect();
     }
     available_connections_.clear();
+    open_count_ = 0;
+  }
+
+  // Connect a pooled (not dynamic) connection when fewer than pool_size are
+  // open, nullptr otherwise
+  awaitable<std::shared_ptr<DB>> create_replacement_connection() {
+    co_await asio::post(strand_, asio::use_awaitable);
+    if (!initialized_ || closing_ || open_count_ >= pool_size_) {
+      co_return nullptr;
+    }
+    ++open_count_;
+    in_use_count_++;
+
+    auto conn = std::make_unique<DB>(executor_);
+    bool connected = co_await conn->connect(host_, user_, passwd_, database_,
+                                            timeout_, port_);
+    co_await asio::post(strand_, asio::use_awaitable);
+    if (!connected || !initialized_ || closing_) {
+      drop_open();
+      if (in_use_count_ > 0) {
+        --in_use_count_;
+      }
+      if (connected) {
+        co_await conn->disconnect();
+      }
+      co_return nullptr;
+    }
+
+    co_return make_connection_handle(std::move(conn), false);
+  }
+
+  // Runs maintenance_pass every health_check_interval until the pool is
+  // closed or destroyed. Only the timer is kept alive while sleeping.
+  static awaitable<void> maintain(
+      std::weak_ptr<async_connection_pool> weak_pool) {
+    for (;;) {
+      std::shared_ptr<asio::steady_timer> timer;
+      if (auto pool = weak_pool.lock()) {
+        co_await asio::post(pool->strand_, asio::use_awaitable);
+        if (!pool->initialized_ || pool->closing_) {
+          pool->maintaining_ = false;
+          co_return;
+        }
+        timer = pool->maintenance_timer_;
+        timer->expires_after(pool->options_.health_check_interval);
+      }
+      else {
+        co_return;
+      }
+
+      asio::error_code ec;
+      co_await timer->async_wait(asio::redirect_error(asio::use_awaitable, ec));
+
+      auto pool = weak_pool.lock();
+      if (!pool) {
+        co_return;
+      }
+      co_await pool->maintenance_pass();
+    }
+  }
+
+  // Closes idle connections past max_idle_time (keeping min_connections),
+  // pings the ones idle for a whole interval and connects replacements up to
+  // min_connections.
+  awaitable<void> maintenance_pass() {
+    co_await asio::post(strand_, asio::use_awaitable);
+    if (!initialized_ || closing_) {
+      co_return;
+    }
+
+    // the deque is ordered by return time, the stale ones are at the front;
+    // while they are checked, checkouts are served by the others
+    auto now = std::chrono::steady_clock::now();
+    auto cutoff = now - options_.health_check_interval;
+    std::vector<idle_connection> stale;
+    while (!available_connections_.empty() &&
+           available_connections_.front().since <= cutoff) {
+      stale.push_back(std::move(available_connections_.front()));
+      available_connections_.pop_front();
+    }
+
+    std::vector<idle_connection> alive;
+    for (auto& idle : stale) {
+      bool expired = options_.max_idle_time.count() > 0 &&
+                     now - idle.since >= options_.max_idle_time &&
+                     open_count_ > options_.min_connections;
+      bool keep = !expired;
+      if (keep) {
+        keep = co_await idle.connection->ping();
+        // the ping may complete on another thread, the pool state below and
+        // in the next iteration is only touched on the strand
+        co_await asio::post(strand_, asio::use_awaitable);
+      }
+      if (keep) {
+        alive.push_back(std::move(idle));
+        continue;
+      }
+      drop_open();
+      co_await idle.connection->disconnect();
+      co_await asio::post(strand_, asio::use_awaitable);
+    }
+
+    if (!initialized_ || closing_) {
+      for (auto& idle : alive) {
+        drop_open();
+        co_await idle.connection->disconnect();
+        co_await asio::post(strand_, asio::use_awaitable);
+      }
+      co_return;
+    }
+    available_connections_.insert(available_connections_.begin(),
+                                  std::make_move_iterator(alive.begin()),
+                                  std::make_move_iterator(alive.end()));
+
+    // keep the warm count, a failed connect is retried on the next pass
+    auto target = (std::min)(options_.min_connections, pool_size_);
+    while (open_count_ < target) {
+      ++open_count_;
+      auto conn = std::make_unique<DB>(executor_);
+      bool connected = co_await conn->connect(host_, user_, passwd_, database_,
+                                              timeout_, port_);
+      co_await asio::post(strand_, asio::use_awaitable);
+      if (!connected) {
+        drop_open();
+        break;
+      }
+      if (!initialized_ || closing_) {
+        drop_open();
+        co_await conn->disconnect();
+        break;
+      }
+      add_idle(std::move(conn));
+    }
   }
 
   // Create a dynamic (temporary) connection
@@ -395,6 +633,10 @@ class async_connection_pool
   size_t pool_size_ = 0;
   size_t in_use_count_ = 0;
   size_t dynamic_connection_count_ = 0;
+  // pooled connections alive, idle or checked out, dynamic ones excluded
+  size_t open_count_ = 0;
+  bool maintaining_ = false;
+  std::shared_ptr<asio::steady_timer> maintenance_timer_;
 
   std::string host_;
   std::string user_;
@@ -403,7 +645,7 @@ class async_connection_pool
   std::optional<int> timeout_;
   std::optional<int> port_;
 
-  std::deque<std::unique_ptr<DB>> available_connections_;
+  std::deque<idle_connection> available_connections_;
 };
 
 }  // namespace ormpp
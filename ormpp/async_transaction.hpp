@@ -0,0 +1,129 @@
+#ifndef ORMPP_ASYNC_TRANSACTION_HPP
+#define ORMPP_ASYNC_TRANSACTION_HPP
+
+#include <asio.hpp>
+#include <memory>
+#include <utility>
+
+#include "async_traits.hpp"
+
+namespace ormpp {
+
+// A transaction pinned to one pooled connection. The connection handle is
+// held until commit() or rollback(), so it cannot go back to the pool in the
+// middle of the transaction. A transaction abandoned by an exception, an
+// early return or a cancelled coroutine is rolled back in the background
+// before the connection is returned; when even that fails the connection is
+// closed instead.
+//
+// With mysql_async the BEGIN is sent together with the first statement when
+// that is a SELECT. If BEGIN fails, the SELECT has already run in autocommit
+// and only its result is lost. Before a statement that may write, BEGIN takes
+// a round trip of its own, otherwise a failed BEGIN would leave the write
+// committed. A SELECT calling a function that writes is not told apart. The
+// COMMIT is not sent with the last statement: a failed last statement would
+// leave the earlier ones committed.
+template <typename DB>
+  requires is_async_db_v<DB>
+class async_transaction {
+ public:
+  using executor_type = asio::any_io_executor;
+  template <typename T>
+  using awaitable = asio::awaitable<T, executor_type>;
+
+  async_transaction() = default;
+
+  async_transaction(async_transaction&& other) noexcept
+      : conn_(std::move(other.conn_)), executor_(std::move(other.executor_)) {}
+
+  async_transaction& operator=(async_transaction&& other) noexcept {
+    if (this != &other) {
+      abandon();
+      conn_ = std::move(other.conn_);
+      executor_ = std::move(other.executor_);
+    }
+    return *this;
+  }
+
+  ~async_transaction() { abandon(); }
+
+  // Starts a transaction on conn. The result is empty when conn is nullptr or
+  // BEGIN failed, conn is released then.
+  static awaitable<async_transaction> begin(std::shared_ptr<DB> conn) {
+    async_transaction tx;
+    if (!conn) {
+      co_return tx;
+    }
+    if constexpr (requires { conn->defer_begin(); }) {
+      conn->defer_begin();
+    }
+    else {
+      if (!co_await conn->begin()) {
+        co_return tx;
+      }
+    }
+    tx.executor_ = co_await asio::this_coro::executor;
+    tx.conn_ = std::move(conn);
+    co_return tx;
+  }
+
+  explicit operator bool() const { return conn_ != nullptr; }
+
+  DB* operator->() const { return conn_.get(); }
+  DB& operator*() const { return *conn_; }
+
+  // Commits and releases the connection. A failed commit is rolled back.
+  awaitable<bool> commit() {
+    auto conn = std::move(conn_);
+    if (!conn) {
+      co_return false;
+    }
+    bool ok = co_await conn->commit();
+    if (!ok) {
+      co_await rollback_or_close(*conn);
+    }
+    co_return ok;
+  }
+
+  // Rolls back and releases the connection.
+  awaitable<bool> rollback() {
+    auto conn = std::move(conn_);
+    if (!conn) {
+      co_return false;
+    }
+    co_return co_await rollback_or_close(*conn);
+  }
+
+ private:
+  static awaitable<bool> rollback_or_close(DB& conn) {
+    bool ok = co_await conn.rollback();
+    if (!ok) {
+      co_await conn.disconnect();
+    }
+    co_return ok;
+  }
+
+  static awaitable<void> roll_back_abandoned(std::shared_ptr<DB> conn) {
+    co_await rollback_or_close(*conn);
+  }
+
+  void abandon() noexcept {
+    if (!conn_) {
+      return;
+    }
+    try {
+      asio::co_spawn(executor_, roll_back_abandoned(std::move(conn_)),
+                     asio::detached);
+    } catch (...) {
+      // the handle still returns the connection, without the rollback
+    }
+    conn_.reset();
+  }
+
+  std::shared_ptr<DB> conn_;
+  executor_type executor_;
+};
+
+}  // namespace ormpp
+
+#endif  // ORMPP_ASYNC_TRANSACTION_HPP
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace ormpp {
+
+// Backend independent classification of a failure, the native error code
+// and SQLSTATE of the backend are kept next to it in db_error.
+enum class db_errc {
+  ok = 0,
+  connection,        // connect failed or the connection was lost
+  statement,         // the server rejected or failed the statement
+  constraint,        // unique, foreign key, not null or check violation
+  transaction,       // deadlock, serialization failure, lock conflict
+  timeout,           // lock wait or statement timeout, cancelled statement
+  invalid_argument,  // rejected by ormpp before reaching the server
+  protocol,          // malformed or unexpected response
+  unknown,
+};
+
+inline std::string_view to_string(db_errc code) {
+  switch (code) {
+    case db_errc::ok:
+      return "ok";
+    case db_errc::connection:
+      return "connection";
+    case db_errc::statement:
+      return "statement";
+    case db_errc::constraint:
+      return "constraint";
+    case db_errc::transaction:
+      return "transaction";
+    case db_errc::timeout:
+      return "timeout";
+    case db_errc::invalid_argument:
+      return "invalid_argument";
+    case db_errc::protocol:
+      return "protocol";
+    default:
+      return "unknown";
+  }
+}
+
+// Error state of one connection. Every backend owns one, so connections used
+// from different threads never share it.
+struct db_error {
+  db_errc code = db_errc::ok;
+  int native_code = 0;   // mysql_errno, sqlite3_extended_errcode ...
+  std::string sqlstate;  // empty when the backend does not report one
+  std::string message;
+
+  explicit operator bool() const { return code != db_errc::ok; }
+
+  void clear() {
+    // keep the buffers, a connection which failed once is likely to fail
+    // again and the common case does not touch them at all
+    if (code != db_errc::ok) {
+      code = db_errc::ok;
+      native_code = 0;
+      sqlstate.clear();
+      message.clear();
+    }
+  }
+
+  void assign(db_errc c, std::string msg, int native = 0,
+              std::string_view state = {}) {
+    code = c;
+    native_code = native;
+    sqlstate.assign(state.data(), state.size());
+    message = std::move(msg);
+  }
+};
+
+// Shared by the mysql and mysql_async backends, native is the server or client
+// error number (mysql_errno, error packet code).
+inline db_errc mysql_errc(unsigned native) {
+  switch (native) {
+    case 0:
+      return db_errc::unknown;
+    case 1022:  // ER_DUP_KEY
+    case 1048:  // ER_BAD_NULL_ERROR
+    case 1062:  // ER_DUP_ENTRY
+    case 1216:  // ER_NO_REFERENCED_ROW
+    case 1217:  // ER_ROW_IS_REFERENCED
+    case 1451:  // ER_ROW_IS_REFERENCED_2
+    case 1452:  // ER_NO_REFERENCED_ROW_2
+    case 1586:  // ER_DUP_ENTRY_WITH_KEY_NAME
+    case 3819:  // ER_CHECK_CONSTRAINT_VIOLATED
+      return db_errc::constraint;
+    case 1213:  // ER_LOCK_DEADLOCK
+    case 1614:  // ER_XA_RBDEADLOCK
+      return db_errc::transaction;
+    case 1205:  // ER_LOCK_WAIT_TIMEOUT
+    case 1317:  // ER_QUERY_INTERRUPTED
+    case 3024:  // ER_QUERY_TIMEOUT
+      return db_errc::timeout;
+    default:
+      break;
+  }
+  // 2000-2999 are client errors: connection refused, server gone away,
+  // lost connection...
+  if (native >= 2000 && native < 3000) {
+    return db_errc::connection;
+  }
+  return db_errc::statement;
+}
+
+}  // namespace ormpp
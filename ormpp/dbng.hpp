@@ -6,6 +6,7 @@
 #define ORM_DBNG_HPP
 
 #include <chrono>
+#include <climits>
 #include <functional>
 #include <string>
 #include <string_view>
@@ -13,7 +14,12 @@
 #include <vector>
 
 #include "async_traits.hpp"
+#include "db_error.hpp"
+#include "export.hpp"
 #include "query.hpp"
+#include "query_stats.hpp"
+#include "result_set.hpp"
+#include "session.hpp"
 
 namespace ormpp {
 template <typename DB>
@@ -91,6 +97,39 @@ class dbng {
     return db_.template update<members...>(v, std::forward<Args>(args)...);
   }
 
+  // update t set <columns> where <conflict keys> for every row, bit i of
+  // columns is member i. Runs in the caller's transaction, if any.
+  template <typename T>
+  int update_columns(const T &t, uint64_t columns) {
+    return db_.template update_columns<T>(t, columns);
+  }
+
+  template <typename T>
+  int update_columns(const std::vector<T> &v, uint64_t columns) {
+    return db_.template update_columns<T>(v, columns);
+  }
+
+  // Writes the members of new_row which differ from old_row, where the
+  // conflict key matches. Returns 0 without a statement when nothing
+  // changed; the statement of each set of changed columns is prepared once
+  // per connection.
+  template <typename T>
+  int update_changed(const T &old_row, const T &new_row) {
+    uint64_t columns = differing_columns(old_row, new_row);
+    if (columns & conflict_key_columns<T>()) {
+      db_.set_last_error("update_changed can not change a conflict key",
+                         db_errc::invalid_argument);
+      return INT_MIN;
+    }
+    if (columns == 0) {
+      return 0;
+    }
+    return db_.template update_columns<T>(new_row, columns);
+  }
+
+  // rows tracked until flush() writes the changed columns, see session.hpp
+  ormpp::session<DB> session() { return ormpp::session<DB>(db_); }
+
   template <typename T, typename... Args>
   decltype(auto) get_insert_id_after_insert(const T &t, Args &&...args) {
     return db_.get_insert_id_after_insert(t, std::forward<Args>(args)...);
@@ -102,6 +141,12 @@ class dbng {
     return db_.get_insert_id_after_insert(v, std::forward<Args>(args)...);
   }
 
+  // mysql only, LOAD DATA LOCAL INFILE streamed from rows
+  template <typename T, auto... members, typename Range>
+  decltype(auto) bulk_load(const Range &rows) {
+    return db_.template bulk_load<T, members...>(rows);
+  }
+
   template <typename T, typename... Args>
   decltype(auto) delete_records_s(const std::string &str = "", Args &&...args) {
     return db_.template delete_records_s<T>(str, std::forward<Args>(args)...);
@@ -112,6 +157,66 @@ class dbng {
     return db_.template query_s<T>(str, std::forward<Args>(args)...);
   }
 
+  // f(row) for every row, without collecting them. The rows are read from the
+  // connection while f runs, so f must not use this dbng: such a call fails
+  // with db_errc::invalid_argument. Use another connection from the pool.
+  template <typename T, typename F, typename... Args>
+  decltype(auto) query_each(const std::string &str, F &&f, Args &&...args) {
+    return db_.template query_each<T>(str, std::forward<F>(f),
+                                      std::forward<Args>(args)...);
+  }
+
+  // rows written to sink while they are read, see export.hpp; like the
+  // query_each callback, the sink must not use this dbng
+  template <typename T, typename Sink, typename... Args>
+  bool export_json(const std::string &str, Sink &&sink, Args &&...args) {
+    return ormpp::export_json<T>(db_, str, std::forward<Sink>(sink),
+                                 std::forward<Args>(args)...);
+  }
+
+  template <typename T, typename Sink, typename... Args>
+  bool export_csv(const std::string &str, Sink &&sink, Args &&...args) {
+    return ormpp::export_csv<T>(db_, str, std::forward<Sink>(sink),
+                                std::forward<Args>(args)...);
+  }
+
+  template <typename T, typename Sink, typename... Args>
+  bool export_pb(const std::string &str, Sink &&sink, Args &&...args) {
+    return ormpp::export_pb<T>(db_, str, std::forward<Sink>(sink),
+                               std::forward<Args>(args)...);
+  }
+
+  // children of REGISTER_RELATION members for rows already queried, one
+  // query per relation
+  template <auto... members, typename T>
+  bool load_relations(std::vector<T> &parents) {
+    return ormpp::load_relations<members...>(&db_, parents);
+  }
+
+  // one std::vector per member instead of one struct per row, see
+  // column_set.hpp
+  template <typename T, typename... Args>
+  decltype(auto) query_columns(const std::string &str = "", Args &&...args) {
+    return db_.template query_columns<T>(str, std::forward<Args>(args)...);
+  }
+
+  // query_s whose std::string_view and blob_view fields point into the
+  // returned result_set instead of a buffer shared by all rows
+  template <typename T, typename... Args>
+  result_set<T> query_view(const std::string &str = "", Args &&...args) {
+    string_arena arena;
+    db_.set_result_arena(&arena);
+    std::vector<T> rows;
+    try {
+      rows = db_.template query_s<T>(str, std::forward<Args>(args)...);
+    } catch (...) {
+      db_.set_result_arena(nullptr);
+      throw;
+    }
+    db_.set_result_arena(nullptr);
+    return result_set<T>(std::move(rows), std::move(arena));
+  }
+
   template <typename T, typename... Args>
   [[deprecated]] decltype(auto) delete_records(Args &&...where_condition) {
     return db_.template delete_records<T>(
@@ -153,6 +258,12 @@ class dbng {
     return db_.template make_alter_table<T>();
   }
 
+  // postgresql and sqlite
+  template <typename T>
+  auto upsert() {
+    return db_.template make_upsert<T>();
+  }
+
   template <typename... Args>
   auto select(Args... args) {
     return db_.select(args...);
@@ -187,6 +298,9 @@ class dbng {
 
   std::string get_last_error() const { return db_.get_last_error(); }
 
+  // structured form of the last error, see db_errc
+  const db_error &get_error() const { return db_.get_error(); }
+
   int get_last_affect_rows() { return db_.get_last_affect_rows(); }
 
  private:
@@ -0,0 +1,241 @@
+#ifndef ORMPP_EXPORT_HPP
+#define ORMPP_EXPORT_HPP
+
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "iguana/json_writer.hpp"
+#include "iguana/pb_writer.hpp"
+#include "utility.hpp"
+
+// JSON and CSV export of a query, written while the rows are read:
+//
+//   std::FILE *fp = std::fopen("person.json", "wb");
+//   db.export_json<person>("age > ?", file_sink(fp), 20);
+//
+// A sink is any callable taking a std::string_view, it gets the output in
+// chunks of about export_chunk_size bytes. Only one chunk and one row are
+// held in memory, however large the result is. JSON is an array of objects
+// written by iguana; CSV has a header line with the member names, quotes
+// fields as RFC 4180 does and leaves NULL fields empty. export_pb writes
+// each row as a protobuf message (iguana's field numbering, members in
+// order from 1) prefixed with its varint length, the framing of
+// writeDelimitedTo/parseDelimitedFrom. The rows come through query_each, so
+// the sink must not run statements on the exporting connection; those fail
+// with db_errc::invalid_argument.
+namespace ormpp {
+
+inline constexpr size_t export_chunk_size = 64 * 1024;
+
+inline auto string_sink(std::string &out) {
+  return [&out](std::string_view chunk) {
+    out.append(chunk);
+  };
+}
+
+inline auto file_sink(std::FILE *fp) {
+  return [fp](std::string_view chunk) {
+    std::fwrite(chunk.data(), 1, chunk.size(), fp);
+  };
+}
+
+namespace detail::exporting {
+
+template <typename Sink>
+class chunk_writer {
+ public:
+  explicit chunk_writer(Sink &sink) : sink_(sink) {
+    buf_.reserve(export_chunk_size + export_chunk_size / 4);
+  }
+
+  std::string &buffer() { return buf_; }
+
+  void row_done() {
+    if (buf_.size() >= export_chunk_size) {
+      flush();
+    }
+  }
+
+  void flush() {
+    if (!buf_.empty()) {
+      sink_(std::string_view(buf_));
+      buf_.clear();
+    }
+  }
+
+ private:
+  Sink &sink_;
+  std::string buf_;
+};
+
+inline void append_csv_text(std::string &out, std::string_view str) {
+  if (str.find_first_of(",\"\r\n") == std::string_view::npos) {
+    out.append(str);
+    return;
+  }
+  out.push_back('"');
+  for (char c : str) {
+    if (c == '"') {
+      out.push_back('"');
+    }
+    out.push_back(c);
+  }
+  out.push_back('"');
+}
+
+template <typename U>
+void append_csv_field(std::string &out, const U &value) {
+  if constexpr (is_optional_v<U>::value) {
+    if (value.has_value()) {
+      append_csv_field(out, *value);
+    }
+  }
+  else if constexpr (std::is_enum_v<U>) {
+    append_csv_field(out, static_cast<std::underlying_type_t<U>>(value));
+  }
+  else if constexpr (std::is_same_v<bool, U>) {
+    out.push_back(value ? '1' : '0');
+  }
+  else if constexpr (std::is_same_v<char, U>) {
+    append_csv_text(out, std::string_view(&value, 1));
+  }
+  else if constexpr (std::is_integral_v<U>) {
+    char buf[32];
+    auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, end);
+  }
+  else if constexpr (std::is_floating_point_v<U>) {
+    char buf[32];
+    int n = std::snprintf(buf, sizeof(buf), "%.*g",
+                          std::numeric_limits<U>::max_digits10,
+                          static_cast<double>(value));
+    out.append(buf, n);
+  }
+  else if constexpr (std::is_same_v<std::string, U> ||
+                     std::is_same_v<std::string_view, U>) {
+    append_csv_text(out, value);
+  }
+  else if constexpr (iguana::array_v<U>) {
+    append_csv_text(out, std::string_view(value.data(),
+                                          strnlen(value.data(), value.size())));
+  }
+  else if constexpr (iguana::c_array_v<U>) {
+    append_csv_text(out, std::string_view(value, strnlen(value, sizeof(U))));
+  }
+  else if constexpr (is_sql_value_type_v<U>) {
+    append_sql_text(out, value);
+  }
+  else if constexpr (is_json_column_v<U>) {
+    std::string text;
+    append_column_text(text, value, column_text::json);
+    append_csv_text(out, text);
+  }
+  else if constexpr (std::is_same_v<blob, U>) {
+    // hex, as postgresql writes bytea
+    static constexpr char digits[] = "0123456789abcdef";
+    out.append("\\x");
+    for (char c : value) {
+      out.push_back(digits[(unsigned char)c >> 4]);
+      out.push_back(digits[(unsigned char)c & 0xf]);
+    }
+  }
+  else {
+    static_assert(!sizeof(U), "this type has not supported yet");
+  }
+}
+
+inline void append_varint(std::string &out, uint64_t v) {
+  while (v >= 0x80) {
+    out.push_back(static_cast<char>(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back(static_cast<char>(v));
+}
+
+}  // namespace detail::exporting
+
+template <typename T, typename DB, typename Sink, typename... Args>
+bool export_json(DB &db, const std::string &sql, Sink &&sink,
+                 Args &&...args) {
+  detail::exporting::chunk_writer<std::remove_reference_t<Sink>> writer(sink);
+  auto &buf = writer.buffer();
+  buf.push_back('[');
+  bool first = true;
+  bool ok = db.template query_each<T>(
+      sql,
+      [&](const T &row) {
+        if (!first) {
+          buf.push_back(',');
+        }
+        first = false;
+        iguana::to_json(row, buf);
+        writer.row_done();
+      },
+      std::forward<Args>(args)...);
+  buf.push_back(']');
+  writer.flush();
+  return ok;
+}
+
+template <typename T, typename DB, typename Sink, typename... Args>
+bool export_csv(DB &db, const std::string &sql, Sink &&sink, Args &&...args) {
+  detail::exporting::chunk_writer<std::remove_reference_t<Sink>> writer(sink);
+  auto &buf = writer.buffer();
+  auto names = ylt::reflection::get_member_names<T>();
+  for (size_t i = 0; i < names.size(); ++i) {
+    if (i > 0) {
+      buf.push_back(',');
+    }
+    detail::exporting::append_csv_text(buf, names[i]);
+  }
+  buf.append("\r\n");
+  bool ok = db.template query_each<T>(
+      sql,
+      [&](const T &row) {
+        ylt::reflection::for_each(row, [&buf](auto &field, auto /*name*/,
+                                              size_t index) {
+          if (index > 0) {
+            buf.push_back(',');
+          }
+          detail::exporting::append_csv_field(buf, field);
+        });
+        buf.append("\r\n");
+        writer.row_done();
+      },
+      std::forward<Args>(args)...);
+  writer.flush();
+  return ok;
+}
+
+template <typename T, typename DB, typename Sink, typename... Args>
+bool export_pb(DB &db, const std::string &sql, Sink &&sink, Args &&...args) {
+  detail::exporting::chunk_writer<std::remove_reference_t<Sink>> writer(sink);
+  auto &buf = writer.buffer();
+  // sizes of nested messages, computed by iguana before writing
+  std::vector<uint32_t> sizes;
+  bool ok = db.template query_each<T>(
+      sql,
+      [&](const T &row) {
+        sizes.clear();
+        size_t len = iguana::detail::pb_key_value_size<0>(row, sizes);
+        detail::exporting::append_varint(buf, len);
+        size_t pos = buf.size();
+        buf.resize(pos + len);
+        iguana::memory_writer out{buf.data() + pos};
+        auto sz_ptr = sizes.empty() ? nullptr : sizes.data();
+        iguana::detail::to_pb_impl<0>(row, sz_ptr, out);
+        writer.row_done();
+      },
+      std::forward<Args>(args)...);
+  writer.flush();
+  return ok;
+}
+
+}  // namespace ormpp
+
+#endif  // ORMPP_EXPORT_HPP
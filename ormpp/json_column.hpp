@@ -0,0 +1,315 @@
+#ifndef ORMPP_JSON_COLUMN_HPP
+#define ORMPP_JSON_COLUMN_HPP
+
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "iguana/json_reader.hpp"
+#include "iguana/json_writer.hpp"
+
+// Members kept in one column instead of a child table:
+//
+//   struct tag { std::string name; int weight; };
+//   struct article {
+//     int id;
+//     std::vector<int64_t> reader_ids;      // bigint[] / JSON / TEXT
+//     std::vector<tag> tags;                // jsonb / JSON / TEXT
+//     ormpp::lazy_column<std::vector<tag>> history;
+//   };
+//
+// A std::vector of numbers or strings is a native array in postgresql.
+// Reflected structs, vectors of them, and every such column in mysql (JSON)
+// and sqlite (TEXT) are JSON written and read by iguana. A lazy_column keeps
+// the text the database returned and decodes it on the first get(), so
+// columns a caller never looks at cost only a copy.
+namespace ormpp {
+
+template <typename T>
+class lazy_column;
+
+template <typename T>
+struct is_lazy_column : std::false_type {};
+
+template <typename T>
+struct is_lazy_column<lazy_column<T>> : std::true_type {};
+
+template <typename T>
+inline constexpr bool is_lazy_column_v = is_lazy_column<T>::value;
+
+// the type a column decodes to, T or the T of a lazy_column<T>
+template <typename T>
+struct decoded_column {
+  using type = T;
+};
+
+template <typename T>
+struct decoded_column<lazy_column<T>> {
+  using type = T;
+};
+
+template <typename T>
+using decoded_column_t = typename decoded_column<T>::type;
+
+template <typename T>
+struct is_std_vector : std::false_type {};
+
+template <typename E, typename A>
+struct is_std_vector<std::vector<E, A>> : std::true_type {};
+
+// std::vector<char> is a blob and std::vector<bool> has no element storage
+template <typename E>
+inline constexpr bool is_array_element_v =
+    (std::is_arithmetic_v<E> && !std::is_same_v<E, char> &&
+     !std::is_same_v<E, bool>) ||
+    std::is_same_v<E, std::string>;
+
+template <typename T>
+inline constexpr bool is_sql_array_v = [] {
+  if constexpr (is_std_vector<T>::value) {
+    return is_array_element_v<typename T::value_type>;
+  }
+  else {
+    return false;
+  }
+}();
+
+template <typename T>
+inline constexpr bool is_json_document_v = [] {
+  if constexpr (is_std_vector<T>::value) {
+    return iguana::ylt_refletable_v<typename T::value_type>;
+  }
+  else {
+    return iguana::ylt_refletable_v<T>;
+  }
+}();
+
+template <typename T>
+inline constexpr bool is_json_column_v =
+    is_sql_array_v<decoded_column_t<T>> ||
+    is_json_document_v<decoded_column_t<T>>;
+
+// How a backend writes arrays, documents are json either way.
+enum class column_text : uint8_t { json, pg_array };
+
+namespace detail::json_columns {
+
+template <typename E>
+void append_pg_element(std::string &out, const E &value) {
+  if constexpr (std::is_same_v<E, std::string>) {
+    out.push_back('"');
+    for (char c : value) {
+      if (c == '"' || c == '\\') {
+        out.push_back('\\');
+      }
+      out.push_back(c);
+    }
+    out.push_back('"');
+  }
+  else if constexpr (std::is_floating_point_v<E>) {
+    char buf[32];
+    int n = std::snprintf(buf, sizeof(buf), "%.*g",
+                          std::numeric_limits<E>::max_digits10,
+                          static_cast<double>(value));
+    out.append(buf, n);
+  }
+  else {
+    char buf[24];
+    auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, end);
+  }
+}
+
+template <typename V>
+void append_pg_array(std::string &out, const V &values) {
+  out.push_back('{');
+  for (size_t i = 0; i < values.size(); ++i) {
+    if (i > 0) {
+      out.push_back(',');
+    }
+    append_pg_element(out, values[i]);
+  }
+  out.push_back('}');
+}
+
+template <typename E>
+bool parse_pg_element(std::string_view str, E &value) {
+  if constexpr (std::is_same_v<E, std::string>) {
+    value.assign(str);
+    return true;
+  }
+  else {
+    auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(),
+                                     value);
+    return ec == std::errc{} && end == str.data() + str.size();
+  }
+}
+
+// A one dimensional array literal as postgresql prints it. NULL elements
+// become default values.
+template <typename V>
+bool parse_pg_array(std::string_view str, V &values) {
+  values.clear();
+  if (str.size() < 2 || str.front() != '{' || str.back() != '}') {
+    return false;
+  }
+  str = str.substr(1, str.size() - 2);
+  std::string quoted;
+  size_t i = 0;
+  while (i < str.size()) {
+    auto &value = values.emplace_back();
+    if (str[i] == '"') {
+      quoted.clear();
+      for (++i; i < str.size() && str[i] != '"'; ++i) {
+        if (str[i] == '\\' && i + 1 < str.size()) {
+          ++i;
+        }
+        quoted.push_back(str[i]);
+      }
+      if (i == str.size() || !parse_pg_element(quoted, value)) {
+        return false;
+      }
+      ++i;
+    }
+    else {
+      size_t end = str.find(',', i);
+      if (end == std::string_view::npos) {
+        end = str.size();
+      }
+      auto item = str.substr(i, end - i);
+      if (item != "NULL" && !parse_pg_element(item, value)) {
+        return false;
+      }
+      i = end;
+    }
+    if (i < str.size()) {
+      if (str[i] != ',') {
+        return false;
+      }
+      ++i;
+    }
+  }
+  return true;
+}
+
+}  // namespace detail::json_columns
+
+template <typename T>
+void append_column_text(std::string &out, const T &value, column_text format);
+
+template <typename T>
+bool parse_column_text(std::string_view str, T &value, column_text format);
+
+template <typename T>
+class lazy_column {
+ public:
+  using value_type = T;
+
+  lazy_column() = default;
+  lazy_column(T value) : value_(std::move(value)) {}
+
+  // str as the database returned it, in the given format
+  static lazy_column from_text(std::string_view str, column_text format) {
+    lazy_column column;
+    column.text_.assign(str);
+    column.format_ = format;
+    return column;
+  }
+
+  bool decoded() const { return value_.has_value(); }
+
+  const T &get() const {
+    decode();
+    return *value_;
+  }
+
+  // the caller may change the value, so the text is dropped
+  T &get() {
+    decode();
+    text_.clear();
+    text_.shrink_to_fit();
+    return *value_;
+  }
+
+  const T &operator*() const { return get(); }
+  const T *operator->() const { return &get(); }
+
+  // Writes the kept text if it is in the requested format, a column that
+  // was read and written back is never decoded.
+  void append_text(std::string &out, column_text format) const {
+    if (!value_ && format_ == format) {
+      out.append(text_);
+      return;
+    }
+    append_column_text(out, get(), format);
+  }
+
+  friend bool operator==(const lazy_column &a, const lazy_column &b) {
+    return a.get() == b.get();
+  }
+
+ private:
+  void decode() const {
+    if (value_) {
+      return;
+    }
+    value_.emplace();
+    if (!text_.empty() && !parse_column_text(text_, *value_, format_)) {
+      *value_ = T{};
+    }
+  }
+
+  mutable std::optional<T> value_;
+  std::string text_;
+  column_text format_ = column_text::json;
+};
+
+template <typename T>
+void append_column_text(std::string &out, const T &value, column_text format) {
+  if constexpr (is_lazy_column_v<T>) {
+    value.append_text(out, format);
+  }
+  else if constexpr (is_sql_array_v<T>) {
+    if (format == column_text::pg_array) {
+      detail::json_columns::append_pg_array(out, value);
+    }
+    else {
+      iguana::to_json(value, out);
+    }
+  }
+  else {
+    iguana::to_json(value, out);
+  }
+}
+
+// false for malformed text
+template <typename T>
+bool parse_column_text(std::string_view str, T &value, column_text format) {
+  if constexpr (is_lazy_column_v<T>) {
+    value = T::from_text(str, format);
+    return true;
+  }
+  else {
+    if constexpr (is_sql_array_v<T>) {
+      if (format == column_text::pg_array) {
+        return detail::json_columns::parse_pg_array(str, value);
+      }
+    }
+    try {
+      iguana::from_json(value, str);
+      return true;
+    } catch (...) {
+      return false;
+    }
+  }
+}
+
+}  // namespace ormpp
+
+#endif  // ORMPP_JSON_COLUMN_HPP
@@ -5,14 +5,24 @@
 #ifndef ORM_MYSQL_HPP
 #define ORM_MYSQL_HPP
 
+#include <array>
 #include <climits>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <limits>
 #include <list>
 #include <map>
+#include <ranges>
 #include <string_view>
 #include <utility>
 
 #include "entity.hpp"
+#include "column_set.hpp"
+#include "db_error.hpp"
 #include "query.hpp"
+#include "query_trace.hpp"
+#include "result_set.hpp"
 #include "type_mapping.hpp"
 
 namespace ormpp {
@@ -23,20 +33,23 @@ class mysql {
 
   ~mysql() { disconnect(); }
 
-  bool has_error() const { return has_error_; }
+  bool has_error() const { return static_cast<bool>(error_); }
 
-  static void reset_error() {
-    has_error_ = false;
-    last_error_ = {};
-  }
+  void reset_error() { error_.clear(); }
+
+  // string_view and blob_view fields of the following results are stored
+  // here, see dbng::query_view
+  void set_result_arena(string_arena *arena) { arena_ = arena; }
 
-  static void set_last_error(std::string last_error) {
-    has_error_ = true;
-    last_error_ = std::move(last_error);
-    std::cout << last_error_ << std::endl;
+  void set_last_error(std::string last_error,
+                      db_errc code = db_errc::unknown) {
+    error_.assign(code, std::move(last_error));
+    std::cout << error_.message << std::endl;
   }
 
-  std::string get_last_error() const { return last_error_; }
+  std::string get_last_error() const { return error_.message; }
+
+  const db_error &get_error() const { return error_; }
 
   bool connect(
       const std::tuple<std::string, std::string, std::string, std::string,
@@ -48,7 +61,7 @@ class mysql {
 
     con_ = mysql_init(nullptr);
     if (!con_) {
-      set_last_error("mysql init failed");
+      set_last_error("mysql init failed", db_errc::connection);
       return false;
     }
 
@@ -56,7 +69,7 @@ class mysql {
 
     if (timeout > 0) {
       if (mysql_options(con_, MYSQL_OPT_CONNECT_TIMEOUT, &timeout) != 0) {
-        set_last_error(mysql_error(con_));
+        set_con_error();
         return false;
       }
     }
@@ -68,7 +81,7 @@ class mysql {
             std::get<2>(tp).c_str(), std::get<3>(tp).c_str(),
             std::get<5>(tp).has_value() ? std::get<5>(tp).value() : 0, nullptr,
             0) == nullptr) {
-      set_last_error(mysql_error(con_));
+      set_con_error();
       return false;
     }
 
@@ -87,6 +100,7 @@ class mysql {
   template <typename... Args>
   bool disconnect(Args &&...args) {
     if (con_ != nullptr) {
+      clear_update_stmts();
       mysql_close(con_);
       con_ = nullptr;
     }
@@ -101,11 +115,7 @@ class mysql {
 #ifdef ORMPP_ENABLE_LOG
     std::cout << sql << std::endl;
 #endif
-    if (mysql_query(con_, sql.data())) {
-      set_last_error(mysql_error(con_));
-      return false;
-    }
-    return true;
+    return simple_query(sql.data());
   }
 
   template <typename T, typename... Args>
@@ -138,6 +148,20 @@ class mysql {
     return update_impl<members...>(v, std::forward<Args>(args)...);
   }
 
+  // update t set <columns> where <conflict keys>, bit i of columns is
+  // member i. The statement of each struct and column mask is prepared once
+  // per connection and kept. No transaction is opened, the caller groups the
+  // statements.
+  template <typename T>
+  int update_columns(const T &t, uint64_t columns) {
+    return update_columns_impl(&t, 1, columns);
+  }
+
+  template <typename T>
+  int update_columns(const std::vector<T> &v, uint64_t columns) {
+    return update_columns_impl(v.data(), v.size(), columns);
+  }
+
   template <typename T, typename... Args>
   uint64_t get_insert_id_after_insert(const T &t, Args &&...args) {
     auto res = insert_or_update_impl(t, generate_insert_sql<T>(db_type_v, true),
@@ -152,6 +176,70 @@ class mysql {
     return res.has_value() ? res.value() : 0;
   }
 
+  // LOAD DATA LOCAL INFILE fed from memory: the rows are written as escaped
+  // tab separated text while the server reads it, no temporary file. Loads
+  // the given members, or all but the auto key. The server needs
+  // local_infile=ON, and rows with a duplicate key are skipped as LOCAL
+  // implies IGNORE. Returns the number of rows loaded, INT_MIN on error.
+  template <typename T, auto... members, typename Range>
+  int bulk_load(const Range &rows) {
+    std::array<bool, ylt::reflection::members_count_v<T>> columns{};
+    if constexpr (sizeof...(members) > 0) {
+      for (auto index : indexs_of<members...>()) {
+        columns[index] = true;
+      }
+    }
+    else {
+      auto names = ylt::reflection::get_member_names<T>();
+      for (size_t i = 0; i < names.size(); ++i) {
+        columns[i] = !is_auto_key<T>(names[i]);
+      }
+    }
+
+    std::string sql = "LOAD DATA LOCAL INFILE 'ormpp_bulk_load' INTO TABLE ";
+    sql.append(get_short_struct_name<T>())
+        .append(" CHARACTER SET utf8mb4 FIELDS TERMINATED BY '\\t' ESCAPED BY "
+                "'\\\\' LINES TERMINATED BY '\\n' (");
+    auto names = ylt::reflection::get_member_names<T>();
+    for (size_t i = 0; i < names.size(); ++i) {
+      if (columns[i]) {
+        sql.append("`").append(names[i]).append("`,");
+      }
+    }
+    sql.back() = ')';
+#ifdef ORMPP_ENABLE_LOG
+    std::cout << sql << std::endl;
+#endif
+
+    reset_error();
+    if (cursor_busy()) {
+      return INT_MIN;
+    }
+    using source_t = infile_source<T, Range>;
+    source_t source{std::ranges::begin(rows), std::ranges::end(rows),
+                    columns};
+    unsigned int local_infile = 1;
+    mysql_options(con_, MYSQL_OPT_LOCAL_INFILE, &local_infile);
+    mysql_set_local_infile_handler(con_, &source_t::init, &source_t::read,
+                                   &source_t::end, &source_t::error, &source);
+
+    trace_scope trace(db_type_v, sql, error_);
+    int ret = mysql_real_query(con_, sql.data(), (unsigned long)sql.size());
+    trace.executed();
+    // only this statement may read a local file, a later LOAD DATA LOCAL
+    // coming through execute() is refused by the client again
+    local_infile = 0;
+    mysql_options(con_, MYSQL_OPT_LOCAL_INFILE, &local_infile);
+    mysql_set_local_infile_default(con_);
+    if (ret != 0) {
+      set_con_error();
+      return INT_MIN;
+    }
+    last_affect_rows_ = (int)mysql_affected_rows(con_);
+    trace.set_rows(last_affect_rows_);
+    return last_affect_rows_;
+  }
+
   int get_last_affect_rows() { return last_affect_rows_; }
 
   template <typename T>
@@ -159,6 +247,11 @@ class mysql {
                                 T &&value) {
     MYSQL_BIND param = {};
     using U = ylt::reflection::remove_cvref_t<T>;
+    if (param_binds.empty()) {
+      // the first parameter of a statement, the last one has executed
+      param_times_.clear();
+      param_texts_.clear();
+    }
     if constexpr (is_optional_v<U>::value) {
       if (value.has_value()) {
         return set_param_bind(param_binds, std::move(value.value()));
@@ -202,6 +295,26 @@ class mysql {
       param.buffer = (void *)(value);
       param.buffer_length = (unsigned long)strlen(value);
     }
+    else if constexpr (is_sys_time_v<U> || is_sql_date_v<U>) {
+      param.buffer_type =
+          is_sql_date_v<U> ? MYSQL_TYPE_DATE : MYSQL_TYPE_DATETIME;
+      param.buffer = &param_times_.emplace_back(to_mysql_time(value));
+      param.buffer_length = sizeof(MYSQL_TIME);
+    }
+    else if constexpr (is_decimal_v<U>) {
+      auto &text = param_texts_.emplace_back();
+      append_sql_text(text, value);
+      param.buffer_type = MYSQL_TYPE_NEWDECIMAL;
+      param.buffer = text.data();
+      param.buffer_length = (unsigned long)text.size();
+    }
+    else if constexpr (is_json_column_v<U>) {
+      auto &text = param_texts_.emplace_back();
+      append_column_text(text, value, column_text::json);
+      param.buffer_type = MYSQL_TYPE_STRING;
+      param.buffer = text.data();
+      param.buffer_length = (unsigned long)text.size();
+    }
     else if constexpr (std::is_same_v<blob, U>) {
       param.buffer_type = MYSQL_TYPE_BLOB;
       param.buffer = (void *)(value.data());
@@ -220,9 +333,28 @@ class mysql {
     param_binds.push_back(param);
   }
 
+  // Result buffer of a text or blob column. It starts small and set_value
+  // grows it to the real length of a truncated value; the connection keeps
+  // it for the next rows and queries.
+  struct column_buffer {
+    std::vector<char> data;
+    unsigned long length = 0;
+
+    // At least size bytes for the next bind. A buffer grown past
+    // max_retained_result_buffer is replaced, assign would keep its capacity.
+    void reset(size_t size) {
+      if (data.size() > max_retained_result_buffer) {
+        std::vector<char>(size).swap(data);
+      }
+      else if (data.size() < size) {
+        data.assign(size, 0);
+      }
+    }
+  };
+
   template <typename T, typename B>
   void set_param_bind(MYSQL_RES *meta_, MYSQL_BIND &param_bind, T &&value,
-                      int i, std::map<size_t, std::vector<char>> &mp,
+                      int i, std::map<size_t, column_buffer> &mp,
                       B &is_null) {
     using U = ylt::reflection::remove_cvref_t<T>;
 
@@ -252,7 +384,6 @@ class mysql {
     }
     else if constexpr (std::is_same_v<std::string, U> ||
                        std::is_same_v<std::string_view, U>) {
-      unsigned long buffer_size = 256;
       enum_field_types buffer_type = MYSQL_TYPE_STRING;
 
       MYSQL_FIELD *field = mysql_fetch_field_direct(meta_, i);
@@ -261,41 +392,43 @@ class mysql {
             field->type == MYSQL_TYPE_LONG_BLOB) {
           buffer_type = field->type;
         }
-        buffer_size = field->length + 1;
       }
 
       param_bind.buffer_type = buffer_type;
-      std::vector<char> tmp(buffer_size, 0);
-      mp.emplace(i, std::move(tmp));
-      param_bind.buffer = &(mp.rbegin()->second[0]);
-      param_bind.buffer_length = buffer_size;
+      bind_result_buffer(param_bind, mp[i], result_buffer_size(field));
     }
     else if constexpr (iguana::array_v<U>) {
       param_bind.buffer_type = MYSQL_TYPE_VAR_STRING;
-      std::vector<char> tmp(sizeof(U), 0);
-      mp.emplace(i, std::move(tmp));
-      param_bind.buffer = &(mp.rbegin()->second[0]);
-      param_bind.buffer_length = (unsigned long)sizeof(U);
+      bind_result_buffer(param_bind, mp[i], sizeof(U));
     }
-    else if constexpr (std::is_same_v<blob, U>) {
-      unsigned long buffer_size = 65536;
+    else if constexpr (is_sys_time_v<U> || is_sql_date_v<U>) {
+      param_bind.buffer_type =
+          is_sql_date_v<U> ? MYSQL_TYPE_DATE : MYSQL_TYPE_DATETIME;
+      bind_result_buffer(param_bind, mp[i], sizeof(MYSQL_TIME));
+    }
+    else if constexpr (is_decimal_v<U>) {
+      // DECIMAL(65,30) is 67 chars
+      param_bind.buffer_type = MYSQL_TYPE_STRING;
+      bind_result_buffer(param_bind, mp[i], 68);
+    }
+    else if constexpr (is_json_column_v<U>) {
+      MYSQL_FIELD *field = mysql_fetch_field_direct(meta_, i);
+      param_bind.buffer_type = MYSQL_TYPE_STRING;
+      bind_result_buffer(param_bind, mp[i], result_buffer_size(field));
+    }
+    else if constexpr (std::is_same_v<blob, U> || is_blob_view_v<U>) {
       enum_field_types buffer_type = MYSQL_TYPE_BLOB;
 
       MYSQL_FIELD *field = mysql_fetch_field_direct(meta_, i);
       if (field) {
         buffer_type = field->type;
-        buffer_size = field->length;
       }
 
       param_bind.buffer_type = buffer_type;
-      std::vector<char> tmp(buffer_size, 0);
-      mp.emplace(i, std::move(tmp));
-      param_bind.buffer = &(mp.rbegin()->second[0]);
-      param_bind.buffer_length = buffer_size;
+      bind_result_buffer(param_bind, mp[i], result_buffer_size(field));
     }
 #ifdef ORMPP_WITH_CSTRING
     else if constexpr (std::is_same_v<CString, U>) {
-      unsigned long buffer_size = 256;
       enum_field_types buffer_type = MYSQL_TYPE_STRING;
 
       MYSQL_FIELD *field = mysql_fetch_field_direct(meta_, i);
@@ -304,14 +437,10 @@ class mysql {
             field->type == MYSQL_TYPE_LONG_BLOB) {
           buffer_type = field->type;
         }
-        buffer_size = field->length + 1;
       }
 
       param_bind.buffer_type = buffer_type;
-      std::vector<char> tmp(buffer_size, 0);
-      mp.emplace(i, std::move(tmp));
-      param_bind.buffer = &(mp.rbegin()->second[0]);
-      param_bind.buffer_length = buffer_size;
+      bind_result_buffer(param_bind, mp[i], result_buffer_size(field));
     }
 #endif
     else {
@@ -322,7 +451,7 @@ class mysql {
 
   template <typename T>
   void set_value(MYSQL_BIND &param_bind, T &&value, int i,
-                 std::map<size_t, std::vector<char>> &mp) {
+                 std::map<size_t, column_buffer> &mp) {
     using U = ylt::reflection::remove_cvref_t<T>;
     if constexpr (is_optional_v<U>::value) {
       using value_type = typename U::value_type;
@@ -338,26 +467,48 @@ class mysql {
       }
     }
     else if constexpr (std::is_same_v<std::string, U>) {
-      auto &vec = mp[i];
-      value = std::string(&vec[0], strlen(vec.data()));
+      value = std::string(fetch_result_buffer(param_bind, i, mp[i]));
     }
     else if constexpr (std::is_same_v<std::string_view, U>) {
-      auto &vec = mp[i];
-      sv_ = std::string(&vec[0], strlen(vec.data()));
-      value = sv_;
+      auto str = fetch_result_buffer(param_bind, i, mp[i]);
+      value = hold_result_text(arena_, sv_, str.data(), str.size());
     }
     else if constexpr (iguana::array_v<U>) {
-      auto &vec = mp[i];
-      memcpy(value.data(), vec.data(), value.size());
+      auto str = fetch_result_buffer(param_bind, i, mp[i]);
+      size_t n = (std::min)(str.size(), value.size());
+      memcpy(value.data(), str.data(), n);
+      memset(value.data() + n, 0, value.size() - n);
     }
     else if constexpr (std::is_same_v<blob, U>) {
-      auto &vec = mp[i];
-      value = blob(vec.data(), vec.data() + get_blob_len(i));
+      auto str = fetch_result_buffer(param_bind, i, mp[i]);
+      value = blob(str.begin(), str.end());
+    }
+    else if constexpr (is_sys_time_v<U> || is_sql_date_v<U>) {
+      value = from_mysql_time<U>(*static_cast<MYSQL_TIME *>(param_bind.buffer));
+    }
+    else if constexpr (is_decimal_v<U>) {
+      // as postgresql and mysql_async: the row is kept, the value is not
+      auto str = fetch_result_buffer(param_bind, i, mp[i]);
+      if (!parse_sql_text(str, value)) {
+        value = U{};
+        set_invalid_value_error(str);
+      }
+    }
+    else if constexpr (is_json_column_v<U>) {
+      auto str = fetch_result_buffer(param_bind, i, mp[i]);
+      if (!parse_column_text(str, value, column_text::json)) {
+        value = U{};
+      }
+    }
+    else if constexpr (is_blob_view_v<U>) {
+      auto str = fetch_result_buffer(param_bind, i, mp[i]);
+      str = hold_result_text(arena_, sv_, str.data(), str.size());
+      value = blob_view(str.data(), str.size());
     }
 #ifdef ORMPP_WITH_CSTRING
     else if constexpr (std::is_same_v<CString, U>) {
-      auto &vec = mp[i];
-      value.SetString(std::string(&vec[0], strlen(vec.data()).c_str()));
+      value.SetString(
+          std::string(fetch_result_buffer(param_bind, i, mp[i])).c_str());
     }
 #endif
   }
@@ -375,38 +526,61 @@ class mysql {
 #ifdef ORMPP_ENABLE_LOG
     std::cout << sql << std::endl;
 #endif
+    if (cursor_busy()) {
+      return 0;
+    }
+    trace_scope trace(db_type_v, sql, error_);
     stmt_ = mysql_stmt_init(con_);
     if (!stmt_) {
-      set_last_error(mysql_error(con_));
+      set_con_error();
       return 0;
     }
 
-    auto guard = guard_statment(stmt_);
+    auto guard = guard_statment(stmt_, *this);
     if (mysql_stmt_prepare(stmt_, sql.c_str(), (unsigned long)sql.size())) {
-      set_last_error(mysql_stmt_error(stmt_));
+      set_stmt_error();
       return 0;
     }
+    trace.prepared();
 
     if constexpr (sizeof...(Args) > 0) {
       size_t index = 0;
       std::vector<MYSQL_BIND> param_binds;
       (set_param_bind(param_binds, args), ...);
       if (mysql_stmt_bind_param(stmt_, &param_binds[0])) {
-        set_last_error(mysql_stmt_error(stmt_));
+        set_stmt_error();
         return 0;
       }
     }
 
     if (mysql_stmt_execute(stmt_)) {
-      set_last_error(mysql_stmt_error(stmt_));
+      set_stmt_error();
       return 0;
     }
-    return (uint64_t)mysql_stmt_affected_rows(stmt_);
+    trace.executed();
+    uint64_t affected = (uint64_t)mysql_stmt_affected_rows(stmt_);
+    trace.set_rows(affected);
+    return affected;
   }
 
   template <typename T, typename... Args>
   std::enable_if_t<iguana::ylt_refletable_v<T>, std::vector<T>> query_s(
       const std::string &str, Args &&...args) {
+    std::vector<T> v;
+    bool ok = query_each<T>(
+        str,
+        [&v](T &t) {
+          v.push_back(std::move(t));
+        },
+        std::forward<Args>(args)...);
+    return ok ? std::move(v) : std::vector<T>{};
+  }
+
+  // Calls f(row) for every row as it is fetched instead of collecting them.
+  // The statement is not buffered, rows come from the server as f consumes
+  // them; the row object is bound to the statement and reused.
+  template <typename T, typename F, typename... Args>
+  bool query_each(const std::string &str, F &&f, Args &&...args) {
     constexpr auto SIZE = ylt::reflection::members_count_v<T>;
     std::string sql =
         contains_select(str) ? str : generate_query_sql<T>(db_type_v, str);
@@ -414,23 +588,28 @@ class mysql {
     std::cout << sql << std::endl;
 #endif
 
+    if (cursor_busy()) {
+      return false;
+    }
+    trace_scope trace(db_type_v, sql, error_);
     stmt_ = mysql_stmt_init(con_);
     if (!stmt_) {
-      set_last_error(mysql_error(con_));
-      return {};
+      set_con_error();
+      return false;
     }
 
-    auto guard = guard_statment(stmt_);
+    auto guard = guard_statment(stmt_, *this);
 
     if (mysql_stmt_prepare(stmt_, sql.c_str(), (unsigned long)sql.size())) {
-      set_last_error(mysql_stmt_error(stmt_));
-      return {};
+      set_stmt_error();
+      return false;
     }
+    trace.prepared();
 
     meta_ = mysql_stmt_result_metadata(stmt_);
     if (!meta_) {
-      set_last_error(mysql_stmt_error(stmt_));
-      return {};
+      set_stmt_error();
+      return false;
     }
 
     auto meta_guard = guard_result(meta_);
@@ -439,18 +618,17 @@ class mysql {
       std::vector<MYSQL_BIND> param_binds;
       (set_param_bind(param_binds, args), ...);
       if (mysql_stmt_bind_param(stmt_, &param_binds[0])) {
-        set_last_error(mysql_stmt_error(stmt_));
-        return {};
+        set_stmt_error();
+        return false;
       }
     }
 
     std::array<decltype(std::declval<MYSQL_BIND>().is_null), SIZE> nulls = {};
     std::array<MYSQL_BIND, SIZE> param_binds = {};
-    std::map<size_t, std::vector<char>> mp;
+    auto &mp = result_buffers_;
 
     T t{};
     size_t index = 0;
-    std::vector<T> v;
     ylt::reflection::for_each(
         t, [&param_binds, &index, &nulls, &mp, this](auto &field, auto /*name*/,
                                                      auto /*index*/) {
@@ -460,19 +638,21 @@ class mysql {
         });
 
     if (index == 0) {
-      return {};
+      return false;
     }
 
     if (mysql_stmt_bind_result(stmt_, &param_binds[0])) {
-      set_last_error(mysql_stmt_error(stmt_));
-      return {};
+      set_stmt_error();
+      return false;
     }
 
     if (mysql_stmt_execute(stmt_)) {
-      set_last_error(mysql_stmt_error(stmt_));
-      return {};
+      set_stmt_error();
+      return false;
     }
+    trace.executed();
 
+    cursor_scope cursor(in_cursor_);
     int fetch_ret = 0;
     while ((fetch_ret = mysql_stmt_fetch(stmt_)) == 0 ||
            fetch_ret == MYSQL_DATA_TRUNCATED) {
@@ -481,8 +661,12 @@ class mysql {
             set_value(param_binds.at(index), field, index, mp);
           });
 
-      for (auto &p : mp) {
-        p.second.assign(p.second.size(), 0);
+      if (rebind_result_) {
+        rebind_result_ = false;
+        if (mysql_stmt_bind_result(stmt_, &param_binds[0])) {
+          set_stmt_error();
+          return false;
+        }
       }
 
       ylt::reflection::for_each(t, [nulls](auto &field, auto /*name*/,
@@ -495,10 +679,113 @@ class mysql {
         }
       });
 
-      v.push_back(std::move(t));
+      trace.add_row(t);
+      f(t);
+    }
+    if (fetch_ret != MYSQL_NO_DATA) {
+      set_stmt_error();
+      return false;
     }
 
-    return v;
+    return true;
+  }
+
+  template <typename T, typename... Args>
+  column_set<T> query_columns(const std::string &str, Args &&...args) {
+    constexpr auto SIZE = ylt::reflection::members_count_v<T>;
+    std::string sql =
+        contains_select(str) ? str : generate_query_sql<T>(db_type_v, str);
+#ifdef ORMPP_ENABLE_LOG
+    std::cout << sql << std::endl;
+#endif
+
+    if (cursor_busy()) {
+      return {};
+    }
+    trace_scope trace(db_type_v, sql, error_);
+    stmt_ = mysql_stmt_init(con_);
+    if (!stmt_) {
+      set_con_error();
+      return {};
+    }
+
+    auto guard = guard_statment(stmt_, *this);
+
+    if (mysql_stmt_prepare(stmt_, sql.c_str(), (unsigned long)sql.size())) {
+      set_stmt_error();
+      return {};
+    }
+    trace.prepared();
+
+    meta_ = mysql_stmt_result_metadata(stmt_);
+    if (!meta_) {
+      set_stmt_error();
+      return {};
+    }
+
+    auto meta_guard = guard_result(meta_);
+
+    if constexpr (sizeof...(Args) > 0) {
+      std::vector<MYSQL_BIND> param_binds;
+      (set_param_bind(param_binds, args), ...);
+      if (mysql_stmt_bind_param(stmt_, &param_binds[0])) {
+        set_stmt_error();
+        return {};
+      }
+    }
+
+    std::array<decltype(std::declval<MYSQL_BIND>().is_null), SIZE> nulls = {};
+    std::array<MYSQL_BIND, SIZE> param_binds = {};
+    auto &mp = result_buffers_;
+
+    // decoded into one reused row, then moved into the columns
+    T t{};
+    size_t index = 0;
+    column_set<T> cols;
+    ylt::reflection::for_each(
+        t, [&param_binds, &index, &nulls, &mp, this](auto &field, auto /*name*/,
+                                                     auto /*index*/) {
+          set_param_bind(this->meta_, param_binds[index], field, index, mp,
+                         nulls[index]);
+          index++;
+        });
+
+    if (index == 0) {
+      return {};
+    }
+
+    if (mysql_stmt_bind_result(stmt_, &param_binds[0])) {
+      set_stmt_error();
+      return {};
+    }
+
+    if (mysql_stmt_execute(stmt_)) {
+      set_stmt_error();
+      return {};
+    }
+    trace.executed();
+
+    int fetch_ret = 0;
+    while ((fetch_ret = mysql_stmt_fetch(stmt_)) == 0 ||
+           fetch_ret == MYSQL_DATA_TRUNCATED) {
+      ylt::reflection::for_each(
+          t, [&param_binds, &mp, this](auto &field, auto /*name*/, auto index) {
+            set_value(param_binds.at(index), field, index, mp);
+          });
+
+      if (rebind_result_) {
+        rebind_result_ = false;
+        if (mysql_stmt_bind_result(stmt_, &param_binds[0])) {
+          set_stmt_error();
+          return {};
+        }
+      }
+
+      cols.append_row(t, nulls);
+    }
+    trace.set_rows(cols.size());
+
+    return cols;
   }
 
   template <typename T, typename... Args>
@@ -509,22 +796,27 @@ class mysql {
 #ifdef ORMPP_ENABLE_LOG
     std::cout << sql << std::endl;
 #endif
+    if (cursor_busy()) {
+      return {};
+    }
+    trace_scope trace(db_type_v, sql, error_);
     stmt_ = mysql_stmt_init(con_);
     if (!stmt_) {
-      set_last_error(mysql_error(con_));
+      set_con_error();
       return {};
     }
 
-    auto guard = guard_statment(stmt_);
+    auto guard = guard_statment(stmt_, *this);
 
     if (mysql_stmt_prepare(stmt_, sql.c_str(), (int)sql.size())) {
-      set_last_error(mysql_stmt_error(stmt_));
+      set_stmt_error();
       return {};
     }
+    trace.prepared();
 
     meta_ = mysql_stmt_result_metadata(stmt_);
     if (!meta_) {
-      set_last_error(mysql_stmt_error(stmt_));
+      set_stmt_error();
       return {};
     }
 
@@ -535,7 +827,7 @@ class mysql {
       std::vector<MYSQL_BIND> param_binds;
       (set_param_bind(param_binds, args), ...);
       if (mysql_stmt_bind_param(stmt_, &param_binds[0])) {
-        set_last_error(mysql_stmt_error(stmt_));
+        set_stmt_error();
         return {};
       }
     }
@@ -544,7 +836,7 @@ class mysql {
                result_size<T>::value>
         nulls = {};
     std::array<MYSQL_BIND, result_size<T>::value> param_binds = {};
-    std::map<size_t, std::vector<char>> mp;
+    auto &mp = result_buffers_;
 
     T tp{};
     size_t index = 0;
@@ -575,14 +867,15 @@ class mysql {
     }
 
     if (mysql_stmt_bind_result(stmt_, &param_binds[0])) {
-      set_last_error(mysql_stmt_error(stmt_));
+      set_stmt_error();
       return {};
     }
 
     if (mysql_stmt_execute(stmt_)) {
-      set_last_error(mysql_stmt_error(stmt_));
+      set_stmt_error();
       return {};
     }
+    trace.executed();
 
     int fetch_ret2 = 0;
     while ((fetch_ret2 = mysql_stmt_fetch(stmt_)) == 0 ||
@@ -607,8 +900,12 @@ class mysql {
           },
           std::make_index_sequence<SIZE>{});
 
-      for (auto &p : mp) {
-        p.second.assign(p.second.size(), 0);
+      if (rebind_result_) {
+        rebind_result_ = false;
+        if (mysql_stmt_bind_result(stmt_, &param_binds[0])) {
+          set_stmt_error();
+          return {};
+        }
       }
 
       index = 0;
@@ -640,6 +937,7 @@ class mysql {
           },
           std::make_index_sequence<SIZE>{});
 
+      trace.add_row(tp);
       v.push_back(std::move(tp));
     }
 
@@ -683,22 +981,27 @@ class mysql {
     std::cout << sql << std::endl;
 #endif
 
+    if (cursor_busy()) {
+      return {};
+    }
+    trace_scope trace(db_type_v, sql, error_);
     stmt_ = mysql_stmt_init(con_);
     if (!stmt_) {
-      set_last_error(mysql_error(con_));
+      set_con_error();
       return {};
     }
 
-    auto guard = guard_statment(stmt_);
+    auto guard = guard_statment(stmt_, *this);
 
     if (mysql_stmt_prepare(stmt_, sql.c_str(), (unsigned long)sql.size())) {
-      set_last_error(mysql_stmt_error(stmt_));
+      set_stmt_error();
       return {};
     }
+    trace.prepared();
 
     meta_ = mysql_stmt_result_metadata(stmt_);
     if (!meta_) {
-      set_last_error(mysql_stmt_error(stmt_));
+      set_stmt_error();
       return {};
     }
 
@@ -706,7 +1009,7 @@ class mysql {
 
     std::array<decltype(std::declval<MYSQL_BIND>().is_null), SIZE> nulls = {};
     std::array<MYSQL_BIND, SIZE> param_binds = {};
-    std::map<size_t, std::vector<char>> mp;
+    auto &mp = result_buffers_;
 
     T t{};
     size_t index = 0;
@@ -724,14 +1027,15 @@ class mysql {
     }
 
     if (mysql_stmt_bind_result(stmt_, &param_binds[0])) {
-      set_last_error(mysql_stmt_error(stmt_));
+      set_stmt_error();
       return {};
     }
 
     if (mysql_stmt_execute(stmt_)) {
-      set_last_error(mysql_stmt_error(stmt_));
+      set_stmt_error();
       return {};
     }
+    trace.executed();
 
     int fetch_ret3 = 0;
     while ((fetch_ret3 = mysql_stmt_fetch(stmt_)) == 0 ||
@@ -741,8 +1045,12 @@ class mysql {
             set_value(param_binds.at(index), field, index, mp);
           });
 
-      for (auto &p : mp) {
-        p.second.assign(p.second.size(), 0);
+      if (rebind_result_) {
+        rebind_result_ = false;
+        if (mysql_stmt_bind_result(stmt_, &param_binds[0])) {
+          set_stmt_error();
+          return {};
+        }
       }
 
       ylt::reflection::for_each(t, [nulls](auto &field, auto /*name*/,
@@ -755,6 +1063,7 @@ class mysql {
         }
       });
 
+      trace.add_row(t);
       v.push_back(std::move(t));
     }
 
@@ -775,29 +1084,34 @@ class mysql {
     constexpr auto Args_Size = sizeof...(Args);
     if constexpr (Args_Size != 0) {
       if (Args_Size != std::count(sql.begin(), sql.end(), '?')) {
-        set_last_error("arg size error");
+        set_last_error("arg size error", db_errc::invalid_argument);
         return {};
       }
 
       sql = get_sql(sql, std::forward<Args>(args)...);
     }
 
+    if (cursor_busy()) {
+      return {};
+    }
+    trace_scope trace(db_type_v, sql, error_);
     stmt_ = mysql_stmt_init(con_);
     if (!stmt_) {
-      set_last_error(mysql_error(con_));
+      set_con_error();
       return {};
     }
 
-    auto guard = guard_statment(stmt_);
+    auto guard = guard_statment(stmt_, *this);
 
     if (mysql_stmt_prepare(stmt_, sql.c_str(), (int)sql.size())) {
-      set_last_error(mysql_stmt_error(stmt_));
+      set_stmt_error();
       return {};
     }
+    trace.prepared();
 
     meta_ = mysql_stmt_result_metadata(stmt_);
     if (!meta_) {
-      set_last_error(mysql_stmt_error(stmt_));
+      set_stmt_error();
       return {};
     }
 
@@ -807,7 +1121,7 @@ class mysql {
                result_size<T>::value>
         nulls = {};
     std::array<MYSQL_BIND, result_size<T>::value> param_binds = {};
-    std::map<size_t, std::vector<char>> mp;
+    auto &mp = result_buffers_;
 
     T tp{};
     size_t index = 0;
@@ -838,14 +1152,15 @@ class mysql {
     }
 
     if (mysql_stmt_bind_result(stmt_, &param_binds[0])) {
-      set_last_error(mysql_stmt_error(stmt_));
+      set_stmt_error();
       return {};
     }
 
     if (mysql_stmt_execute(stmt_)) {
-      set_last_error(mysql_stmt_error(stmt_));
+      set_stmt_error();
       return {};
     }
+    trace.executed();
 
     int fetch_ret2 = 0;
     while ((fetch_ret2 = mysql_stmt_fetch(stmt_)) == 0 ||
@@ -870,8 +1185,12 @@ class mysql {
           },
           std::make_index_sequence<SIZE>{});
 
-      for (auto &p : mp) {
-        p.second.assign(p.second.size(), 0);
+      if (rebind_result_) {
+        rebind_result_ = false;
+        if (mysql_stmt_bind_result(stmt_, &param_binds[0])) {
+          set_stmt_error();
+          return {};
+        }
       }
 
       index = 0;
@@ -903,6 +1222,7 @@ class mysql {
           },
           std::make_index_sequence<SIZE>{});
 
+      trace.add_row(tp);
       v.push_back(std::move(tp));
     }
 
@@ -920,7 +1240,7 @@ class mysql {
 
     auto retcode = mysql_stmt_fetch_column(stmt_, &param, column, 0);
     if (retcode != 0) {
-      set_last_error(mysql_stmt_error(stmt_));
+      set_stmt_error();
       return 0;
     }
 
@@ -932,23 +1252,30 @@ class mysql {
 #ifdef ORMPP_ENABLE_LOG
     std::cout << sql << std::endl;
 #endif
+    if (cursor_busy()) {
+      return false;
+    }
+    trace_scope trace(db_type_v, sql, error_);
     stmt_ = mysql_stmt_init(con_);
     if (!stmt_) {
-      set_last_error(mysql_error(con_));
+      set_con_error();
       return false;
     }
 
-    auto guard = guard_statment(stmt_);
+    auto guard = guard_statment(stmt_, *this);
     if (mysql_stmt_prepare(stmt_, sql.c_str(), (unsigned long)sql.size())) {
-      set_last_error(mysql_stmt_error(stmt_));
+      set_stmt_error();
       return false;
     }
+    trace.prepared();
 
     if (mysql_stmt_execute(stmt_)) {
-      set_last_error(mysql_stmt_error(stmt_));
+      set_stmt_error();
       return false;
     }
+    trace.executed();
     last_affect_rows_ = (int)mysql_stmt_affected_rows(stmt_);
+    trace.set_rows(last_affect_rows_);
     return true;
   }
 
@@ -957,29 +1284,17 @@ class mysql {
 
   bool begin() {
     reset_error();
-    if (mysql_query(con_, "BEGIN")) {
-      set_last_error(mysql_error(con_));
-      return false;
-    }
-    return true;
+    return simple_query("BEGIN");
   }
 
   bool commit() {
     reset_error();
-    if (mysql_query(con_, "COMMIT")) {
-      set_last_error(mysql_error(con_));
-      return false;
-    }
-    return true;
+    return simple_query("COMMIT");
   }
 
   bool rollback() {
     reset_error();
-    if (mysql_query(con_, "ROLLBACK")) {
-      set_last_error(mysql_error(con_));
-      return false;
-    }
-    return true;
+    return simple_query("ROLLBACK");
   }
 
  private:
@@ -1040,8 +1355,8 @@ class mysql {
     std::string sql;
     sql.append("CREATE TABLE IF NOT EXISTS ").append(table_name).append("(");
     T t;
-    ylt::reflection::for_each(t, [&](auto &field, auto name, size_t index) {
-      using item_type = std::decay_t<decltype(field)>;
+    ylt::reflection::for_each(t, [&](auto & /*field*/, auto name,
+                                     size_t index) {
       sql.append(name).append(" ").append(type_name_arr[index]);
 
       std::string str_name(name);
@@ -1125,12 +1440,12 @@ class mysql {
     }
 
     if (mysql_stmt_bind_param(stmt_, &param_binds[0])) {
-      set_last_error(mysql_stmt_error(stmt_));
+      set_stmt_error();
       return INT_MIN;
     }
 
     if (mysql_stmt_execute(stmt_)) {
-      set_last_error(mysql_stmt_error(stmt_));
+      set_stmt_error();
       return INT_MIN;
     }
 
@@ -1161,7 +1476,8 @@ class mysql {
     auto sql = generate_update_sql<T, members...>(db_type_v,
                                                   std::forward<Args>(args)...);
     if (sql.empty()) {
-      set_last_error("update requires a conflict key or where condition");
+      set_last_error("update requires a conflict key or where condition",
+                     db_errc::invalid_argument);
       return INT_MIN;
     }
     auto res = insert_or_update_impl<members...>(t, sql, OptType::update, false,
@@ -1174,7 +1490,8 @@ class mysql {
     auto sql = generate_update_sql<T, members...>(db_type_v,
                                                   std::forward<Args>(args)...);
     if (sql.empty()) {
-      set_last_error("update requires a conflict key or where condition");
+      set_last_error("update requires a conflict key or where condition",
+                     db_errc::invalid_argument);
       return INT_MIN;
     }
     auto res = insert_or_update_impl<members...>(v, sql, OptType::update, false,
@@ -1191,23 +1508,30 @@ class mysql {
 #ifdef ORMPP_ENABLE_LOG
     std::cout << sql << std::endl;
 #endif
+    if (cursor_busy()) {
+      return std::nullopt;
+    }
+    trace_scope trace(db_type_v, sql, error_);
     stmt_ = mysql_stmt_init(con_);
     if (!stmt_) {
-      set_last_error(mysql_error(con_));
+      set_con_error();
       return std::nullopt;
     }
 
     if (mysql_stmt_prepare(stmt_, sql.c_str(), (int)sql.size())) {
-      set_last_error(mysql_stmt_error(stmt_));
+      set_stmt_error();
       return std::nullopt;
     }
+    trace.prepared();
 
-    auto guard = guard_statment(stmt_);
+    auto guard = guard_statment(stmt_, *this);
 
     if (stmt_execute<members...>(t, type, std::forward<Args>(args)...) ==
         INT_MIN) {
       return std::nullopt;
     }
+    trace.executed();
+    trace.set_rows(1);
 
     return get_insert_id ? stmt_->mysql->insert_id : 1;
   }
@@ -1221,18 +1545,23 @@ class mysql {
 #ifdef ORMPP_ENABLE_LOG
     std::cout << sql << std::endl;
 #endif
+    if (cursor_busy()) {
+      return std::nullopt;
+    }
+    trace_scope trace(db_type_v, sql, error_);
     stmt_ = mysql_stmt_init(con_);
     if (!stmt_) {
-      set_last_error(mysql_error(con_));
+      set_con_error();
       return std::nullopt;
     }
 
     if (mysql_stmt_prepare(stmt_, sql.c_str(), (int)sql.size())) {
-      set_last_error(mysql_stmt_error(stmt_));
+      set_stmt_error();
       return std::nullopt;
     }
+    trace.prepared();
 
-    auto guard = guard_statment(stmt_);
+    auto guard = guard_statment(stmt_, *this);
 
     if (transaction_ && !get_insert_id && !begin()) {
       return std::nullopt;
@@ -1248,6 +1577,9 @@ class mysql {
       }
     }
 
+    trace.executed();
+    trace.set_rows(v.size());
+
     if (transaction_ && !get_insert_id && !commit()) {
       return std::nullopt;
     }
@@ -1256,19 +1588,391 @@ class mysql {
   }
 
  private:
+  struct cached_update {
+    MYSQL_STMT *stmt = nullptr;
+    std::string sql;
+  };
+
+  template <typename T>
+  int update_columns_impl(const T *rows, size_t n, uint64_t columns) {
+    if (cursor_busy()) {
+      return INT_MIN;
+    }
+    auto key = std::make_pair(type_key_of<T>(), columns);
+    auto it = update_stmts_.find(key);
+    if (it == update_stmts_.end()) {
+      auto sql = generate_update_columns_sql<T>(db_type_v, columns);
+      if (sql.empty()) {
+        set_last_error("update requires a conflict key and a column",
+                       db_errc::invalid_argument);
+        return INT_MIN;
+      }
+      if (update_stmts_.size() >= update_stmt_cache_size) {
+        clear_update_stmts();
+      }
+      it = update_stmts_.emplace(key, cached_update{nullptr, std::move(sql)})
+               .first;
+    }
+    int count = execute_update(it->second, rows, n, columns);
+    stmt_ = nullptr;
+    // A failed row (duplicate key, bad value ...) leaves the statement good.
+    // It is prepared again next time only if preparing failed, or the table
+    // or the connection changed under it.
+    if (count == INT_MIN &&
+        (it->second.stmt == nullptr || stale_update(error_.native_code))) {
+      if (it->second.stmt != nullptr) {
+        mysql_stmt_close(it->second.stmt);
+      }
+      update_stmts_.erase(it);
+    }
+    return count;
+  }
+
+  static bool stale_update(int native) {
+    switch (native) {
+      case 1054:  // ER_BAD_FIELD_ERROR
+      case 1146:  // ER_NO_SUCH_TABLE
+      case 1243:  // ER_UNKNOWN_STMT_HANDLER
+      case 1615:  // ER_NEED_REPREPARE
+        return true;
+      default:
+        return mysql_errc(native) == db_errc::connection;
+    }
+  }
+
+  template <typename T>
+  int execute_update(cached_update &cached, const T *rows, size_t n,
+                     uint64_t columns) {
+    reset_error();
+#ifdef ORMPP_ENABLE_LOG
+    std::cout << cached.sql << std::endl;
+#endif
+    trace_scope trace(db_type_v, cached.sql, error_);
+    if (cached.stmt == nullptr) {
+      cached.stmt = mysql_stmt_init(con_);
+      if (cached.stmt == nullptr) {
+        set_con_error();
+        return INT_MIN;
+      }
+      stmt_ = cached.stmt;
+      if (mysql_stmt_prepare(stmt_, cached.sql.c_str(),
+                             (unsigned long)cached.sql.size())) {
+        set_stmt_error();
+        mysql_stmt_close(cached.stmt);
+        cached.stmt = nullptr;
+        return INT_MIN;
+      }
+    }
+    stmt_ = cached.stmt;
+    trace.prepared();
+
+    uint64_t keys = conflict_key_columns<T>();
+    std::vector<MYSQL_BIND> param_binds;
+    int count = 0;
+    for (size_t r = 0; r < n; ++r) {
+      param_binds.clear();
+      for (uint64_t mask : {columns, keys}) {
+        ylt::reflection::for_each(rows[r], [&](auto &field, auto /*name*/,
+                                               size_t member) {
+          if (mask >> member & 1) {
+            set_param_bind(param_binds, field);
+          }
+        });
+      }
+      if (mysql_stmt_bind_param(stmt_, param_binds.data()) ||
+          mysql_stmt_execute(stmt_)) {
+        set_stmt_error();
+        return INT_MIN;
+      }
+      count += (int)mysql_stmt_affected_rows(stmt_);
+    }
+    trace.executed();
+    trace.set_rows(count);
+    return count;
+  }
+
+  void clear_update_stmts() {
+    for (auto &[key, cached] : update_stmts_) {
+      if (cached.stmt != nullptr) {
+        mysql_stmt_close(cached.stmt);
+      }
+    }
+    update_stmts_.clear();
+  }
+
+  bool simple_query(const char *sql) {
+    if (cursor_busy()) {
+      return false;
+    }
+    trace_scope trace(db_type_v, sql, error_);
+    int ret = mysql_query(con_, sql);
+    trace.executed();
+    if (ret) {
+      set_con_error();
+      return false;
+    }
+    return true;
+  }
+
   struct guard_statment {
-    guard_statment(MYSQL_STMT *stmt) : stmt_(stmt) { reset_error(); }
+    guard_statment(MYSQL_STMT *stmt, mysql &db) : stmt_(stmt), db_(db) {
+      db_.reset_error();
+    }
     ~guard_statment() {
       if (stmt_ != nullptr) {
         auto status = mysql_stmt_close(stmt_);
         if (status) {
-          set_last_error("close statment error code " + std::to_string(status));
+          db_.set_last_error(
+              "close statment error code " + std::to_string(status),
+              db_errc::statement);
         }
       }
     }
 
    private:
     MYSQL_STMT *stmt_ = nullptr;
+    mysql &db_;
+  };
+
+  void set_native_error(unsigned native, const char *sqlstate,
+                        const char *message) {
+    error_.assign(mysql_errc(native), message, static_cast<int>(native),
+                  sqlstate ? std::string_view(sqlstate) : std::string_view{});
+    std::cout << error_.message << std::endl;
+  }
+
+  void set_con_error() {
+    set_native_error(mysql_errno(con_), mysql_sqlstate(con_),
+                     mysql_error(con_));
+  }
+
+  // the first value of the result that did not parse
+  void set_invalid_value_error(std::string_view text) {
+    if (!error_) {
+      set_last_error("invalid decimal or temporal value '" +
+                         std::string(text) + "'",
+                     db_errc::protocol);
+    }
+  }
+
+  void set_stmt_error() {
+    set_native_error(mysql_stmt_errno(stmt_), mysql_stmt_sqlstate(stmt_),
+                     mysql_stmt_error(stmt_));
+  }
+
+  // Text and blob columns start with at most this much, a LONGBLOB declares
+  // 4GB. Buffers grown past the retained size are given back on the next bind.
+  static constexpr unsigned long initial_result_buffer = 1024;
+  static constexpr size_t max_retained_result_buffer = 1024 * 1024;
+
+  template <typename U>
+  static MYSQL_TIME to_mysql_time(const U &value) {
+    MYSQL_TIME time = {};
+    std::chrono::year_month_day ymd;
+    if constexpr (is_sql_date_v<U>) {
+      ymd = value;
+      time.time_type = MYSQL_TIMESTAMP_DATE;
+    }
+    else {
+      auto tp = std::chrono::floor<std::chrono::microseconds>(value);
+      auto days = std::chrono::floor<std::chrono::days>(tp);
+      std::chrono::hh_mm_ss<std::chrono::microseconds> hms(tp - days);
+      ymd = std::chrono::year_month_day(days);
+      time.hour = (unsigned)hms.hours().count();
+      time.minute = (unsigned)hms.minutes().count();
+      time.second = (unsigned)hms.seconds().count();
+      time.second_part = (unsigned long)hms.subseconds().count();
+      time.time_type = MYSQL_TIMESTAMP_DATETIME;
+    }
+    time.year = (unsigned)(int)ymd.year();
+    time.month = (unsigned)ymd.month();
+    time.day = (unsigned)ymd.day();
+    return time;
+  }
+
+  template <typename U>
+  static U from_mysql_time(const MYSQL_TIME &time) {
+    std::chrono::year_month_day ymd{std::chrono::year{(int)time.year},
+                                    std::chrono::month{time.month},
+                                    std::chrono::day{time.day}};
+    if constexpr (is_sql_date_v<U>) {
+      return ymd;
+    }
+    else {
+      auto tp = std::chrono::sys_days(ymd) + std::chrono::hours(time.hour) +
+                std::chrono::minutes(time.minute) +
+                std::chrono::seconds(time.second) +
+                std::chrono::microseconds(time.second_part);
+      return std::chrono::time_point_cast<typename U::duration>(tp);
+    }
+  }
+
+  static unsigned long result_buffer_size(MYSQL_FIELD *field) {
+    if (field && field->length < initial_result_buffer) {
+      return field->length + 1;
+    }
+    return initial_result_buffer;
+  }
+
+  static void bind_result_buffer(MYSQL_BIND &param_bind, column_buffer &buf,
+                                 size_t size) {
+    buf.reset(size);
+    param_bind.buffer = buf.data.data();
+    param_bind.buffer_length = (unsigned long)buf.data.size();
+    param_bind.length = &buf.length;
+  }
+
+  // The value of column i in the current row. A truncated value is fetched
+  // again into a grown buffer, which is bound for the following rows.
+  std::string_view fetch_result_buffer(MYSQL_BIND &param_bind, int i,
+                                       column_buffer &buf) {
+    if (*param_bind.is_null) {
+      return {};
+    }
+    if (buf.length > buf.data.size()) {
+      buf.data.resize(buf.length);
+      param_bind.buffer = buf.data.data();
+      param_bind.buffer_length = (unsigned long)buf.data.size();
+      if (mysql_stmt_fetch_column(stmt_, &param_bind, i, 0)) {
+        set_stmt_error();
+        return {};
+      }
+      rebind_result_ = true;
+    }
+    return std::string_view(buf.data.data(), buf.length);
+  }
+
+  // Callbacks of mysql_set_local_infile_handler, producing the text of
+  // bulk_load row by row as the client library asks for it.
+  template <typename T, typename Range>
+  struct infile_source {
+    std::ranges::iterator_t<const Range> it;
+    std::ranges::sentinel_t<const Range> last;
+    std::array<bool, ylt::reflection::members_count_v<T>> columns;
+    std::string text;
+    size_t pos = 0;
+
+    static int init(void **ptr, const char * /*filename*/, void *userdata) {
+      *ptr = userdata;
+      return 0;
+    }
+
+    static int read(void *ptr, char *buf, unsigned int buf_len) {
+      auto self = static_cast<infile_source *>(ptr);
+      if (self->pos == self->text.size()) {
+        self->text.clear();
+        self->pos = 0;
+        while (self->text.size() < buf_len && self->it != self->last) {
+          self->append_row(*self->it);
+          ++self->it;
+        }
+      }
+      size_t n = (std::min)(size_t(buf_len), self->text.size() - self->pos);
+      std::memcpy(buf, self->text.data() + self->pos, n);
+      self->pos += n;
+      return (int)n;
+    }
+
+    static void end(void * /*ptr*/) {}
+
+    static int error(void * /*ptr*/, char *msg, unsigned int msg_len) {
+      std::snprintf(msg, msg_len, "ormpp bulk_load failed");
+      return 2000;  // CR_UNKNOWN_ERROR
+    }
+
+    void append_row(const T &row) {
+      ylt::reflection::for_each(row, [this](auto &field, auto /*name*/,
+                                            size_t index) {
+        if (columns[index]) {
+          append_field(field);
+          text.push_back('\t');
+        }
+      });
+      text.back() = '\n';
+    }
+
+    template <typename U>
+    void append_field(const U &value) {
+      if constexpr (is_optional_v<U>::value) {
+        if (value.has_value()) {
+          append_field(*value);
+        }
+        else {
+          text.append("\\N");
+        }
+      }
+      else if constexpr (std::is_enum_v<U>) {
+        text.append(std::to_string(static_cast<int64_t>(value)));
+      }
+      else if constexpr (std::is_same_v<char, U>) {
+        append_text(std::string_view(&value, 1));
+      }
+      else if constexpr (std::is_integral_v<U>) {
+        text.append(std::to_string(value));
+      }
+      else if constexpr (std::is_floating_point_v<U>) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.*g",
+                      std::numeric_limits<U>::max_digits10,
+                      static_cast<double>(value));
+        text.append(buf);
+      }
+      else if constexpr (std::is_same_v<std::string, U> ||
+                         std::is_same_v<std::string_view, U>) {
+        append_text(value);
+      }
+      else if constexpr (iguana::array_v<U>) {
+        append_text(std::string_view(value.data(),
+                                     strnlen(value.data(), value.size())));
+      }
+      else if constexpr (iguana::c_array_v<U>) {
+        append_text(std::string_view(value, strnlen(value, sizeof(U))));
+      }
+      else if constexpr (std::is_same_v<blob, U>) {
+        append_text(std::string_view(value.data(), value.size()));
+      }
+      else if constexpr (is_sql_value_type_v<U>) {
+        append_sql_text(text, value);
+      }
+      else if constexpr (is_json_column_v<U>) {
+        std::string json;
+        append_column_text(json, value, column_text::json);
+        append_text(json);
+      }
+#ifdef ORMPP_WITH_CSTRING
+      else if constexpr (std::is_same_v<CString, U>) {
+        append_text(std::string_view(value.GetString(), value.GetLength()));
+      }
+#endif
+      else {
+        static_assert(!sizeof(U), "this type has not supported yet");
+      }
+    }
+
+    // the escapes LOAD DATA reads back with ESCAPED BY '\\'
+    void append_text(std::string_view str) {
+      for (char c : str) {
+        switch (c) {
+          case '\\':
+            text.append("\\\\");
+            break;
+          case '\t':
+            text.append("\\t");
+            break;
+          case '\n':
+            text.append("\\n");
+            break;
+          case '\r':
+            text.append("\\r");
+            break;
+          case '\0':
+            text.append("\\0");
+            break;
+          default:
+            text.push_back(c);
+        }
+      }
+    }
   };
 
   struct guard_result {
@@ -1284,14 +1988,34 @@ class mysql {
   };
 
  private:
+  // fails a statement issued from inside a query_each callback, see
+  // cursor_scope
+  bool cursor_busy() {
+    if (!in_cursor_) {
+      return false;
+    }
+    set_last_error(std::string(cursor_busy_error), db_errc::invalid_argument);
+    return true;
+  }
+
   MYSQL *con_ = nullptr;
   MYSQL_STMT *stmt_ = nullptr;
   MYSQL_RES *meta_ = nullptr;
   int last_affect_rows_ = 0;
-  inline static std::string sv_;
-  inline static std::string last_error_;
-  inline static bool has_error_ = false;
-  inline static bool transaction_ = true;
+  std::string sv_;
+  string_arena *arena_ = nullptr;
+  // set while query_each reads rows
+  bool in_cursor_ = false;
+  std::map<size_t, column_buffer> result_buffers_;
+  bool rebind_result_ = false;
+  // MYSQL_TIME, decimal and json text of the bound parameters, in deques so the
+  // binds keep pointing at them while more are added
+  std::deque<MYSQL_TIME> param_times_;
+  std::deque<std::string> param_texts_;
+  db_error error_;
+  bool transaction_ = true;
+  // update_columns statements by struct and column mask
+  std::map<std::pair<type_key, uint64_t>, cached_update> update_stmts_;
 };
 }  // namespace ormpp
 
@@ -12,6 +12,7 @@
 #include <array>
 #include <asio.hpp>
 #include <asio/steady_timer.hpp>
+#include <cctype>
 #include <charconv>
 #include <chrono>
 #include <cstdint>
@@ -32,8 +33,10 @@
 #include <vector>
 
 #include "async_traits.hpp"
+#include "db_error.hpp"
 #include "entity.hpp"
 #include "query.hpp"
+#include "query_trace.hpp"
 #include "type_mapping.hpp"
 
 namespace ormpp {
@@ -164,8 +167,23 @@ inline void append_le64(bytes& out, std::uint64_t value) {
   }
 }
 
-inline std::runtime_error make_protocol_error(const std::string& msg) {
-  return std::runtime_error("mysql_async protocol error: " + msg);
+struct protocol_error : std::runtime_error {
+  using std::runtime_error::runtime_error;
+};
+
+// An error packet sent by the server, the code and SQLSTATE are kept for
+// db_error.
+struct server_error : std::runtime_error {
+  server_error(const std::string& what, error_packet packet)
+      : std::runtime_error(what + " [" + std::to_string(packet.code) + "] " +
+                           packet.message),
+        err(std::move(packet)) {}
+
+  error_packet err;
+};
+
+inline protocol_error make_protocol_error(const std::string& msg) {
+  return protocol_error("mysql_async protocol error: " + msg);
 }
 
 struct packet_reader {
@@ -326,6 +344,36 @@ inline bool is_ok_packet(const bytes& payload) {
   return !payload.empty() && payload[0] == 0x00;
 }
 
+// A statement starting with SELECT, after comments. It can not write by
+// itself, so it may run behind a pipelined BEGIN whose failure is only known
+// once the statement has run in autocommit.
+inline bool is_plain_select(std::string_view sql) {
+  std::size_t i = 0;
+  while (i < sql.size()) {
+    if (std::isspace(static_cast<unsigned char>(sql[i]))) {
+      ++i;
+      continue;
+    }
+    std::size_t end = skip_sql_quoted_or_comment(sql, i);
+    if (end == i || sql[i] == '\'' || sql[i] == '"') {
+      break;
+    }
+    i = end + 1;
+  }
+  constexpr std::string_view keyword = "select";
+  if (sql.size() - i < keyword.size()) {
+    return false;
+  }
+  for (std::size_t k = 0; k < keyword.size(); ++k) {
+    if (std::tolower(static_cast<unsigned char>(sql[i + k])) != keyword[k]) {
+      return false;
+    }
+  }
+  i += keyword.size();
+  return i == sql.size() ||
+         !(std::isalnum(static_cast<unsigned char>(sql[i])) || sql[i] == '_');
+}
+
 inline bool is_auth_switch_request(const bytes& payload) {
   return !payload.empty() && payload[0] == 0xfe && payload.size() > 1;
 }
@@ -338,6 +386,109 @@ inline bool looks_like_eof_packet(const bytes& payload) {
   return payload.size() < 9 && !payload.empty() && payload[0] == 0xfe;
 }
 
+// Receive buffer of a connection. Socket reads land here in large chunks and
+// packets are cut out of it without further I/O, so a result set costs one
+// read per buffer fill instead of two reads (and two coroutines) per row.
+class packet_buffer {
+ public:
+  static constexpr std::size_t min_read = 16 * 1024;
+  static constexpr std::size_t max_retained = 4 * 1024 * 1024;
+
+  void clear() {
+    begin_ = 0;
+    end_ = 0;
+  }
+
+  // Free space for the next socket read, at least min_read bytes.
+  asio::mutable_buffer prepare() {
+    if (begin_ == end_) {
+      clear();
+      if (data_.size() > max_retained) {
+        // a huge packet went through, do not keep its memory around
+        bytes().swap(data_);
+      }
+    }
+    else if (begin_ > 0 && data_.size() - end_ < min_read) {
+      std::memmove(data_.data(), data_.data() + begin_, end_ - begin_);
+      end_ -= begin_;
+      begin_ = 0;
+    }
+    if (data_.size() - end_ < min_read) {
+      data_.resize(end_ + min_read);
+    }
+    return asio::buffer(data_.data() + end_, data_.size() - end_);
+  }
+
+  void commit(std::size_t size) { end_ += size; }
+
+  // Moves the next complete packet, joined with its continuation chunks, to
+  // payload. Returns false when more bytes have to be read first.
+  bool take_packet(bytes& payload, byte& sequence_id) {
+    std::size_t pos = begin_;
+    std::size_t total = 0;
+    for (;;) {
+      if (end_ - pos < 4) {
+        return false;
+      }
+      auto size = read_le24(data_.data() + pos);
+      if (end_ - pos - 4 < size) {
+        return false;
+      }
+      total += size;
+      pos += 4 + size;
+      if (size != max_packet_chunk) {
+        break;
+      }
+    }
+
+    payload.clear();
+    payload.reserve(total);
+    pos = begin_;
+    for (;;) {
+      auto size = read_le24(data_.data() + pos);
+      sequence_id = static_cast<byte>(data_[pos + 3] + 1);
+      auto first = data_.begin() + static_cast<std::ptrdiff_t>(pos + 4);
+      payload.insert(payload.end(), first,
+                     first + static_cast<std::ptrdiff_t>(size));
+      pos += 4 + size;
+      if (size != max_packet_chunk) {
+        break;
+      }
+    }
+    begin_ = pos;
+    return true;
+  }
+
+ private:
+  bytes data_;
+  std::size_t begin_ = 0;
+  std::size_t end_ = 0;
+};
+
+// Shared by a command and its deadline handler, which may run after the
+// command finished or the connection is gone.
+struct deadline_state {
+  asio::ip::tcp::socket* socket = nullptr;
+  bool expired = false;
+};
+
+struct deadline_scope {
+  std::shared_ptr<deadline_state> state;
+  asio::steady_timer* timer = nullptr;
+
+  ~deadline_scope() {
+    if (state) {
+      state->socket = nullptr;
+      timer->cancel();
+    }
+  }
+};
+
+inline bool is_operation_aborted(const std::exception& e) {
+  auto sys = dynamic_cast<const std::system_error*>(&e);
+  return sys != nullptr && sys->code() == std::errc::operation_canceled;
+}
+
 inline error_packet parse_error_packet(const bytes& payload) {
   packet_reader rd(payload);
   if (rd.read_byte() != 0xff) {
@@ -621,6 +772,10 @@ inline std::string_view store_string_view(std::string_view value) {
   return string_view_storage.back();
 }
 
+// The first temporal or decimal text of a result that did not parse, the
+// value is reset and the row kept as by the mysql and postgresql backends.
+inline thread_local std::string invalid_value;
+
 // RAII wrapper for automatic string_view storage cleanup
 struct string_view_scope_guard {
   ~string_view_scope_guard() { clear_string_view_storage(); }
@@ -703,6 +858,17 @@ inline std::string to_query_arg_impl(const T& value,
   else if constexpr (std::is_same_v<U, blob>) {
     return blob_to_hex(value);
   }
+  else if constexpr (is_sql_value_type_v<U>) {
+    std::string out = "'";
+    append_sql_text(out, value);
+    out.push_back('\'');
+    return out;
+  }
+  else if constexpr (is_json_column_v<U>) {
+    std::string json;
+    append_column_text(json, value, column_text::json);
+    return escape_mysql_string(json, no_backslash_escapes);
+  }
 #ifdef ORMPP_WITH_CSTRING
   else if constexpr (std::is_same_v<U, CString>) {
     return escape_mysql_string(
@@ -889,6 +1055,19 @@ inline void assign_text_value(T& value,
   else if constexpr (std::is_same_v<U, blob>) {
     value.assign(text.begin(), text.end());
   }
+  else if constexpr (is_sql_value_type_v<U>) {
+    if (!parse_sql_text(text, value)) {
+      value = U{};
+      if (invalid_value.empty()) {
+        invalid_value = "invalid decimal or temporal value '" + text + "'";
+      }
+    }
+  }
+  else if constexpr (is_json_column_v<U>) {
+    if (!parse_column_text(text, value, column_text::json)) {
+      throw std::runtime_error("mysql_async: invalid json column");
+    }
+  }
 #ifdef ORMPP_WITH_CSTRING
   else if constexpr (std::is_same_v<U, CString>) {
     value = text.c_str();
@@ -1071,50 +1250,122 @@ std::string generate_create_table_sql(DBType db_type, bool append_mysql_charset,
 
 }  // namespace detail::mysql_async
 
-class mysql_async {
- public:
+// I/O policy of basic_mysql_async: the coroutine type of the engine and the
+// three socket operations it needs. Failures are reported by throwing
+// std::system_error, like asio::use_awaitable does.
+struct asio_mysql_io {
   using executor_type = asio::any_io_executor;
   template <typename T>
   using awaitable = asio::awaitable<T, executor_type>;
 
+  static awaitable<void> connect(asio::ip::tcp::resolver& resolver,
+                                 asio::ip::tcp::socket& socket,
+                                 const std::string& host,
+                                 const std::string& port) {
+    auto endpoints =
+        co_await resolver.async_resolve(host, port, asio::use_awaitable);
+    co_await asio::async_connect(socket, endpoints, asio::use_awaitable);
+  }
+
+  static auto read_some(asio::ip::tcp::socket& socket,
+                        asio::mutable_buffer buf) {
+    return socket.async_read_some(buf, asio::use_awaitable);
+  }
+
+  static auto write(asio::ip::tcp::socket& socket, asio::const_buffer buf) {
+    return asio::async_write(socket, buf, asio::use_awaitable);
+  }
+
+  static void spawn(const executor_type& executor, awaitable<void> task) {
+    asio::co_spawn(executor, std::move(task), asio::detached);
+  }
+};
+
+// MySQL text protocol engine. The packet codec, the statement formatting and
+// the error handling are shared by every I/O policy, mysql_async runs it as
+// asio coroutines and mysql_async_lazy (mysql_async_lazy.hpp) as
+// async_simple::coro::Lazy.
+template <typename Io>
+class basic_mysql_async {
+ public:
+  using io_type = Io;
+  using executor_type = typename Io::executor_type;
+  template <typename T>
+  using awaitable = typename Io::template awaitable<T>;
+
   static constexpr DBType db_type_v = DBType::mysql;
 
-  explicit mysql_async(executor_type executor)
+  explicit basic_mysql_async(executor_type executor)
       : executor_(std::move(executor)),
         resolver_(executor_),
         timer_(executor_) {}
 
-  explicit mysql_async(asio::io_context& ctx)
-      : mysql_async(ctx.get_executor()) {}
+  explicit basic_mysql_async(asio::io_context& ctx)
+      : basic_mysql_async(ctx.get_executor()) {}
+
+  ~basic_mysql_async() { close_socket(); }
 
-  ~mysql_async() { close_socket(); }
+  basic_mysql_async(const basic_mysql_async&) = delete;
+  basic_mysql_async& operator=(const basic_mysql_async&) = delete;
+  basic_mysql_async(basic_mysql_async&&) = default;
+  basic_mysql_async& operator=(basic_mysql_async&&) = default;
 
-  mysql_async(const mysql_async&) = delete;
-  mysql_async& operator=(const mysql_async&) = delete;
-  mysql_async(mysql_async&&) = default;
-  mysql_async& operator=(mysql_async&&) = default;
+  bool has_error() const { return static_cast<bool>(error_); }
 
-  bool has_error() const { return has_error_; }
+  void reset_error() { error_.clear(); }
 
-  void reset_error() {
-    has_error_ = false;
-    last_error_.clear();
+  void set_last_error(std::string error, db_errc code = db_errc::unknown) {
+    error_.assign(code, std::move(error));
+#ifdef ORMPP_ENABLE_LOG
+    std::cout << error_.message << std::endl;
+#endif
   }
 
-  void set_last_error(std::string error) {
-    has_error_ = true;
-    last_error_ = std::move(error);
+  // Classifies the exceptions thrown by the protocol layer.
+  void set_last_error(const std::exception& e) {
+    if (auto server = dynamic_cast<const detail::mysql_async::server_error*>(
+            &e)) {
+      error_.assign(mysql_errc(server->err.code), e.what(), server->err.code,
+                    server->err.sql_state);
+    }
+    else if (dynamic_cast<const detail::mysql_async::protocol_error*>(&e)) {
+      error_.assign(db_errc::protocol, e.what());
+    }
+    else if (auto sys = dynamic_cast<const std::system_error*>(&e)) {
+      auto code = sys->code() == std::errc::timed_out ? db_errc::timeout
+                                                      : db_errc::connection;
+      error_.assign(code, e.what(), sys->code().value());
+    }
+    else {
+      error_.assign(db_errc::unknown, e.what());
+    }
 #ifdef ORMPP_ENABLE_LOG
-    std::cout << last_error_ << std::endl;
+    std::cout << error_.message << std::endl;
 #endif
   }
 
-  std::string get_last_error() const { return last_error_; }
+  std::string get_last_error() const { return error_.message; }
+
+  const db_error& get_error() const { return error_; }
 
   int get_last_affect_rows() const { return last_affect_rows_; }
 
   void set_enable_transaction(bool enable) { transaction_ = enable; }
 
+  // Deadline of every command sent on this connection, zero (the default)
+  // waits forever. A statement running past it is stopped with KILL QUERY
+  // from a side connection and this connection is closed, the call fails
+  // with db_errc::timeout. Cancelling the awaiting coroutine (asio
+  // cancellation slot, awaitable_operators) ends the same way, without the
+  // timeout error.
+  void set_query_timeout(std::chrono::milliseconds timeout) {
+    query_timeout_ = timeout;
+  }
+
+  std::chrono::milliseconds query_timeout() const { return query_timeout_; }
+
+  bool is_open() const { return connected_ && socket_ && socket_->is_open(); }
+
   awaitable<bool> connect(
       const std::tuple<std::string, std::string, std::string, std::string,
                        std::optional<int>, std::optional<int>>& tp) {
@@ -1143,10 +1394,9 @@ class mysql_async {
       port_ = port.value_or(3306);
       timeout_seconds_ = timeout.value_or(0);
       sequence_id_ = 0;
+      rbuf_.clear();
 
-      auto endpoints = co_await resolver_.async_resolve(
-          host_, std::to_string(port_), asio::use_awaitable);
-      co_await asio::async_connect(*socket_, endpoints, asio::use_awaitable);
+      co_await Io::connect(resolver_, *socket_, host_, std::to_string(port_));
 
       auto handshake_payload = co_await read_packet();
       auto handshake =
@@ -1158,6 +1408,7 @@ class mysql_async {
               ? std::string(detail::mysql_async::mysql_native_password)
               : handshake.auth_plugin_name;
       scramble_ = handshake.scramble;
+      connection_id_ = handshake.connection_id;
 
       std::uint32_t client_caps =
           detail::mysql_async::client_long_password |
@@ -1187,7 +1438,7 @@ class mysql_async {
       connected_ = true;
       co_return true;
     } catch (const std::exception& e) {
-      set_last_error(e.what());
+      set_last_error(e);
       close_socket();
       co_return false;
     }
@@ -1200,10 +1451,10 @@ class mysql_async {
 
   awaitable<bool> ping() {
     try {
-      auto result = co_await command_simple(0x0e, {});
+      auto result = co_await command(0x0e, {});
       co_return !result.has_resultset;
     } catch (const std::exception& e) {
-      set_last_error(e.what());
+      set_last_error(e);
       co_return false;
     }
   }
@@ -1218,7 +1469,7 @@ class mysql_async {
 #endif
       co_return co_await execute(sql);
     } catch (const std::exception& e) {
-      set_last_error(e.what());
+      set_last_error(e);
       co_return false;
     }
   }
@@ -1249,7 +1500,8 @@ class mysql_async {
       auto sql = generate_update_sql<T, members...>(
           db_type_v, std::forward<Args>(args)...);
       if (sql.empty()) {
-        set_last_error("update requires a conflict key or where condition");
+        set_last_error("update requires a conflict key or where condition",
+                       db_errc::invalid_argument);
         co_return std::numeric_limits<int>::min();
       }
       auto formatted = format_struct_sql<t_is_vector_false>(
@@ -1257,7 +1509,7 @@ class mysql_async {
       auto ok = co_await execute(formatted);
       co_return ok ? last_affect_rows_ : std::numeric_limits<int>::min();
     } catch (const std::exception& e) {
-      set_last_error(e.what());
+      set_last_error(e);
       co_return std::numeric_limits<int>::min();
     }
   }
@@ -1268,7 +1520,8 @@ class mysql_async {
       auto sql = generate_update_sql<T, members...>(
           db_type_v, std::forward<Args>(args)...);
       if (sql.empty()) {
-        set_last_error("update requires a conflict key or where condition");
+        set_last_error("update requires a conflict key or where condition",
+                       db_errc::invalid_argument);
         co_return std::numeric_limits<int>::min();
       }
       int affected = 0;
@@ -1297,7 +1550,7 @@ class mysql_async {
       }
       co_return affected;
     } catch (const std::exception& e) {
-      set_last_error(e.what());
+      set_last_error(e);
       co_return std::numeric_limits<int>::min();
     }
   }
@@ -1338,7 +1591,7 @@ class mysql_async {
           ? static_cast<std::uint64_t>(last_affect_rows_)
           : 0;
     } catch (const std::exception& e) {
-      set_last_error(e.what());
+      set_last_error(e);
       co_return 0;
     }
   }
@@ -1366,12 +1619,18 @@ class mysql_async {
       detail::mysql_async::clear_string_view_storage();
       std::vector<T> rows;
       rows.reserve(result.rows.size());
+      detail::mysql_async::invalid_value.clear();
       for (const auto& row : result.rows) {
         rows.push_back(detail::mysql_async::map_row<T>(row));
       }
+      if (!detail::mysql_async::invalid_value.empty()) {
+        error_.assign(db_errc::protocol,
+                      std::move(detail::mysql_async::invalid_value));
+        detail::mysql_async::invalid_value.clear();
+      }
       co_return rows;
     } catch (const std::exception& e) {
-      set_last_error(e.what());
+      set_last_error(e);
       co_return std::vector<T>{};
     }
   }
@@ -1399,12 +1658,18 @@ class mysql_async {
       detail::mysql_async::clear_string_view_storage();
       std::vector<T> rows;
       rows.reserve(result.rows.size());
+      detail::mysql_async::invalid_value.clear();
       for (const auto& row : result.rows) {
         rows.push_back(detail::mysql_async::map_row<T>(row));
       }
+      if (!detail::mysql_async::invalid_value.empty()) {
+        error_.assign(db_errc::protocol,
+                      std::move(detail::mysql_async::invalid_value));
+        detail::mysql_async::invalid_value.clear();
+      }
       co_return rows;
     } catch (const std::exception& e) {
-      set_last_error(e.what());
+      set_last_error(e);
       co_return std::vector<T>{};
     }
   }
@@ -1463,14 +1728,31 @@ class mysql_async {
       }
       co_return true;
     } catch (const std::exception& e) {
-      set_last_error(e.what());
+      set_last_error(e);
       co_return false;
     }
   }
 
   awaitable<bool> begin() { co_return co_await execute("BEGIN"); }
-  awaitable<bool> commit() { co_return co_await execute("COMMIT"); }
-  awaitable<bool> rollback() { co_return co_await execute("ROLLBACK"); }
+  awaitable<bool> commit() {
+    if (std::exchange(begin_pending_, false)) {
+      co_return true;
+    }
+    co_return co_await execute("COMMIT");
+  }
+  awaitable<bool> rollback() {
+    if (std::exchange(begin_pending_, false)) {
+      co_return true;
+    }
+    co_return co_await execute("ROLLBACK");
+  }
+
+  // BEGIN without a round trip of its own when the next query is a SELECT: it
+  // is written together with it and its response read ahead of the query's
+  // one. Before any other statement BEGIN is sent alone first, so that a
+  // write never runs outside the transaction. A commit or rollback before any
+  // query does not reach the server at all.
+  void defer_begin() { begin_pending_ = true; }
 
  private:
   void close_socket() noexcept {
@@ -1480,7 +1762,10 @@ class mysql_async {
       socket_->close(ec);
     }
     socket_.reset();
+    rbuf_.clear();
+    begin_pending_ = false;
     connected_ = false;
+    connection_id_ = 0;
   }
 
   template <typename CompletionToken>
@@ -1494,41 +1779,76 @@ class mysql_async {
     return timer_.async_wait(std::forward<CompletionToken>(token));
   }
 
-  awaitable<detail::mysql_async::bytes> read_packet() {
+  std::shared_ptr<detail::mysql_async::deadline_state> arm_deadline() {
+    if (query_timeout_.count() <= 0) {
+      return nullptr;
+    }
+    auto state = std::make_shared<detail::mysql_async::deadline_state>();
+    state->socket = &*socket_;
+    timer_.expires_after(query_timeout_);
+    timer_.async_wait([state](const asio::error_code& ec) {
+      if (ec || state->socket == nullptr) {
+        return;
+      }
+      state->expired = true;
+      asio::error_code ignored;
+      state->socket->cancel(ignored);
+    });
+    return state;
+  }
+
+  // The server is still running or sending the response of a command whose
+  // wait was cut short. A side connection kills the statement so it stops
+  // holding locks, this connection is closed as its stream is out of sync.
+  void abort_command(detail::mysql_async::byte cmd) {
+    if (cmd == 0x03 && connection_id_ != 0) {
+      Io::spawn(executor_, kill_query(executor_, host_, user_, password_,
+                                      port_, connection_id_));
+    }
+    close_socket();
+  }
+
+  static awaitable<void> kill_query(executor_type executor, std::string host,
+                                    std::string user, std::string password,
+                                    int port, std::uint32_t connection_id) {
+    basic_mysql_async side(std::move(executor));
+    std::string no_database;
+    std::optional<int> no_timeout;
+    std::optional<int> side_port = port;
+    bool ok = co_await side.connect(host, user, password, no_database,
+                                    no_timeout, side_port);
+    if (ok) {
+      auto sql = "KILL QUERY " + std::to_string(connection_id);
+      co_await side.execute(sql);
+    }
+  }
+
+  void ensure_socket() const {
     if (!socket_ || !socket_->is_open()) {
-      throw std::runtime_error("mysql_async: socket is not connected");
+      throw std::system_error(
+          std::make_error_code(std::errc::not_connected),
+          "mysql_async: socket is not connected");
     }
+  }
 
-    detail::mysql_async::bytes payload;
-    for (;;) {
-      std::array<detail::mysql_async::byte, 4> header_buf{};
-      co_await asio::async_read(*socket_, asio::buffer(header_buf),
-                                asio::use_awaitable);
-
-      detail::mysql_async::packet_header header;
-      header.payload_size = detail::mysql_async::read_le24(header_buf.data());
-      header.sequence_id = header_buf[3];
-      sequence_id_ =
-          static_cast<detail::mysql_async::byte>(header.sequence_id + 1);
-
-      detail::mysql_async::bytes chunk(header.payload_size);
-      if (header.payload_size > 0) {
-        co_await asio::async_read(*socket_, asio::buffer(chunk),
-                                  asio::use_awaitable);
-      }
-      payload.insert(payload.end(), chunk.begin(), chunk.end());
+  // Not a coroutine: the read is awaited by the caller directly, the result
+  // has to be committed to rbuf_.
+  auto fill_read_buffer() {
+    ensure_socket();
+    return Io::read_some(*socket_, rbuf_.prepare());
+  }
 
-      if (header.payload_size != detail::mysql_async::max_packet_chunk) {
-        break;
-      }
+  // Used by the handshake, the command path reads rbuf_ inline.
+  awaitable<detail::mysql_async::bytes> read_packet() {
+    detail::mysql_async::bytes payload;
+    while (!rbuf_.take_packet(payload, sequence_id_)) {
+      rbuf_.commit(co_await fill_read_buffer());
     }
     co_return payload;
   }
 
   awaitable<void> write_packet(detail::mysql_async::bytes payload) {
-    if (!socket_ || !socket_->is_open()) {
-      throw std::runtime_error("mysql_async: socket is not connected");
-    }
+    ensure_socket();
 
     std::size_t offset = 0;
     do {
@@ -1544,15 +1864,13 @@ class mysql_async {
       frame.insert(
           frame.end(), payload.begin() + static_cast<std::ptrdiff_t>(offset),
           payload.begin() + static_cast<std::ptrdiff_t>(offset + chunk_size));
-      co_await asio::async_write(*socket_, asio::buffer(frame),
-                                 asio::use_awaitable);
+      co_await Io::write(*socket_, asio::buffer(frame));
 
       offset += chunk_size;
       if (chunk_size == detail::mysql_async::max_packet_chunk &&
           offset == payload.size()) {
         detail::mysql_async::bytes empty_frame = {0, 0, 0, sequence_id_++};
-        co_await asio::async_write(*socket_, asio::buffer(empty_frame),
-                                   asio::use_awaitable);
+        co_await Io::write(*socket_, asio::buffer(empty_frame));
       }
     } while (offset < payload.size());
   }
@@ -1595,9 +1913,9 @@ class mysql_async {
   awaitable<bool> handle_auth_response(detail::mysql_async::bytes payload) {
     for (;;) {
       if (detail::mysql_async::is_err_packet(payload)) {
-        auto err = detail::mysql_async::parse_error_packet(payload);
-        throw std::runtime_error("mysql_async auth failed [" +
-                                 std::to_string(err.code) + "] " + err.message);
+        throw detail::mysql_async::server_error(
+            "mysql_async auth failed",
+            detail::mysql_async::parse_error_packet(payload));
       }
 
       if (detail::mysql_async::is_ok_packet(payload) &&
@@ -1700,63 +2018,162 @@ class mysql_async {
         (status_flags_ & detail::mysql_async::status_no_backslash_escapes) == 0;
   }
 
-  awaitable<detail::mysql_async::query_result> command_simple(
-      detail::mysql_async::byte command, std::string_view sql) {
-    detail::mysql_async::bytes request;
-    request.push_back(command);
-    request.insert(request.end(), sql.begin(), sql.end());
-    sequence_id_ = 0;
-    co_await write_packet(std::move(request));
-    co_return co_await read_query_response();
-  }
-
   awaitable<detail::mysql_async::query_result> query_text(
       const std::string& sql) {
-    co_return co_await command_simple(0x03, sql);
-  }
-
-  awaitable<detail::mysql_async::query_result> read_query_response() {
-    auto payload = co_await read_packet();
-    if (detail::mysql_async::is_err_packet(payload)) {
-      auto err = detail::mysql_async::parse_error_packet(payload);
-      throw std::runtime_error("mysql_async query failed [" +
-                               std::to_string(err.code) + "] " + err.message);
+    return command(0x03, sql);
+  }
+
+  // Appends one command packet, sequence id 0, to wbuf_.
+  void append_command(detail::mysql_async::byte cmd, std::string_view sql) {
+    detail::mysql_async::append_le24(
+        wbuf_, static_cast<std::uint32_t>(sql.size() + 1));
+    wbuf_.push_back(0);
+    wbuf_.push_back(cmd);
+    wbuf_.insert(wbuf_.end(), sql.begin(), sql.end());
+  }
+
+  // A whole command is one coroutine: the request goes out of the reused
+  // wbuf_ in a single write and every response packet is cut out of rbuf_,
+  // the socket is only awaited when the buffer runs dry. The text protocol
+  // has no prepare phase, a query counts as executed once the first response
+  // packet arrived and the rows are fetched after.
+  awaitable<detail::mysql_async::query_result> command(
+      detail::mysql_async::byte cmd, std::string_view sql) {
+    std::optional<trace_scope> trace;
+    bool pipelined_begin = false;
+    if (cmd == 0x03) {
+      pipelined_begin = std::exchange(begin_pending_, false);
+      // A failed BEGIN is only seen after the statement written with it has
+      // run in autocommit. Anything that may write waits for its own BEGIN.
+      if (pipelined_begin && !detail::mysql_async::is_plain_select(sql)) {
+        co_await command(0x03, "BEGIN");
+        pipelined_begin = false;
+      }
+      trace.emplace(db_type_v, sql);
     }
+    detail::mysql_async::deadline_scope deadline{nullptr, &timer_};
+    try {
+      ensure_socket();
+      deadline.state = arm_deadline();
+      wbuf_.clear();
+      if (pipelined_begin) {
+        append_command(0x03, "BEGIN");
+      }
+      if (sql.size() + 1 < detail::mysql_async::max_packet_chunk) {
+        append_command(cmd, sql);
+        sequence_id_ = 1;
+        co_await Io::write(*socket_, asio::buffer(wbuf_));
+      }
+      else {
+        if (pipelined_begin) {
+          co_await Io::write(*socket_, asio::buffer(wbuf_));
+        }
+        detail::mysql_async::bytes request;
+        request.reserve(sql.size() + 1);
+        request.push_back(cmd);
+        request.insert(request.end(), sql.begin(), sql.end());
+        sequence_id_ = 0;
+        co_await write_packet(std::move(request));
+      }
 
-    detail::mysql_async::query_result result;
-    if (detail::mysql_async::is_ok_packet(payload)) {
-      result.ok = detail::mysql_async::parse_ok_packet(payload);
-      apply_ok(result.ok);
-      co_return result;
-    }
+      detail::mysql_async::bytes payload;
+      // the BEGIN response comes first, a failed BEGIN is reported after the
+      // query's response has been consumed
+      std::optional<detail::mysql_async::error_packet> begin_error;
+      if (pipelined_begin) {
+        while (!rbuf_.take_packet(payload, sequence_id_)) {
+          rbuf_.commit(co_await fill_read_buffer());
+        }
+        if (detail::mysql_async::is_err_packet(payload)) {
+          begin_error = detail::mysql_async::parse_error_packet(payload);
+        }
+        else {
+          apply_ok(detail::mysql_async::parse_ok_packet(payload));
+        }
+      }
 
-    detail::mysql_async::packet_reader rd(payload);
-    auto column_count = rd.read_lenenc_int();
-    result.has_resultset = true;
-    result.columns.reserve(static_cast<std::size_t>(column_count));
+      while (!rbuf_.take_packet(payload, sequence_id_)) {
+        rbuf_.commit(co_await fill_read_buffer());
+      }
+      if (trace) {
+        trace->executed();
+      }
+      if (detail::mysql_async::is_err_packet(payload)) {
+        throw detail::mysql_async::server_error(
+            "mysql_async query failed",
+            detail::mysql_async::parse_error_packet(payload));
+      }
 
-    for (std::uint64_t i = 0; i < column_count; ++i) {
-      result.columns.push_back(parse_column_definition(co_await read_packet()));
-    }
+      detail::mysql_async::query_result result;
+      if (detail::mysql_async::is_ok_packet(payload)) {
+        result.ok = detail::mysql_async::parse_ok_packet(payload);
+        apply_ok(result.ok);
+        if (begin_error) {
+          throw detail::mysql_async::server_error("mysql_async begin failed",
+                                                  std::move(*begin_error));
+        }
+        if (trace) {
+          trace->set_rows(result.ok.affected_rows);
+        }
+        co_return result;
+      }
 
-    for (;;) {
-      auto row_payload = co_await read_packet();
-      if (detail::mysql_async::is_err_packet(row_payload)) {
-        auto err = detail::mysql_async::parse_error_packet(row_payload);
-        throw std::runtime_error("mysql_async row fetch failed [" +
-                                 std::to_string(err.code) + "] " + err.message);
+      detail::mysql_async::packet_reader rd(payload);
+      auto column_count = rd.read_lenenc_int();
+      result.has_resultset = true;
+      result.columns.reserve(static_cast<std::size_t>(column_count));
+
+      for (std::uint64_t i = 0; i < column_count; ++i) {
+        while (!rbuf_.take_packet(payload, sequence_id_)) {
+          rbuf_.commit(co_await fill_read_buffer());
+        }
+        result.columns.push_back(parse_column_definition(payload));
       }
 
-      if (detail::mysql_async::looks_like_eof_packet(row_payload)) {
-        apply_ok(detail::mysql_async::parse_ok_packet(row_payload));
-        break;
+      for (;;) {
+        while (!rbuf_.take_packet(payload, sequence_id_)) {
+          rbuf_.commit(co_await fill_read_buffer());
+        }
+        if (detail::mysql_async::is_err_packet(payload)) {
+          throw detail::mysql_async::server_error(
+              "mysql_async row fetch failed",
+              detail::mysql_async::parse_error_packet(payload));
+        }
+
+        if (detail::mysql_async::looks_like_eof_packet(payload)) {
+          apply_ok(detail::mysql_async::parse_ok_packet(payload));
+          break;
+        }
+
+        if (trace) {
+          trace->add_bytes(payload.size());
+        }
+        result.rows.push_back(parse_text_row(payload, result.columns.size()));
       }
 
-      result.rows.push_back(parse_text_row(row_payload, result.columns.size()));
+      last_affect_rows_ = static_cast<int>(result.rows.size());
+      if (begin_error) {
+        throw detail::mysql_async::server_error("mysql_async begin failed",
+                                                std::move(*begin_error));
+      }
+      if (trace) {
+        trace->set_rows(result.rows.size());
+      }
+      co_return result;
+    } catch (const std::exception& e) {
+      bool expired = deadline.state && deadline.state->expired;
+      if (trace) {
+        trace->fail(expired ? "query deadline exceeded" : e.what());
+      }
+      if (expired || detail::mysql_async::is_operation_aborted(e)) {
+        abort_command(cmd);
+      }
+      if (expired) {
+        throw std::system_error(std::make_error_code(std::errc::timed_out),
+                                "mysql_async: query deadline exceeded");
+      }
+      throw;
     }
-
-    last_affect_rows_ = static_cast<int>(result.rows.size());
-    co_return result;
   }
 
   detail::mysql_async::column_definition parse_column_definition(
@@ -1800,7 +2217,7 @@ class mysql_async {
       auto ok = co_await execute(formatted);
       co_return ok ? last_affect_rows_ : std::numeric_limits<int>::min();
     } catch (const std::exception& e) {
-      set_last_error(e.what());
+      set_last_error(e);
       co_return std::numeric_limits<int>::min();
     }
   }
@@ -1834,7 +2251,7 @@ class mysql_async {
       }
       co_return affected;
     } catch (const std::exception& e) {
-      set_last_error(e.what());
+      set_last_error(e);
       co_return std::numeric_limits<int>::min();
     }
   }
@@ -1914,18 +2331,24 @@ class mysql_async {
   std::array<detail::mysql_async::byte, 20> scramble_{};
   std::uint64_t last_insert_id_ = 0;
   int last_affect_rows_ = 0;
+  detail::mysql_async::packet_buffer rbuf_;
+  detail::mysql_async::bytes wbuf_;
 
-  std::string last_error_;
-  bool has_error_ = false;
+  db_error error_;
   bool transaction_ = true;
+  bool begin_pending_ = false;
+  std::uint32_t connection_id_ = 0;
+  std::chrono::milliseconds query_timeout_{0};
 };
 
-template <>
-struct db_execution_traits<mysql_async> {
+using mysql_async = basic_mysql_async<asio_mysql_io>;
+
+template <typename Io>
+struct db_execution_traits<basic_mysql_async<Io>> {
   static constexpr bool is_async = true;
 
   template <typename T>
-  using awaitable_type = mysql_async::awaitable<T>;
+  using awaitable_type = typename Io::template awaitable<T>;
 };
 
 }  // namespace ormpp
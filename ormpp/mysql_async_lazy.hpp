@@ -0,0 +1,67 @@
+#pragma once
+
+#ifdef ORMPP_ENABLE_MYSQL_ASYNC
+
+#include <async_simple/coro/Lazy.h>
+
+#include <asio.hpp>
+#include <cstddef>
+#include <string>
+#include <utility>
+
+#include "asio_async_simple_adapter.hpp"
+#include "mysql_async.hpp"
+
+namespace ormpp {
+
+// I/O policy running the mysql_async engine as async_simple::coro::Lazy on
+// plain asio sockets, coro_io ones included. Each read and write is awaited
+// through adapter::async_op, so a query costs no bridge: no co_spawn, no
+// strand, no shared state and no executor hop besides the socket's own
+// completion. The Lazy is resumed on the thread running the socket executor,
+// the same as with coro_io::async_read.
+struct async_simple_mysql_io {
+  using executor_type = asio::any_io_executor;
+  template <typename T>
+  using awaitable = async_simple::coro::Lazy<T>;
+
+  static async_simple::coro::Lazy<void> connect(
+      asio::ip::tcp::resolver& resolver, asio::ip::tcp::socket& socket,
+      const std::string& host, const std::string& port) {
+    auto endpoints =
+        co_await adapter::async_op<asio::ip::tcp::resolver::results_type>(
+            [&](auto handler) {
+              resolver.async_resolve(host, port, std::move(handler));
+            });
+    co_await adapter::async_op<asio::ip::tcp::endpoint>([&](auto handler) {
+      asio::async_connect(socket, endpoints, std::move(handler));
+    });
+  }
+
+  static auto read_some(asio::ip::tcp::socket& socket,
+                        asio::mutable_buffer buf) {
+    return adapter::async_op<std::size_t>([&socket, buf](auto handler) {
+      socket.async_read_some(buf, std::move(handler));
+    });
+  }
+
+  static auto write(asio::ip::tcp::socket& socket, asio::const_buffer buf) {
+    return adapter::async_op<std::size_t>([&socket, buf](auto handler) {
+      asio::async_write(socket, buf, std::move(handler));
+    });
+  }
+
+  // Runs inline up to the first suspension, the socket completions resume
+  // it from there.
+  static void spawn(const executor_type&, async_simple::coro::Lazy<void> task) {
+    std::move(task).start([](auto&&) {});
+  }
+};
+
+// Same interface as mysql_async, every call returns
+// async_simple::coro::Lazy<T>, the query builder included.
+using mysql_async_lazy = basic_mysql_async<async_simple_mysql_io>;
+
+}  // namespace ormpp
+
+#endif
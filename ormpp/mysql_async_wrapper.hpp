@@ -7,7 +7,7 @@
 #include <cstdint>
 #include <optional>
 #include <ormpp/dbng.hpp>
-#include <ormpp/mysql_async.hpp>
+#include <ormpp/mysql_async_lazy.hpp>
 #include <string>
 #include <utility>
 
@@ -15,9 +15,13 @@
 
 namespace db_wrapper {
 
+// The session runs the mysql_async engine natively as Lazy
+// (ormpp::mysql_async_lazy), raw() and the query builder return
+// async_simple::coro::Lazy too. await() and await_safe() remain to bridge
+// other asio awaitables.
 class mysql_async_session {
  public:
-  using db_type = ormpp::dbng<ormpp::mysql_async>;
+  using db_type = ormpp::dbng<ormpp::mysql_async_lazy>;
 
   mysql_async_session()
       : executor_(coro_io::get_global_executor()->get_asio_executor()),
@@ -41,35 +45,46 @@ class mysql_async_session {
     return adapter::from_asio_safe(std::move(awaitable), executor_);
   }
 
+  // raw() already returns Lazy, kept so await(db.raw()...) keeps compiling.
+  template <typename T>
+  async_simple::coro::Lazy<T> await(async_simple::coro::Lazy<T> lazy) {
+    return lazy;
+  }
+
+  template <typename T>
+  async_simple::coro::Lazy<T> await_safe(async_simple::coro::Lazy<T> lazy) {
+    return lazy;
+  }
+
   async_simple::coro::Lazy<bool> connect(const std::string &host,
                                          const std::string &user,
                                          const std::string &passwd,
                                          const std::string &database,
                                          const std::optional<int> &timeout = {},
                                          const std::optional<int> &port = {}) {
-    co_return co_await await(
-        db_.connect(host, user, passwd, database, timeout, port));
+    co_return co_await db_.connect(host, user, passwd, database, timeout, port);
   }
 
   async_simple::coro::Lazy<bool> execute(std::string sql) {
-    co_return co_await await(db_.execute(sql));
+    co_return co_await db_.execute(sql);
   }
 
   template <typename T, typename... Args>
   async_simple::coro::Lazy<int> insert(const T &value, Args &&...args) {
-    co_return co_await await(db_.insert(value, std::forward<Args>(args)...));
+    co_return co_await db_.insert(value, std::forward<Args>(args)...);
   }
 
   template <typename T, typename... Args>
   async_simple::coro::Lazy<std::uint64_t> get_insert_id_after_insert(
       const T &value, Args &&...args) {
-    co_return co_await await(
-        db_.get_insert_id_after_insert(value, std::forward<Args>(args)...));
+    co_return co_await db_.get_insert_id_after_insert(
+        value, std::forward<Args>(args)...);
   }
 
   int get_last_affect_rows() { return db_.get_last_affect_rows(); }
   bool has_error() { return db_.has_error(); }
   std::string get_last_error() const { return db_.get_last_error(); }
+  const db_error &get_error() const { return db_.get_error(); }
 
  private:
   asio::any_io_executor executor_;
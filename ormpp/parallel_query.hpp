@@ -0,0 +1,276 @@
+#ifndef ORMPP_PARALLEL_QUERY_HPP
+#define ORMPP_PARALLEL_QUERY_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "connection_pool.hpp"
+#include "db_error.hpp"
+
+#if defined(ORMPP_ENABLE_MYSQL_ASYNC) || defined(ORMPP_ENABLE_SQLITE_ASYNC)
+#include <asio.hpp>
+
+#include "async_connection_pool.hpp"
+#endif
+
+// Fan-out of independent queries, typically the slices of a partitioned scan,
+// over pooled connections:
+//
+//   std::vector<std::pair<int, int>> ranges{{0, 1000}, {1000, 2000}, ...};
+//   auto rows = parallel_query(pool, ranges, [](auto &db, auto &r) {
+//     return db.template query_s<person>("id >= ? and id < ?", r.first,
+//                                        r.second);
+//   });
+//
+// fn(db, task) runs one task on one connection and returns a vector of rows
+// (an awaitable of one with an async pool, make fn a coroutine then so the
+// sql string outlives the query). At most `concurrency` tasks run at the same
+// time, each worker keeps its connection for all the tasks it takes.
+// parallel_query concatenates the results in task order, parallel_query_each
+// hands every task's rows to sink(index, rows) as soon as they are there
+// instead of keeping them. The first exception stops the
+// workers from taking new tasks and is rethrown once all have finished. A
+// task after which the connection has an error (a failed query_s returns no
+// rows rather than throwing) fails with parallel_query_error, so it is not
+// taken for an empty slice.
+namespace ormpp {
+
+struct parallel_query_error : std::runtime_error {
+  parallel_query_error(size_t index, db_error err)
+      : std::runtime_error("parallel_query: task " + std::to_string(index) +
+                           " failed: " + err.message),
+        task(index),
+        error(std::move(err)) {}
+
+  size_t task;
+  db_error error;
+};
+
+namespace detail::parallel {
+
+inline size_t worker_count(size_t tasks, size_t concurrency) {
+  return (std::min)(tasks, (std::max)(concurrency, size_t(1)));
+}
+
+template <typename T>
+std::vector<T> concat(std::vector<std::vector<T>> &parts) {
+  size_t total = 0;
+  for (auto &part : parts) {
+    total += part.size();
+  }
+  std::vector<T> rows;
+  rows.reserve(total);
+  for (auto &part : parts) {
+    rows.insert(rows.end(), std::make_move_iterator(part.begin()),
+                std::make_move_iterator(part.end()));
+  }
+  return rows;
+}
+
+template <typename Conn>
+void check_task(Conn &conn, size_t index) {
+  if (conn.has_error()) {
+    throw parallel_query_error(index, conn.get_error());
+  }
+}
+
+}  // namespace detail::parallel
+
+// Threads over connection_pool<DB>, one thread per worker.
+template <typename DB, typename Task, typename F, typename Sink>
+void parallel_query_each(connection_pool<DB> &pool,
+                         const std::vector<Task> &tasks, F fn, Sink sink,
+                         size_t concurrency = 4) {
+  std::atomic<size_t> next = 0;
+  std::atomic<bool> failed = false;
+  std::exception_ptr error;
+  std::mutex mtx;
+
+  auto worker = [&] {
+    auto conn = pool.get();
+    if (conn == nullptr) {
+      return;
+    }
+    while (!failed) {
+      size_t i = next++;
+      if (i >= tasks.size()) {
+        break;
+      }
+      try {
+        auto rows = fn(*conn, tasks[i]);
+        detail::parallel::check_task(*conn, i);
+        std::scoped_lock lock(mtx);
+        sink(i, std::move(rows));
+      } catch (...) {
+        std::scoped_lock lock(mtx);
+        if (!error) {
+          error = std::current_exception();
+        }
+        failed = true;
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  size_t workers = detail::parallel::worker_count(tasks.size(), concurrency);
+  threads.reserve(workers);
+  for (size_t i = 0; i < workers; ++i) {
+    threads.emplace_back(worker);
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  if (next < tasks.size()) {
+    throw std::runtime_error("parallel_query: no connection available");
+  }
+}
+
+template <typename DB, typename Task, typename F>
+auto parallel_query(connection_pool<DB> &pool, const std::vector<Task> &tasks,
+                    F fn, size_t concurrency = 4) {
+  using rows_t = std::invoke_result_t<F &, DB &, const Task &>;
+  using T = typename rows_t::value_type;
+  std::vector<rows_t> parts(tasks.size());
+  parallel_query_each(
+      pool, tasks, std::move(fn),
+      [&parts](size_t i, rows_t &&rows) {
+        parts[i] = std::move(rows);
+      },
+      concurrency);
+  return detail::parallel::concat<T>(parts);
+}
+
+#if defined(ORMPP_ENABLE_MYSQL_ASYNC) || defined(ORMPP_ENABLE_SQLITE_ASYNC)
+
+namespace detail::parallel {
+
+// async_connection_pool and sharded_async_connection_pool
+template <typename Pool>
+concept async_pool = requires(Pool &p) {
+  typename decltype(p.get())::value_type::element_type;
+};
+
+template <typename Pool>
+using async_conn_t =
+    typename decltype(std::declval<Pool &>().get())::value_type::element_type;
+
+template <typename Pool, typename Task, typename F>
+using async_rows_t = typename std::invoke_result_t<F &, async_conn_t<Pool> &,
+                                                   const Task &>::value_type;
+
+// Shared by the workers, which all run on one strand.
+template <typename Pool, typename Task, typename F, typename Sink>
+struct async_state {
+  Pool &pool;
+  const std::vector<Task> &tasks;
+  F fn;
+  Sink sink;
+  asio::steady_timer done;
+  size_t next = 0;
+  size_t running = 0;
+  std::exception_ptr error;
+};
+
+template <typename State>
+asio::awaitable<void> async_worker(std::shared_ptr<State> st) {
+  // Getting the connection may throw as well, the worker has to be counted
+  // out whatever happens or parallel_query_each waits forever.
+  try {
+    auto conn = co_await st->pool.get();
+    while (conn && !st->error && st->next < st->tasks.size()) {
+      size_t i = st->next++;
+      auto rows = co_await st->fn(*conn, st->tasks[i]);
+      check_task(*conn, i);
+      st->sink(i, std::move(rows));
+    }
+  } catch (...) {
+    if (!st->error) {
+      st->error = std::current_exception();
+    }
+  }
+  if (--st->running == 0) {
+    st->done.cancel();
+  }
+}
+
+// Runs on the strand, so no worker can finish before the wait is armed.
+template <typename State>
+asio::awaitable<void> async_run(std::shared_ptr<State> st, size_t workers) {
+  auto strand = co_await asio::this_coro::executor;
+  st->running = workers;
+  for (size_t i = 0; i < workers; ++i) {
+    asio::co_spawn(strand, async_worker(st), asio::detached);
+  }
+  asio::error_code ec;
+  co_await st->done.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+}
+
+}  // namespace detail::parallel
+
+// Coroutines over async_connection_pool<DB> or
+// sharded_async_connection_pool<DB>, the pool has to outlive the call.
+template <typename Pool, typename Task, typename F, typename Sink>
+  requires detail::parallel::async_pool<Pool>
+asio::awaitable<void> parallel_query_each(Pool &pool,
+                                          const std::vector<Task> &tasks, F fn,
+                                          Sink sink, size_t concurrency = 4) {
+  size_t workers = detail::parallel::worker_count(tasks.size(), concurrency);
+  if (workers == 0) {
+    co_return;
+  }
+  auto executor = co_await asio::this_coro::executor;
+  auto strand = asio::make_strand(executor);
+  using state_t = detail::parallel::async_state<Pool, Task, F, Sink>;
+  auto st = std::make_shared<state_t>(state_t{pool, tasks, std::move(fn),
+                                              std::move(sink),
+                                              asio::steady_timer(strand)});
+  st->done.expires_at(asio::steady_timer::time_point::max());
+
+  auto op = asio::co_spawn(strand, detail::parallel::async_run(st, workers),
+                           asio::use_awaitable);
+  co_await std::move(op);
+
+  if (st->error) {
+    std::rethrow_exception(st->error);
+  }
+  if (st->next < tasks.size()) {
+    throw std::runtime_error("parallel_query: no connection available");
+  }
+}
+
+template <typename Pool, typename Task, typename F>
+  requires detail::parallel::async_pool<Pool>
+asio::awaitable<detail::parallel::async_rows_t<Pool, Task, F>> parallel_query(
+    Pool &pool, const std::vector<Task> &tasks, F fn, size_t concurrency = 4) {
+  using rows_t = detail::parallel::async_rows_t<Pool, Task, F>;
+  using T = typename rows_t::value_type;
+  std::vector<rows_t> parts(tasks.size());
+  auto sink = [&parts](size_t i, rows_t &&rows) {
+    parts[i] = std::move(rows);
+  };
+  auto op =
+      parallel_query_each(pool, tasks, std::move(fn), sink, concurrency);
+  co_await std::move(op);
+  co_return detail::parallel::concat<T>(parts);
+}
+
+#endif
+
+}  // namespace ormpp
+
+#endif  // ORMPP_PARALLEL_QUERY_HPP
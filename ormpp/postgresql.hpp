@@ -7,12 +7,21 @@
 
 #include <libpq-fe.h>
 
+#include <bit>
 #include <climits>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <map>
 #include <string>
 #include <type_traits>
 
 #include "iguana/detail/charconv.h"
+#include "column_set.hpp"
+#include "db_error.hpp"
 #include "query.hpp"
+#include "query_trace.hpp"
+#include "result_set.hpp"
 
 using namespace std::string_literals;
 
@@ -23,20 +32,23 @@ class postgresql {
 
   ~postgresql() { disconnect(); }
 
-  bool has_error() const { return has_error_; }
+  bool has_error() const { return static_cast<bool>(error_); }
 
-  static void reset_error() {
-    has_error_ = false;
-    last_error_ = {};
-  }
+  void reset_error() { error_.clear(); }
+
+  // string_view and blob_view fields of the following results are stored
+  // here, see dbng::query_view
+  void set_result_arena(string_arena *arena) { arena_ = arena; }
 
-  static void set_last_error(std::string last_error) {
-    has_error_ = true;
-    last_error_ = std::move(last_error);
-    std::cout << last_error_ << std::endl;
+  void set_last_error(std::string last_error,
+                      db_errc code = db_errc::unknown) {
+    error_.assign(code, std::move(last_error));
+    std::cout << error_.message << std::endl;
   }
 
-  std::string get_last_error() const { return last_error_; }
+  std::string get_last_error() const { return error_.message; }
+
+  const db_error &get_error() const { return error_; }
 
   // ip, user, pwd, db, timeout  the sequence must be fixed like this
   bool connect(
@@ -49,7 +61,7 @@ class postgresql {
 #endif
     con_ = PQconnectdb(sql.data());
     if (PQstatus(con_) != CONNECTION_OK) {
-      set_last_error(PQerrorMessage(con_));
+      set_last_error(PQerrorMessage(con_), db_errc::connection);
       return false;
     }
     return true;
@@ -65,6 +77,9 @@ class postgresql {
   template <typename... Args>
   bool disconnect(Args &&...args) {
     if (con_ != nullptr) {
+      // the server drops the prepared statements with the connection
+      update_stmts_.clear();
+      stale_update_stmts_.clear();
       PQfinish(con_);
       con_ = nullptr;
     }
@@ -79,8 +94,13 @@ class postgresql {
 #ifdef ORMPP_ENABLE_LOG
     std::cout << sql << std::endl;
 #endif
+    if (cursor_busy()) {
+      return false;
+    }
+    trace_scope trace(db_type_v, sql, error_);
     res_ = PQexec(con_, sql.data());
-    auto guard = guard_statment(res_);
+    trace.executed();
+    auto guard = guard_statment(res_, *this);
     return PQresultStatus(res_) == PGRES_COMMAND_OK;
   }
 
@@ -114,6 +134,20 @@ class postgresql {
     return update_impl<members...>(v, std::forward<Args>(args)...);
   }
 
+  // update t set <columns> where <conflict keys>, bit i of columns is
+  // member i. The statement of each struct and column mask is prepared once
+  // per connection under its own name and kept. No transaction is opened,
+  // the caller groups the statements.
+  template <typename T>
+  int update_columns(const T &t, uint64_t columns) {
+    return update_columns_impl(&t, 1, columns);
+  }
+
+  template <typename T>
+  int update_columns(const std::vector<T> &v, uint64_t columns) {
+    return update_columns_impl(v.data(), v.size(), columns);
+  }
+
   template <typename T, typename... Args>
   uint64_t get_insert_id_after_insert(const T &t, Args &&...args) {
     auto res = insert_or_update_impl(t, generate_insert_sql<T>(db_type_v, true),
@@ -141,11 +175,15 @@ class postgresql {
 #ifdef ORMPP_ENABLE_LOG
     std::cout << sql << std::endl;
 #endif
+    if (cursor_busy()) {
+      return 0;
+    }
+    trace_scope trace(db_type_v, sql, error_);
     if constexpr (sizeof...(Args) > 0) {
       if (!prepare<T>(sql))
         return 0;
+      trace.prepared();
 
-      size_t index = 0;
       std::vector<const char *> param_values_buf;
       std::vector<std::vector<char>> param_values;
       (set_param_values(param_values, args), ...);
@@ -158,12 +196,15 @@ class postgresql {
     else {
       res_ = PQexec(con_, sql.data());
     }
+    trace.executed();
 
-    auto guard = guard_statment(res_);
+    auto guard = guard_statment(res_, *this);
     if (PQresultStatus(res_) != PGRES_COMMAND_OK) {
       return 0;
     }
-    return std::strtoull(PQcmdTuples(res_), nullptr, 10);
+    uint64_t affected = std::strtoull(PQcmdTuples(res_), nullptr, 10);
+    trace.set_rows(affected);
+    return affected;
   }
 
   template <typename T, typename... Args>
@@ -174,11 +215,15 @@ class postgresql {
 #ifdef ORMPP_ENABLE_LOG
     std::cout << sql << std::endl;
 #endif
+    if (cursor_busy()) {
+      return {};
+    }
+    trace_scope trace(db_type_v, sql, error_);
     if constexpr (sizeof...(Args) > 0) {
       if (!prepare<T>(sql))
         return {};
+      trace.prepared();
 
-      size_t index = 0;
       std::vector<const char *> param_values_buf;
       std::vector<std::vector<char>> param_values;
       (set_param_values(param_values, args), ...);
@@ -191,8 +236,9 @@ class postgresql {
     else {
       res_ = PQexec(con_, sql.data());
     }
+    trace.executed();
 
-    auto guard = guard_statment(res_);
+    auto guard = guard_statment(res_, *this);
     if (PQresultStatus(res_) != PGRES_TUPLES_OK) {
       return {};
     }
@@ -206,12 +252,137 @@ class postgresql {
           t, [this, i](auto &field, auto /*name*/, auto index) {
             assign(field, i, index);
           });
+      trace.add_row(t);
       v.push_back(std::move(t));
     }
 
     return v;
   }
 
+  // Calls f(row) for every row instead of collecting them. The query runs
+  // in single-row mode, so libpq holds one row at a time rather than the
+  // whole result as with query_s.
+  template <typename T, typename F, typename... Args>
+  bool query_each(const std::string &str, F &&f, Args &&...args) {
+    std::string sql =
+        contains_select(str) ? str : generate_query_sql<T>(db_type_v, str);
+#ifdef ORMPP_ENABLE_LOG
+    std::cout << sql << std::endl;
+#endif
+    if (cursor_busy()) {
+      return false;
+    }
+    trace_scope trace(db_type_v, sql, error_);
+    int sent = 0;
+    if constexpr (sizeof...(Args) > 0) {
+      if (!prepare<T>(sql))
+        return false;
+      trace.prepared();
+
+      std::vector<const char *> param_values_buf;
+      std::vector<std::vector<char>> param_values;
+      (set_param_values(param_values, args), ...);
+      for (auto &item : param_values) {
+        param_values_buf.push_back(item.data());
+      }
+      sent = PQsendQueryPrepared(con_, "", (int)param_values.size(),
+                                 param_values_buf.data(), NULL, NULL, 0);
+    }
+    else {
+      sent = PQsendQuery(con_, sql.data());
+    }
+    reset_error();
+    if (!sent) {
+      set_last_error(PQerrorMessage(con_), db_errc::connection);
+      return false;
+    }
+    PQsetSingleRowMode(con_);
+
+    // every result has to be read before the connection takes a new query,
+    // also when f throws
+    cursor_scope cursor(in_cursor_);
+    bool ok = true;
+    try {
+      while ((res_ = PQgetResult(con_)) != nullptr) {
+        auto status = PQresultStatus(res_);
+        if (status == PGRES_SINGLE_TUPLE) {
+          trace.executed();
+          T t = {};
+          ylt::reflection::for_each(
+              t, [this](auto &field, auto /*name*/, auto index) {
+                assign(field, 0, index);
+              });
+          trace.add_row(t);
+          f(t);
+        }
+        else if (status != PGRES_TUPLES_OK) {
+          set_result_error(res_);
+          ok = false;
+        }
+        PQclear(res_);
+      }
+    } catch (...) {
+      PQclear(res_);
+      while ((res_ = PQgetResult(con_)) != nullptr) {
+        PQclear(res_);
+      }
+      throw;
+    }
+    trace.executed();
+    return ok;
+  }
+
+  template <typename T, typename... Args>
+  column_set<T> query_columns(const std::string &str, Args &&...args) {
+    std::string sql =
+        contains_select(str) ? str : generate_query_sql<T>(db_type_v, str);
+#ifdef ORMPP_ENABLE_LOG
+    std::cout << sql << std::endl;
+#endif
+    if (cursor_busy()) {
+      return {};
+    }
+    trace_scope trace(db_type_v, sql, error_);
+    if constexpr (sizeof...(Args) > 0) {
+      if (!prepare<T>(sql))
+        return {};
+      trace.prepared();
+
+      std::vector<const char *> param_values_buf;
+      std::vector<std::vector<char>> param_values;
+      (set_param_values(param_values, args), ...);
+      for (auto &item : param_values) {
+        param_values_buf.push_back(item.data());
+      }
+      res_ = PQexecPrepared(con_, "", (int)param_values.size(),
+                            param_values_buf.data(), NULL, NULL, 0);
+    }
+    else {
+      res_ = PQexec(con_, sql.data());
+    }
+    trace.executed();
+
+    auto guard = guard_statment(res_, *this);
+    if (PQresultStatus(res_) != PGRES_TUPLES_OK) {
+      return {};
+    }
+
+    column_set<T> cols;
+    auto ntuples = PQntuples(res_);
+    cols.reserve(ntuples);
+    for (auto row = 0; row < ntuples; row++) {
+      cols.append_row([this, row](auto &value, size_t i) {
+        if (PQgetisnull(res_, row, (int)i) == 1) {
+          return true;
+        }
+        assign(value, row, (int)i);
+        return false;
+      });
+    }
+    trace.set_rows(cols.size());
+    return cols;
+  }
+
   template <typename T, typename... Args>
   std::enable_if_t<iguana::non_ylt_refletable_v<T>, std::vector<T>> query_s(
       const std::string &sql, Args &&...args) {
@@ -219,11 +390,15 @@ class postgresql {
 #ifdef ORMPP_ENABLE_LOG
     std::cout << sql << std::endl;
 #endif
+    if (cursor_busy()) {
+      return {};
+    }
+    trace_scope trace(db_type_v, sql, error_);
     if constexpr (sizeof...(Args) > 0) {
       if (!prepare<T>(sql))
         return {};
+      trace.prepared();
 
-      size_t index = 0;
       std::vector<const char *> param_values_buf;
       std::vector<std::vector<char>> param_values;
       (set_param_values(param_values, args), ...);
@@ -236,8 +411,9 @@ class postgresql {
     else {
       res_ = PQexec(con_, sql.data());
     }
+    trace.executed();
 
-    auto guard = guard_statment(res_);
+    auto guard = guard_statment(res_, *this);
     if (PQresultStatus(res_) != PGRES_TUPLES_OK) {
       return {};
     }
@@ -267,8 +443,10 @@ class postgresql {
           },
           std::make_index_sequence<std::tuple_size_v<T>>{});
 
-      if (index > 0)
+      if (index > 0) {
+        trace.add_row(tp);
         v.push_back(std::move(tp));
+      }
     }
 
     return v;
@@ -301,6 +479,108 @@ class postgresql {
     return ormpp::make_alter_table_builder<T>(this);
   }
 
+  template <typename T>
+  auto make_upsert() {
+    return ormpp::make_upsert_builder<T>(this);
+  }
+
+  // Every column travels as one array parameter, so a batch of any size is
+  // one execution of a statement prepared once:
+  //   insert into t(a,b) select * from unnest($1::integer[],$2::text[])
+  //   on conflict(a) do update set b=excluded.b
+  // A batch must not hold a key twice, postgresql updates a row only once
+  // per statement.
+  template <typename T>
+  int bulk_upsert(const std::vector<T> &v, const bulk_upsert_sql &stmt,
+                  size_t batch_size) {
+    const auto type_names = get_type_names<T>(db_type_v);
+    std::string sql = stmt.head;
+    sql.append(" select * from unnest(");
+    int count = 0;
+    for (size_t i = 0; i < stmt.columns.size(); ++i) {
+      if (stmt.columns[i]) {
+        sql.append("$")
+            .append(std::to_string(++count))
+            .append("::")
+            .append(type_names[i])
+            .append("[],");
+      }
+    }
+    sql.back() = ')';
+    sql.append(stmt.conflict);
+#ifdef ORMPP_ENABLE_LOG
+    std::cout << sql << std::endl;
+#endif
+
+    if (cursor_busy()) {
+      return INT_MIN;
+    }
+    trace_scope trace(db_type_v, sql, error_);
+    {
+      res_ = PQprepare(con_, "", sql.data(), count, nullptr);
+      auto guard = guard_statment(res_, *this);
+      if (PQresultStatus(res_) != PGRES_COMMAND_OK) {
+        return INT_MIN;
+      }
+    }
+    trace.prepared();
+
+    if (transaction_ && !begin()) {
+      return INT_MIN;
+    }
+
+    std::vector<std::string> arrays(count);
+    std::vector<const char *> params(count);
+    int rows = 0;
+    for (size_t first = 0; first < v.size(); first += batch_size) {
+      size_t last = (std::min)(v.size(), first + batch_size);
+      for (auto &array : arrays) {
+        array.assign("{");
+      }
+      for (size_t r = first; r < last; ++r) {
+        int pos = 0;
+        ylt::reflection::for_each(v[r], [&](auto &field, auto /*name*/,
+                                            size_t index) {
+          if (stmt.columns[index]) {
+            append_array_element(arrays[pos++], field);
+          }
+        });
+      }
+      for (int i = 0; i < count; ++i) {
+        arrays[i].back() = '}';
+        params[i] = arrays[i].data();
+      }
+
+      res_ = PQexecPrepared(con_, "", count, params.data(), nullptr, nullptr,
+                            0);
+      bool ok = false;
+      {
+        auto guard = guard_statment(res_, *this);
+        ok = PQresultStatus(res_) == PGRES_COMMAND_OK;
+        if (ok) {
+          rows += (int)std::strtoull(PQcmdTuples(res_), nullptr, 10);
+        }
+      }
+      if (!ok) {
+        if (transaction_) {
+          // keep the error of the failed batch
+          auto error = error_;
+          rollback();
+          error_ = std::move(error);
+        }
+        return INT_MIN;
+      }
+    }
+    trace.executed();
+    trace.set_rows(rows);
+
+    if (transaction_ && !commit()) {
+      return INT_MIN;
+    }
+    last_affect_rows_ = rows;
+    return rows;
+  }
+
   template <typename T, typename... Args>
   std::enable_if_t<iguana::ylt_refletable_v<T>, std::vector<T>> query(
       Args &&...args) {
@@ -308,8 +588,13 @@ class postgresql {
 #ifdef ORMPP_ENABLE_LOG
     std::cout << sql << std::endl;
 #endif
+    if (cursor_busy()) {
+      return {};
+    }
+    trace_scope trace(db_type_v, sql, error_);
     res_ = PQexec(con_, sql.data());
-    auto guard = guard_statment(res_);
+    trace.executed();
+    auto guard = guard_statment(res_, *this);
     if (PQresultStatus(res_) != PGRES_TUPLES_OK) {
       return {};
     }
@@ -323,6 +608,7 @@ class postgresql {
           t, [this, i](auto &field, auto /*name*/, auto index) {
             assign(field, i, index);
           });
+      trace.add_row(t);
       v.push_back(std::move(t));
     }
 
@@ -343,8 +629,13 @@ class postgresql {
       sql = get_sql(sql, std::forward<Args>(args)...);
     }
 
+    if (cursor_busy()) {
+      return {};
+    }
+    trace_scope trace(db_type_v, sql, error_);
     res_ = PQexec(con_, sql.data());
-    auto guard = guard_statment(res_);
+    trace.executed();
+    auto guard = guard_statment(res_, *this);
     if (PQresultStatus(res_) != PGRES_TUPLES_OK) {
       return {};
     }
@@ -374,8 +665,10 @@ class postgresql {
           },
           std::make_index_sequence<SIZE>{});
 
-      if (index > 0)
+      if (index > 0) {
+        trace.add_row(tp);
         v.push_back(std::move(tp));
+      }
     }
 
     return v;
@@ -386,10 +679,16 @@ class postgresql {
 #ifdef ORMPP_ENABLE_LOG
     std::cout << sql << std::endl;
 #endif
+    if (cursor_busy()) {
+      return false;
+    }
+    trace_scope trace(db_type_v, sql, error_);
     res_ = PQexec(con_, sql.data());
-    auto guard = guard_statment(res_);
+    trace.executed();
+    auto guard = guard_statment(res_, *this);
     if (PQresultStatus(res_) == PGRES_COMMAND_OK) {
       last_affect_rows_ = (int)std::strtoull(PQcmdTuples(res_), nullptr, 10);
+      trace.set_rows(last_affect_rows_);
       return true;
     }
     last_affect_rows_ = 0;
@@ -402,20 +701,35 @@ class postgresql {
   void set_enable_transaction(bool enable) { transaction_ = enable; }
 
   bool begin() {
+    if (cursor_busy()) {
+      return false;
+    }
+    trace_scope trace(db_type_v, "begin;", error_);
     res_ = PQexec(con_, "begin;");
-    auto guard = guard_statment(res_);
+    trace.executed();
+    auto guard = guard_statment(res_, *this);
     return PQresultStatus(res_) == PGRES_COMMAND_OK;
   }
 
   bool commit() {
+    if (cursor_busy()) {
+      return false;
+    }
+    trace_scope trace(db_type_v, "commit;", error_);
     res_ = PQexec(con_, "commit;");
-    auto guard = guard_statment(res_);
+    trace.executed();
+    auto guard = guard_statment(res_, *this);
     return PQresultStatus(res_) == PGRES_COMMAND_OK;
   }
 
   bool rollback() {
+    if (cursor_busy()) {
+      return false;
+    }
+    trace_scope trace(db_type_v, "rollback;", error_);
     res_ = PQexec(con_, "rollback;");
-    auto guard = guard_statment(res_);
+    trace.executed();
+    auto guard = guard_statment(res_, *this);
     return PQresultStatus(res_) == PGRES_COMMAND_OK;
   }
 
@@ -499,8 +813,8 @@ class postgresql {
     std::string sql;
     sql.append("CREATE TABLE IF NOT EXISTS ").append(table_name).append("(");
     T t;
-    ylt::reflection::for_each(t, [&](auto &field, auto name, size_t index) {
-      using item_type = std::decay_t<decltype(field)>;
+    ylt::reflection::for_each(t, [&](auto & /*field*/, auto name,
+                                     size_t index) {
       std::string type_str = type_name_arr[index];
       sql.append(name).append(" ").append(type_str);
 
@@ -509,7 +823,7 @@ class postgresql {
       if (!auto_primary_key.empty() &&
           auto_primary_key.find(str_name) != auto_primary_key.end()) {
         // remove additional type str for auto key
-        for (int i = 0; i < type_str.size(); i++) {
+        for (size_t i = 0; i < type_str.size(); i++) {
           sql.pop_back();
         }
         if (type_str == "bigint") {
@@ -557,7 +871,7 @@ class postgresql {
 #endif
     res_ = PQprepare(con_, "", sql.data(), ylt::reflection::members_count_v<T>,
                      nullptr);
-    auto guard = guard_statment(res_);
+    auto guard = guard_statment(res_, *this);
     return PQresultStatus(res_) == PGRES_COMMAND_OK;
   }
 
@@ -614,7 +928,7 @@ class postgresql {
     res_ = PQexecPrepared(con_, "", (int)param_values.size(),
                           param_values_buf.data(), NULL, NULL, 0);
 
-    auto guard = guard_statment(res_);
+    auto guard = guard_statment(res_, *this);
     auto status = PQresultStatus(res_);
 
     if (status == PGRES_TUPLES_OK) {
@@ -652,7 +966,8 @@ class postgresql {
     auto sql = generate_update_sql<T, members...>(db_type_v,
                                                   std::forward<Args>(args)...);
     if (sql.empty()) {
-      set_last_error("update requires a conflict key or where condition");
+      set_last_error("update requires a conflict key or where condition",
+                     db_errc::invalid_argument);
       return INT_MIN;
     }
     auto res = insert_or_update_impl<members...>(t, sql, OptType::update, false,
@@ -665,7 +980,8 @@ class postgresql {
     auto sql = generate_update_sql<T, members...>(db_type_v,
                                                   std::forward<Args>(args)...);
     if (sql.empty()) {
-      set_last_error("update requires a conflict key or where condition");
+      set_last_error("update requires a conflict key or where condition",
+                     db_errc::invalid_argument);
       return INT_MIN;
     }
     auto res = insert_or_update_impl<members...>(v, sql, OptType::update, false,
@@ -679,13 +995,21 @@ class postgresql {
                                                 OptType type,
                                                 bool get_insert_id = false,
                                                 Args &&...args) {
+    if (cursor_busy()) {
+      return std::nullopt;
+    }
+    trace_scope trace(db_type_v, sql, error_);
     if (!prepare<T>(get_insert_id
                         ? sql + "returning " + get_auto_key<T>().data()
                         : sql)) {
       return std::nullopt;
     }
+    trace.prepared();
 
-    return stmt_execute<members...>(t, type, std::forward<Args>(args)...);
+    auto res = stmt_execute<members...>(t, type, std::forward<Args>(args)...);
+    trace.executed();
+    trace.set_rows(res.has_value() ? 1 : 0);
+    return res;
   }
 
   template <auto... members, typename T, typename... Args>
@@ -698,11 +1022,16 @@ class postgresql {
       return std::nullopt;
     }
 
+    if (cursor_busy()) {
+      return std::nullopt;
+    }
+    trace_scope trace(db_type_v, sql, error_);
     if (!prepare<T>(get_insert_id
                         ? sql + "returning " + get_auto_key<T>().data()
                         : sql)) {
       return std::nullopt;
     }
+    trace.prepared();
 
     std::optional<uint64_t> res = {0};
     for (auto &item : v) {
@@ -715,6 +1044,9 @@ class postgresql {
       }
     }
 
+    trace.executed();
+    trace.set_rows(v.size());
+
     if (transaction_ && !commit()) {
       return std::nullopt;
     }
@@ -774,6 +1106,16 @@ class postgresql {
       std::copy(value, value + sizeof(U), std::back_inserter(temp));
       param_values.push_back(std::move(temp));
     }
+    else if constexpr (is_sql_value_type_v<U>) {
+      std::string text;
+      append_sql_text(text, value);
+      param_values.emplace_back(text.c_str(), text.c_str() + text.size() + 1);
+    }
+    else if constexpr (is_json_column_v<U>) {
+      std::string text;
+      append_column_text(text, value, column_text::pg_array);
+      param_values.emplace_back(text.c_str(), text.c_str() + text.size() + 1);
+    }
     else if constexpr (std::is_same_v<blob, U>) {
       std::vector<char> temp = {};
       std::copy(value.data(), value.data() + value.size(),
@@ -793,6 +1135,89 @@ class postgresql {
     }
   }
 
+  // One element of an array literal in text format, followed by a comma
+  template <typename T>
+  static void append_array_element(std::string &array, const T &value) {
+    using U = ylt::reflection::remove_cvref_t<T>;
+    if constexpr (is_optional_v<U>::value) {
+      if (value.has_value()) {
+        return append_array_element(array, *value);
+      }
+      array.append("NULL");
+    }
+    else if constexpr (std::is_enum_v<U>) {
+      array.append(std::to_string(static_cast<int64_t>(value)));
+    }
+    else if constexpr (std::is_same_v<char, U>) {
+      append_array_text(array, std::string_view(&value, 1));
+    }
+    else if constexpr (std::is_integral_v<U>) {
+      array.append(std::to_string(value));
+    }
+    else if constexpr (std::is_floating_point_v<U>) {
+      char buf[32];
+      snprintf(buf, sizeof(buf), "%.*g", std::numeric_limits<U>::max_digits10,
+               static_cast<double>(value));
+      array.append(buf);
+    }
+    else if constexpr (std::is_same_v<std::string, U> ||
+                       std::is_same_v<std::string_view, U>) {
+      append_array_text(array, value);
+    }
+    else if constexpr (iguana::array_v<U>) {
+      append_array_text(
+          array, std::string_view(value.data(), strnlen(value.data(),
+                                                        value.size())));
+    }
+    else if constexpr (iguana::c_array_v<U>) {
+      append_array_text(array, std::string_view(value, strnlen(value,
+                                                               sizeof(U))));
+    }
+    else if constexpr (is_sql_value_type_v<U>) {
+      // quoted for the space in a timestamp
+      array.push_back('"');
+      append_sql_text(array, value);
+      array.push_back('"');
+    }
+    else if constexpr (is_json_document_v<decoded_column_t<U>>) {
+      // unnest flattens nested arrays, so only documents work here
+      std::string text;
+      append_column_text(text, value, column_text::json);
+      append_array_text(array, text);
+    }
+    else if constexpr (std::is_same_v<blob, U>) {
+      // bytea hex format, the backslash escaped for the array literal
+      static constexpr char hex[] = "0123456789abcdef";
+      array.append("\"\\\\x");
+      for (unsigned char c : value) {
+        array.push_back(hex[c >> 4]);
+        array.push_back(hex[c & 0x0f]);
+      }
+      array.push_back('"');
+    }
+#ifdef ORMPP_WITH_CSTRING
+    else if constexpr (std::is_same_v<CString, U>) {
+      append_array_text(
+          array, std::string_view(value.GetString(), value.GetLength()));
+    }
+#endif
+    else {
+      static_assert(!sizeof(U), "this type has not supported yet");
+    }
+    array.push_back(',');
+  }
+
+  static void append_array_text(std::string &array, std::string_view text) {
+    array.push_back('"');
+    for (char c : text) {
+      if (c == '"' || c == '\\') {
+        array.push_back('\\');
+      }
+      array.push_back(c);
+    }
+    array.push_back('"');
+  }
+
   template <typename T>
   constexpr void assign(T &&value, int row, int i) {
     if (PQgetisnull(res_, row, i) == 1) {
@@ -822,8 +1247,8 @@ class postgresql {
       value = PQgetvalue(res_, row, i);
     }
     else if constexpr (std::is_same_v<std::string_view, U>) {
-      sv_ = PQgetvalue(res_, row, i);
-      value = sv_;
+      value = hold_result_text(arena_, sv_, PQgetvalue(res_, row, i),
+                               PQgetlength(res_, row, i));
     }
     else if constexpr (iguana::array_v<U>) {
       auto p = PQgetvalue(res_, row, i);
@@ -833,10 +1258,30 @@ class postgresql {
       auto p = PQgetvalue(res_, row, i);
       memcpy(value, p, sizeof(U));
     }
+    else if constexpr (is_sql_value_type_v<U>) {
+      std::string_view text(PQgetvalue(res_, row, i),
+                            PQgetlength(res_, row, i));
+      if (!parse_sql_text(text, value)) {
+        value = U{};
+        set_invalid_value_error(text);
+      }
+    }
+    else if constexpr (is_json_column_v<U>) {
+      std::string_view text(PQgetvalue(res_, row, i),
+                            PQgetlength(res_, row, i));
+      if (!parse_column_text(text, value, column_text::pg_array)) {
+        value = U{};
+      }
+    }
     else if constexpr (std::is_same_v<blob, U>) {
       auto p = PQgetvalue(res_, row, i);
       value = blob(p, p + PQgetlength(res_, row, i));
     }
+    else if constexpr (is_blob_view_v<U>) {
+      auto str = hold_result_text(arena_, sv_, PQgetvalue(res_, row, i),
+                                  PQgetlength(res_, row, i));
+      value = blob_view(str.data(), str.size());
+    }
 #ifdef ORMPP_WITH_CSTRING
     else if constexpr (std::is_same_v<CString, U>) {
       value.SetString(PQgetvalue(res_, row, i));
@@ -848,13 +1293,184 @@ class postgresql {
   }
 
  private:
+  struct cached_update {
+    std::string name;
+    std::string sql;
+    bool prepared = false;
+  };
+
+  template <typename T>
+  int update_columns_impl(const T *rows, size_t n, uint64_t columns) {
+    if (cursor_busy()) {
+      return INT_MIN;
+    }
+    deallocate_stale_update_stmts();
+    auto key = std::make_pair(type_key_of<T>(), columns);
+    auto it = update_stmts_.find(key);
+    if (it == update_stmts_.end()) {
+      auto sql = generate_update_columns_sql<T>(db_type_v, columns);
+      if (sql.empty()) {
+        set_last_error("update requires a conflict key and a column",
+                       db_errc::invalid_argument);
+        return INT_MIN;
+      }
+      if (update_stmts_.size() >= update_stmt_cache_size) {
+        deallocate_update_stmts();
+      }
+      // names are never reused, a statement left after an error can not
+      // clash with a new one
+      cached_update cached{"ormpp_update_" + std::to_string(++update_stmt_id_),
+                           std::move(sql)};
+      it = update_stmts_.emplace(key, std::move(cached)).first;
+    }
+    int count = execute_update(it->second, rows, n, columns);
+    // A failed row (constraint, bad value, aborted transaction ...) leaves
+    // the statement good. It is prepared again next time only if preparing
+    // failed, or the table or the connection changed under it.
+    if (count == INT_MIN &&
+        (!it->second.prepared || stale_update(error_.sqlstate))) {
+      // 26000: the server does not know the name any more
+      if (it->second.prepared && error_.sqlstate != "26000" &&
+          error_.code != db_errc::connection) {
+        stale_update_stmts_.push_back(std::move(it->second.name));
+      }
+      update_stmts_.erase(it);
+    }
+    return count;
+  }
+
+  // 42: undefined table or column..., 0A000: cached plan must not change
+  // result type, 26000: invalid statement name
+  static bool stale_update(std::string_view sqlstate) {
+    return sqlstate.starts_with("42") || sqlstate == "0A000" ||
+           sqlstate == "26000" || to_errc(sqlstate) == db_errc::connection;
+  }
+
+  template <typename T>
+  int execute_update(cached_update &cached, const T *rows, size_t n,
+                     uint64_t columns) {
+    reset_error();
+#ifdef ORMPP_ENABLE_LOG
+    std::cout << cached.sql << std::endl;
+#endif
+    trace_scope trace(db_type_v, cached.sql, error_);
+    uint64_t keys = conflict_key_columns<T>();
+    if (!cached.prepared) {
+      res_ = PQprepare(con_, cached.name.data(), cached.sql.data(),
+                       std::popcount(columns) + std::popcount(keys), nullptr);
+      auto guard = guard_statment(res_, *this);
+      if (PQresultStatus(res_) != PGRES_COMMAND_OK) {
+        return INT_MIN;
+      }
+      cached.prepared = true;
+    }
+    trace.prepared();
+
+    std::vector<std::vector<char>> param_values;
+    std::vector<const char *> params;
+    int count = 0;
+    for (size_t r = 0; r < n; ++r) {
+      param_values.clear();
+      params.clear();
+      for (uint64_t mask : {columns, keys}) {
+        ylt::reflection::for_each(rows[r], [&](auto &field, auto /*name*/,
+                                               size_t member) {
+          if (mask >> member & 1) {
+            set_param_values(param_values, field);
+          }
+        });
+      }
+      for (auto &value : param_values) {
+        params.push_back(value.data());
+      }
+
+      res_ = PQexecPrepared(con_, cached.name.data(), (int)params.size(),
+                            params.data(), nullptr, nullptr, 0);
+      auto guard = guard_statment(res_, *this);
+      if (PQresultStatus(res_) != PGRES_COMMAND_OK) {
+        return INT_MIN;
+      }
+      count += (int)std::strtoull(PQcmdTuples(res_), nullptr, 10);
+    }
+    trace.executed();
+    trace.set_rows(count);
+    last_affect_rows_ = count;
+    return count;
+  }
+
+  void deallocate_update_stmts() {
+    for (auto &[key, cached] : update_stmts_) {
+      if (cached.prepared) {
+        stale_update_stmts_.push_back(std::move(cached.name));
+      }
+    }
+    update_stmts_.clear();
+    deallocate_stale_update_stmts();
+  }
+
+  // deallocate fails inside an aborted transaction, the names wait for the
+  // first update_columns after the rollback
+  void deallocate_stale_update_stmts() {
+    if (stale_update_stmts_.empty() ||
+        PQtransactionStatus(con_) == PQTRANS_INERROR) {
+      return;
+    }
+    for (auto &name : stale_update_stmts_) {
+      PQclear(PQexec(con_, ("deallocate " + name).data()));
+    }
+    stale_update_stmts_.clear();
+  }
+
+  // Classified by the SQLSTATE class, postgresql has no numeric error codes.
+  static db_errc to_errc(std::string_view sqlstate) {
+    if (sqlstate.size() != 5) {
+      return db_errc::unknown;
+    }
+    if (sqlstate == "57014" || sqlstate == "55P03") {
+      // query_canceled (statement_timeout), lock_not_available
+      return db_errc::timeout;
+    }
+    auto cls = sqlstate.substr(0, 2);
+    if (cls == "23") {
+      return db_errc::constraint;
+    }
+    if (cls == "40") {
+      return db_errc::transaction;
+    }
+    if (cls == "08" || cls == "57") {
+      return db_errc::connection;
+    }
+    if (cls == "22") {
+      return db_errc::invalid_argument;
+    }
+    return db_errc::statement;
+  }
+
+  // the first value of the result that did not parse
+  void set_invalid_value_error(std::string_view text) {
+    if (!error_) {
+      set_last_error("invalid decimal or temporal value '" +
+                         std::string(text) + "'",
+                     db_errc::protocol);
+    }
+  }
+
+  void set_result_error(PGresult *res) {
+    const char *state = PQresultErrorField(res, PG_DIAG_SQLSTATE);
+    std::string_view sqlstate = state ? state : "";
+    error_.assign(to_errc(sqlstate), PQresultErrorMessage(res), 0, sqlstate);
+    std::cout << error_.message << std::endl;
+  }
+
   struct guard_statment {
-    guard_statment(PGresult *res) : res_(res) { reset_error(); }
+    guard_statment(PGresult *res, postgresql &db) : res_(res), db_(db) {
+      db_.reset_error();
+    }
     ~guard_statment() {
       if (res_ != nullptr) {
         auto status = PQresultStatus(res_);
         if (status != PGRES_COMMAND_OK && status != PGRES_TUPLES_OK) {
-          set_last_error(PQresultErrorMessage(res_));
+          db_.set_result_error(res_);
         }
         PQclear(res_);
       }
@@ -862,16 +1478,34 @@ class postgresql {
 
    private:
     PGresult *res_ = nullptr;
+    postgresql &db_;
   };
 
  private:
+  // fails a statement issued from inside a query_each callback, see
+  // cursor_scope
+  bool cursor_busy() {
+    if (!in_cursor_) {
+      return false;
+    }
+    set_last_error(std::string(cursor_busy_error), db_errc::invalid_argument);
+    return true;
+  }
+
   PGconn *con_ = nullptr;
   PGresult *res_ = nullptr;
-  inline static std::string sv_;
-  inline static std::string last_error_;
-  inline static bool has_error_ = false;
-  inline static bool transaction_ = true;
+  std::string sv_;
+  string_arena *arena_ = nullptr;
+  // set while query_each reads rows
+  bool in_cursor_ = false;
+  db_error error_;
+  bool transaction_ = true;
   int last_affect_rows_;
+  // update_columns statements by struct and column mask
+  std::map<std::pair<type_key, uint64_t>, cached_update> update_stmts_;
+  // names to deallocate once the transaction can take statements again
+  std::vector<std::string> stale_update_stmts_;
+  uint64_t update_stmt_id_ = 0;
 };
 }  // namespace ormpp
 
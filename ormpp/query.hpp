@@ -1,11 +1,20 @@
 #pragma once
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <functional>
 #include <iterator>
+#include <optional>
+#include <stdexcept>
 #include <string>
 #include <tuple>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "async_traits.hpp"
+#include "db_error.hpp"
+#include "relation.hpp"
 #include "utility.hpp"
 
 namespace ormpp {
@@ -564,47 +573,10 @@ inline void append_group_by_field(std::string& sql, auto field) {
 inline std::size_t find_next_postgresql_placeholder(std::string_view sql,
                                                     std::size_t start) {
   for (std::size_t i = start; i < sql.size(); ++i) {
-    switch (sql[i]) {
-      case '?':
-        return i;
-      case '\'':
-      case '"': {
-        const char quote = sql[i];
-        ++i;
-        while (i < sql.size()) {
-          if (sql[i] == quote) {
-            if (i + 1 < sql.size() && sql[i + 1] == quote) {
-              i += 2;
-              continue;
-            }
-            break;
-          }
-          ++i;
-        }
-        break;
-      }
-      case '-':
-        if (i + 1 < sql.size() && sql[i + 1] == '-') {
-          i += 2;
-          while (i < sql.size() && sql[i] != '\n' && sql[i] != '\r') {
-            ++i;
-          }
-        }
-        break;
-      case '/':
-        if (i + 1 < sql.size() && sql[i + 1] == '*') {
-          i += 2;
-          while (i + 1 < sql.size() && !(sql[i] == '*' && sql[i + 1] == '/')) {
-            ++i;
-          }
-          if (i + 1 < sql.size()) {
-            ++i;
-          }
-        }
-        break;
-      default:
-        break;
+    if (sql[i] == '?') {
+      return i;
     }
+    i = skip_sql_quoted_or_comment(sql, i);
   }
   return std::string_view::npos;
 }
@@ -624,6 +596,45 @@ inline std::string replace_postgresql_placeholders(std::string sql) {
   return sql;
 }
 
+// Seek condition past the last row of a page for keys (k1, k2, ...):
+// (k1 > ?) OR (k1 = ? AND k2 > ?) OR ..., a DESC key compares with <. Every
+// branch bounds k1, so an index on the keys serves it as a range scan.
+template <typename... Keys>
+std::string keyset_predicate(const Keys&... keys) {
+  std::vector<std::pair<std::string, bool>> cols;
+  (cols.emplace_back(qualified_field_name(keys.class_name, keys.name),
+                     keys.sort_order == " DESC "),
+   ...);
+  std::string sql = "(";
+  for (size_t i = 0; i < cols.size(); ++i) {
+    if (i > 0) {
+      sql.append(" OR ");
+    }
+    sql.append("(");
+    for (size_t j = 0; j < i; ++j) {
+      sql.append(cols[j].first).append(" = ? AND ");
+    }
+    sql.append(cols[i].first).append(cols[i].second ? " < ?" : " > ?");
+    sql.append(")");
+  }
+  sql.append(")");
+  return sql;
+}
+
+// Key index bound to each placeholder of keyset_predicate: 0, 0 1, 0 1 2 ...
+template <size_t N>
+constexpr auto keyset_param_order() {
+  constexpr size_t count = N * (N + 1) / 2;
+  std::array<size_t, count> order{};
+  size_t pos = 0;
+  for (size_t i = 0; i < N; ++i) {
+    for (size_t j = 0; j <= i; ++j) {
+      order[pos++] = j;
+    }
+  }
+  return order;
+}
+
 template <typename DB, typename R>
 struct stage_select;
 
@@ -650,6 +661,16 @@ class query_builder {
     std::string avg_clause_;
     std::string min_clause_;
     std::string max_clause_;
+    // added by with(), run on the rows of a select(all) query
+    std::vector<std::function<bool(std::vector<T>&)>> relations_;
+
+    template <auto... members>
+    void add_relations() {
+      (relations_.push_back([db = db_](std::vector<T>& rows) {
+        return load_relation<members>(db, rows);
+      }),
+       ...);
+    }
 
     template <typename To>
     static constexpr bool scalar_collect_target_v =
@@ -690,6 +711,15 @@ class query_builder {
       return "";
     }
 
+    void and_where(const std::string& condition) {
+      if (where_clause_.empty()) {
+        where_clause_ = condition;
+      }
+      else {
+        where_clause_ = "(" + where_clause_ + ") AND " + condition;
+      }
+    }
+
     std::string build_sql() const {
       std::string sql = sql_;
       std::string where_clause = where_clause_;
@@ -751,12 +781,12 @@ class query_builder {
       }
     }
 
+    // Not a coroutine, the query is awaited by collect_async directly. sql and
+    // params live in the frame of collect_async and are passed by reference.
     template <typename Out, typename Tuple, std::size_t... I>
-    db_awaitable_t<DB, std::vector<Out>> query_async_with_params(
-        const std::string& sql, Tuple& params, std::index_sequence<I...>) {
-      co_return co_await db_->template query_s<Out>(
-          sql,
-          std::decay_t<decltype(std::get<I>(params))>(std::get<I>(params))...);
+    auto query_async_with_params(const std::string& sql, Tuple& params,
+                                 std::index_sequence<I...>) {
+      return db_->template query_s<Out>(sql, std::get<I>(params)...);
     }
 
     template <typename To, typename... Args>
@@ -771,6 +801,13 @@ class query_builder {
       else if constexpr (std::is_void_v<R>) {
         auto result =
             db_->template query_s<T>(sql, std::forward<Args>(args)...);
+        // a failed relation query gives no rows, as a failed select does
+        for (auto& load : relations_) {
+          if (!load(result)) {
+            result.clear();
+            break;
+          }
+        }
         return extract_query_result<To>(std::move(result));
       }
       else if constexpr (std::is_void_v<To>) {
@@ -876,9 +913,25 @@ class query_builder {
     return ctx_->scalar(args...);
   }
 
+  // Loads the children of registered relations for all rows, one query per
+  // relation, see load_relation.
+  template <auto... members>
+    requires(std::is_void_v<R> && !is_async_db_v<DB>)
+  query_builder with() {
+    ctx_->template add_relations<members...>();
+    return *this;
+  }
+
   struct stage_offset {
     std::shared_ptr<context> ctx;
 
+    template <auto... members>
+      requires(std::is_void_v<R> && !is_async_db_v<DB>)
+    stage_offset with() {
+      ctx->template add_relations<members...>();
+      return *this;
+    }
+
     template <typename To, typename... Args>
     auto collect(Args... args) {
       return ctx->template collect<To>(args...);
@@ -898,6 +951,13 @@ class query_builder {
   struct stage_limit {
     std::shared_ptr<context> ctx;
 
+    template <auto... members>
+      requires(std::is_void_v<R> && !is_async_db_v<DB>)
+    stage_limit with() {
+      ctx->template add_relations<members...>();
+      return *this;
+    }
+
     stage_offset offset(uint64_t row) {
       ctx->offset_clause_.append(" offset ").append(std::to_string(row));
       return stage_offset{ctx};
@@ -927,6 +987,13 @@ class query_builder {
   struct stage_order {
     std::shared_ptr<context> ctx;
 
+    template <auto... members>
+      requires(std::is_void_v<R> && !is_async_db_v<DB>)
+    stage_order with() {
+      ctx->template add_relations<members...>();
+      return *this;
+    }
+
     stage_limit limit(uint64_t n) {
       ctx->limit_clause_ = " LIMIT " + std::to_string(n);
       return stage_limit{ctx};
@@ -953,6 +1020,193 @@ class query_builder {
     }
   };
 
+  // Keyset (seek) pagination: every page is
+  //   ... WHERE <where> AND <past last key> ORDER BY <keys> LIMIT n
+  // with the keys of the previous page's last row bound as parameters, so a
+  // deep page costs as much as the first one instead of scanning the OFFSET.
+  // The keys must identify a row, end them with the primary key.
+  template <typename... M>
+  class stage_paginate {
+   public:
+    using key_type = std::tuple<M...>;
+
+    stage_paginate(std::shared_ptr<context> ctx, uint64_t page_size,
+                   col_info<M>... keys)
+        : db_(ctx->db_), page_size_(page_size) {
+      static_assert(std::is_void_v<R>,
+                    "paginate_by needs select(all), the keys are read from "
+                    "the rows");
+      // LIMIT 0 would give empty pages forever
+      if (page_size == 0) {
+        throw std::invalid_argument("paginate_by: page size must not be 0");
+      }
+      auto table_name = get_short_struct_name<T>();
+      constexpr auto names = ylt::reflection::get_member_names<T>();
+      size_t i = 0;
+      (
+          [&](const auto& key) {
+            auto it = std::find(names.begin(), names.end(), key.name);
+            if (it == names.end() ||
+                (!key.class_name.empty() && key.class_name != table_name)) {
+              throw std::invalid_argument(
+                  "paginate_by: key is not a column of the queried table");
+            }
+            field_index_[i++] = std::distance(names.begin(), it);
+          }(keys),
+          ...);
+
+      std::string where = ctx->where_clause_;
+      ctx->order_by_clause_ = order_by_sql(keys...);
+      ctx->limit_clause_ = " LIMIT " + std::to_string(page_size);
+      first_sql_ = ctx->build_sql();
+      ctx->and_where(keyset_predicate(keys...));
+      next_sql_ = ctx->build_sql();
+      ctx->where_clause_ = std::move(where);
+    }
+
+    // Continue after a key saved from an earlier page, e.g. a cursor handed
+    // out to a client.
+    stage_paginate& after(M... last) {
+      last_ = key_type{std::move(last)...};
+      done_ = false;
+      return *this;
+    }
+
+    // Key of the last row fetched so far
+    const std::optional<key_type>& last_key() const { return last_; }
+
+    // No further page, the last one was short
+    bool done() const { return done_; }
+
+    // Fetch the next page, args bind the where() placeholders. A page shorter
+    // than the page size is the last one.
+    template <typename... Args>
+      requires(!is_async_db_v<DB>)
+    std::vector<T> next(Args... args) {
+      if (done_) {
+        return {};
+      }
+      auto rows = query_page(args...);
+      remember(rows);
+      return rows;
+    }
+
+    template <typename... Args>
+      requires(is_async_db_v<DB>)
+    db_awaitable_t<DB, std::vector<T>> next(Args... args) {
+      if (done_) {
+        co_return std::vector<T>{};
+      }
+      auto op = query_page(args...);
+      auto rows = co_await std::move(op);
+      remember(rows);
+      co_return rows;
+    }
+
+    class iterator {
+     public:
+      using iterator_category = std::input_iterator_tag;
+      using value_type = std::vector<T>;
+      using difference_type = std::ptrdiff_t;
+      using pointer = const value_type*;
+      using reference = const value_type&;
+
+      iterator() = default;
+      explicit iterator(stage_paginate* pager) : pager_(pager) { fetch(); }
+
+      reference operator*() const { return page_; }
+      pointer operator->() const { return &page_; }
+
+      iterator& operator++() {
+        fetch();
+        return *this;
+      }
+
+      bool operator==(const iterator& other) const {
+        return pager_ == other.pager_;
+      }
+
+     private:
+      void fetch() {
+        page_ = pager_->done() ? value_type{} : pager_->next();
+        if (page_.empty()) {
+          pager_ = nullptr;
+        }
+      }
+
+      stage_paginate* pager_ = nullptr;
+      value_type page_;
+    };
+
+    // for (auto& page : pager), synchronous connections only
+    iterator begin()
+      requires(!is_async_db_v<DB>)
+    {
+      return iterator(this);
+    }
+
+    iterator end()
+      requires(!is_async_db_v<DB>)
+    {
+      return iterator();
+    }
+
+   private:
+    template <typename... Args>
+    auto query_page(Args&... args) {
+      if (!last_) {
+        return db_->template query_s<T>(first_sql_, args...);
+      }
+      return query_after(std::make_index_sequence<
+                             keyset_param_order<sizeof...(M)>().size()>{},
+                         args...);
+    }
+
+    template <size_t... I, typename... Args>
+    auto query_after(std::index_sequence<I...>, Args&... args) {
+      constexpr auto order = keyset_param_order<sizeof...(M)>();
+      return db_->template query_s<T>(next_sql_, args...,
+                                      std::get<order[I]>(*last_)...);
+    }
+
+    void remember(std::vector<T>& rows) {
+      done_ = rows.size() < page_size_;
+      if (rows.empty()) {
+        return;
+      }
+      key_type key;
+      auto& row = rows.back();
+      ylt::reflection::for_each(row, [&](auto& field, auto /*name*/,
+                                         size_t index) {
+        copy_key(field, index, key, std::index_sequence_for<M...>{});
+      });
+      last_ = std::move(key);
+    }
+
+    template <typename Field, size_t... I>
+    void copy_key(const Field& field, size_t index, key_type& key,
+                  std::index_sequence<I...>) {
+      (
+          [&] {
+            using key_t = std::tuple_element_t<I, key_type>;
+            if constexpr (std::is_same_v<Field, key_t>) {
+              if (index == field_index_[I]) {
+                std::get<I>(key) = field;
+              }
+            }
+          }(),
+          ...);
+    }
+
+    DB db_;
+    uint64_t page_size_;
+    std::array<size_t, sizeof...(M)> field_index_{};
+    std::string first_sql_;
+    std::string next_sql_;
+    std::optional<key_type> last_;
+    bool done_ = false;
+  };
+
   struct stage_having {
     std::shared_ptr<context> ctx;
     std::string cond_;
@@ -1037,9 +1291,30 @@ class query_builder {
     return stage_limit{ctx_};
   }
 
+  // Rows past `last` in key order: WHERE col > last ORDER BY col (< for a
+  // DESC key), usually followed by limit(n).
+  template <typename M, typename V>
+  stage_order after(col_info<M> field, V last) {
+    return after_impl(ctx_, std::move(field), std::move(last));
+  }
+
+  // paginate_by(col(&T::id), 100), or with a composite key
+  // paginate_by(col(&T::age), col(&T::id), 100)
+  template <typename... Args>
+  auto paginate_by(Args... args) {
+    return paginate_impl(ctx_, std::move(args)...);
+  }
+
   struct stage_where {
     std::shared_ptr<context> ctx;
 
+    template <auto... members>
+      requires(std::is_void_v<R> && !is_async_db_v<DB>)
+    stage_where with() {
+      ctx->template add_relations<members...>();
+      return *this;
+    }
+
     template <typename... Args>
     stage_order order_by(Args... fields) {
       ctx->order_by_clause_ = order_by_sql(fields...);
@@ -1056,6 +1331,16 @@ class query_builder {
       return stage_limit{ctx};
     }
 
+    template <typename M, typename V>
+    stage_order after(col_info<M> field, V last) {
+      return after_impl(ctx, std::move(field), std::move(last));
+    }
+
+    template <typename... Args>
+    auto paginate_by(Args... args) {
+      return paginate_impl(ctx, std::move(args)...);
+    }
+
     template <typename... Args>
     stage_group_by group_by(Args... fields) {
       ctx->group_by_clause_ = " GROUP BY ";
@@ -1123,6 +1408,16 @@ class query_builder {
       return stage_limit{ctx};
     }
 
+    template <typename M, typename V>
+    stage_order after(col_info<M> field, V last) {
+      return after_impl(ctx, std::move(field), std::move(last));
+    }
+
+    template <typename... Args>
+    auto paginate_by(Args... args) {
+      return paginate_impl(ctx, std::move(args)...);
+    }
+
     template <typename To, typename... Args>
     auto collect(Args... args) {
       return ctx->template collect<To>(args...);
@@ -1170,6 +1465,32 @@ class query_builder {
   }
 
  private:
+  template <typename M, typename V>
+  static stage_order after_impl(std::shared_ptr<context> ctx,
+                                col_info<M> field, V last) {
+    bool desc = field.sort_order == " DESC ";
+    ctx->and_where(build_where(field, std::move(last), desc ? "<" : ">")
+                       .to_sql());
+    ctx->order_by_clause_ = order_by_sql(field);
+    return stage_order{ctx};
+  }
+
+  // The trailing argument is the page size, the ones before it the keys
+  template <typename... Args>
+  static auto paginate_impl(std::shared_ptr<context> ctx, Args... args) {
+    constexpr size_t n = sizeof...(Args) - 1;
+    static_assert(n > 0, "paginate_by needs at least one key and a page size");
+    auto t = std::make_tuple(std::move(args)...);
+    using tuple_t = decltype(t);
+    static_assert(std::is_integral_v<std::tuple_element_t<n, tuple_t>>,
+                  "the last argument of paginate_by is the page size");
+    return [&]<size_t... I>(std::index_sequence<I...>) {
+      return stage_paginate<
+          typename std::tuple_element_t<I, tuple_t>::value_type...>(
+          ctx, std::get<n>(t), std::get<I>(t)...);
+    }(std::make_index_sequence<n>{});
+  }
+
   friend struct stage_select<DB, R>;
   friend struct stage_aggregate_t<DB>;
   DB db_;
@@ -2226,4 +2547,112 @@ alter_table_builder<T, DB> make_alter_table_buildeer(DB db) {
   return make_alter_table_builder<T, DB>(db);
 }
 
+// Statement of a bulk upsert without its rows, the backend puts them between
+// head and conflict, see postgresql::bulk_upsert and sqlite::bulk_upsert.
+struct bulk_upsert_sql {
+  std::string head;      // insert into t(a,b,c)
+  std::string conflict;  // on conflict(a) do update set b=excluded.b,...
+  std::vector<bool> columns;  // per member, true when it is inserted
+};
+
+// Insert-or-update of many rows with one statement per batch instead of one
+// per row:
+//
+//   pg.upsert<person>()
+//       .on_conflict(col(&person::id))  // REGISTER_CONFLICT_KEY by default
+//       .update(col(&person::age))      // all other columns by default
+//       .batch_size(5000)
+//       .execute(rows);
+//
+// The auto key is only inserted when it is a conflict key, otherwise new rows
+// get a generated one. Returns the number of rows inserted or updated,
+// INT_MIN on error.
+template <typename T, typename DB>
+struct upsert_builder {
+  static constexpr DBType db_type = std::remove_pointer_t<DB>::db_type_v;
+  DB db_;
+  std::vector<std::string> conflict_keys_;
+  std::optional<std::vector<std::string>> update_fields_;
+  size_t batch_size_ = 1000;
+
+  template <typename... M>
+  upsert_builder& on_conflict(col_info<M>... fields) {
+    conflict_keys_ = {std::string(fields.name)...};
+    return *this;
+  }
+
+  // Columns overwritten on conflict, none makes it "do nothing"
+  template <typename... M>
+  upsert_builder& update(col_info<M>... fields) {
+    update_fields_ = std::vector<std::string>{std::string(fields.name)...};
+    return *this;
+  }
+
+  upsert_builder& batch_size(size_t rows) {
+    batch_size_ = (std::max)(rows, size_t(1));
+    return *this;
+  }
+
+  int execute(const std::vector<T>& rows) {
+    auto keys = conflict_keys_.empty() ? get_conflict_keys<T>(db_type)
+                                       : conflict_keys_;
+    if (keys.empty()) {
+      db_->set_last_error("upsert requires a conflict key",
+                          db_errc::invalid_argument);
+      return INT_MIN;
+    }
+    if (rows.empty()) {
+      return 0;
+    }
+    return db_->template bulk_upsert<T>(rows, build_sql(keys), batch_size_);
+  }
+
+  bulk_upsert_sql build_sql(const std::vector<std::string>& keys) const {
+    auto is_key = [&keys](std::string_view name) {
+      return std::find(keys.begin(), keys.end(), name) != keys.end();
+    };
+
+    bulk_upsert_sql stmt;
+    std::string set;
+    stmt.head.append("insert into ")
+        .append(get_short_struct_name<T>())
+        .append("(");
+    for (auto name : ylt::reflection::get_member_names<T>()) {
+      bool inserted = !is_auto_key<T>(name) || is_key(name);
+      stmt.columns.push_back(inserted);
+      if (!inserted) {
+        continue;
+      }
+      stmt.head.append(name).append(",");
+      bool updated = update_fields_ ? std::find(update_fields_->begin(),
+                                                update_fields_->end(),
+                                                name) != update_fields_->end()
+                                    : !is_key(name);
+      if (updated) {
+        set.append(name).append("=excluded.").append(name).append(",");
+      }
+    }
+    stmt.head.back() = ')';
+
+    stmt.conflict.append(" on conflict(");
+    for (auto& key : keys) {
+      stmt.conflict.append(key).append(",");
+    }
+    stmt.conflict.back() = ')';
+    if (set.empty()) {
+      stmt.conflict.append(" do nothing");
+    }
+    else {
+      set.pop_back();
+      stmt.conflict.append(" do update set ").append(set);
+    }
+    return stmt;
+  }
+};
+
+template <typename T, typename DB>
+upsert_builder<T, DB> make_upsert_builder(DB db) {
+  return upsert_builder<T, DB>{db};
+}
+
 }  // namespace ormpp
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "query_trace.hpp"
+
+namespace ormpp {
+
+// Log-linear latency histogram: every power of two is split into four
+// buckets, so quantiles come with at most 25% relative error in constant
+// memory, whatever the number of samples.
+class latency_sketch {
+ public:
+  void add(std::chrono::nanoseconds elapsed) {
+    auto ns = static_cast<uint64_t>(std::max<int64_t>(elapsed.count(), 0));
+    ++buckets_[bucket_of(ns)];
+    ++count_;
+  }
+
+  uint64_t count() const { return count_; }
+
+  // Upper bound of the bucket holding the q-th quantile.
+  std::chrono::nanoseconds quantile(double q) const {
+    if (count_ == 0) {
+      return {};
+    }
+    auto rank = static_cast<uint64_t>(q * static_cast<double>(count_));
+    rank = std::clamp<uint64_t>(rank, 1, count_);
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < buckets_.size(); ++i) {
+      seen += buckets_[i];
+      if (seen >= rank) {
+        return std::chrono::nanoseconds(
+            static_cast<int64_t>(upper_bound_of(i)));
+      }
+    }
+    return {};
+  }
+
+ private:
+  static constexpr int sub_bits = 2;
+  static constexpr uint64_t sub_count = 1 << sub_bits;
+
+  static std::size_t bucket_of(uint64_t ns) {
+    if (ns < sub_count) {
+      return static_cast<std::size_t>(ns);
+    }
+    int exp = std::bit_width(ns) - 1;
+    uint64_t sub = (ns >> (exp - sub_bits)) & (sub_count - 1);
+    return static_cast<std::size_t>(((exp - sub_bits + 1) << sub_bits) + sub);
+  }
+
+  static uint64_t upper_bound_of(std::size_t bucket) {
+    if (bucket < sub_count) {
+      return bucket;
+    }
+    int exp = static_cast<int>(bucket >> sub_bits) + sub_bits - 1;
+    uint64_t sub = bucket & (sub_count - 1);
+    uint64_t width = uint64_t(1) << (exp - sub_bits);
+    return ((sub_count + sub) << (exp - sub_bits)) + width - 1;
+  }
+
+  std::array<uint64_t, 64 << sub_bits> buckets_{};
+  uint64_t count_ = 0;
+};
+
+// Aggregated statistics of one normalized statement.
+struct query_stat {
+  DBType db_type = DBType::unknown;
+  uint64_t fingerprint = 0;
+  std::string sql;  // normalized, see normalize_sql()
+  uint64_t calls = 0;
+  uint64_t errors = 0;
+  uint64_t rows = 0;
+  uint64_t bytes = 0;
+  std::chrono::nanoseconds total_time{};
+  std::chrono::nanoseconds max_time{};
+  std::chrono::nanoseconds p99_time{};
+
+  std::chrono::nanoseconds mean_time() const {
+    if (calls == 0) {
+      return {};
+    }
+    return total_time / static_cast<int64_t>(calls);
+  }
+};
+
+using slow_query_logger = std::function<void(const query_trace &)>;
+
+// Client side counterpart of pg_stat_statements for every backend: statements
+// reported by the tracing hooks are grouped by their normalized fingerprint,
+// and the ones slower than the threshold are handed to the slow query logger.
+// The hooks only exist with ORMPP_ENABLE_TRACE, without it enable() has no
+// effect and snapshots stay empty.
+class query_stats {
+ public:
+  static query_stats &instance() {
+    static query_stats instance;
+    return instance;
+  }
+
+  void enable(bool on = true) {
+#ifdef ORMPP_ENABLE_TRACE
+    detail::query_stats_sink().store(on ? &query_stats::on_trace : nullptr,
+                                     std::memory_order_release);
+    detail::refresh_query_tracer_enabled();
+#else
+    (void)on;
+#endif
+  }
+
+  bool enabled() const {
+#ifdef ORMPP_ENABLE_TRACE
+    return detail::query_stats_sink().load(std::memory_order_acquire) !=
+           nullptr;
+#else
+    return false;
+#endif
+  }
+
+  // Statements taking longer than threshold are logged, zero turns the slow
+  // query log off.
+  template <typename Rep, typename Period>
+  void set_slow_threshold(std::chrono::duration<Rep, Period> threshold) {
+    std::unique_lock lock(mtx_);
+    slow_threshold_ =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(threshold);
+  }
+
+  // Replaces the default logger, which writes to std::cerr.
+  void set_slow_logger(slow_query_logger logger) {
+    std::unique_lock lock(mtx_);
+    slow_logger_ = std::move(logger);
+  }
+
+  // Statements with a new fingerprint are no longer tracked once the table
+  // holds max_entries, they are only counted as dropped.
+  void set_max_entries(std::size_t max_entries) {
+    std::unique_lock lock(mtx_);
+    max_entries_ = max_entries;
+  }
+
+  uint64_t dropped() const {
+    std::unique_lock lock(mtx_);
+    return dropped_;
+  }
+
+  // Copy of the table, most expensive statements first.
+  std::vector<query_stat> snapshot() const {
+    std::vector<query_stat> v;
+    {
+      std::unique_lock lock(mtx_);
+      v.reserve(entries_.size());
+      for (auto &[key, entry] : entries_) {
+        query_stat stat = entry.stat;
+        stat.p99_time = entry.sketch.quantile(0.99);
+        v.push_back(std::move(stat));
+      }
+    }
+    std::sort(v.begin(), v.end(), [](const auto &a, const auto &b) {
+      return a.total_time > b.total_time;
+    });
+    return v;
+  }
+
+  void reset() {
+    std::unique_lock lock(mtx_);
+    entries_.clear();
+    dropped_ = 0;
+  }
+
+  void record(const query_trace &trace) {
+    auto elapsed = trace.total_time();
+    slow_query_logger logger;
+    {
+      std::unique_lock lock(mtx_);
+      auto key = entry_key{trace.db_type, trace.fingerprint};
+      auto it = entries_.find(key);
+      if (it == entries_.end()) {
+        if (entries_.size() >= max_entries_) {
+          ++dropped_;
+        }
+        else {
+          it = entries_.emplace(key, entry{}).first;
+          it->second.stat.db_type = trace.db_type;
+          it->second.stat.fingerprint = trace.fingerprint;
+          it->second.stat.sql = normalize_sql(trace.sql);
+        }
+      }
+
+      if (it != entries_.end()) {
+        auto &stat = it->second.stat;
+        ++stat.calls;
+        stat.errors += trace.ok ? 0 : 1;
+        stat.rows += trace.rows;
+        stat.bytes += trace.bytes;
+        stat.total_time += elapsed;
+        stat.max_time = std::max(stat.max_time, elapsed);
+        it->second.sketch.add(elapsed);
+      }
+
+      if (slow_threshold_.count() > 0 && elapsed >= slow_threshold_) {
+        logger = slow_logger_;
+      }
+    }
+
+    if (logger) {
+      logger(trace);
+    }
+  }
+
+ private:
+  query_stats() = default;
+  query_stats(const query_stats &) = delete;
+  query_stats &operator=(const query_stats &) = delete;
+
+  static void on_trace(const query_trace &trace) { instance().record(trace); }
+
+  static void log_to_stderr(const query_trace &trace) {
+    std::cerr << "ormpp slow query: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(
+                     trace.total_time())
+                     .count()
+              << "us rows=" << trace.rows << " " << trace.sql << std::endl;
+  }
+
+  struct entry_key {
+    DBType db_type;
+    uint64_t fingerprint;
+
+    bool operator==(const entry_key &) const = default;
+  };
+
+  struct entry_hash {
+    std::size_t operator()(const entry_key &key) const {
+      return std::hash<uint64_t>{}(key.fingerprint ^
+                                   static_cast<uint64_t>(key.db_type));
+    }
+  };
+
+  struct entry {
+    query_stat stat;
+    latency_sketch sketch;
+  };
+
+  mutable std::mutex mtx_;
+  std::unordered_map<entry_key, entry, entry_hash> entries_;
+  std::chrono::nanoseconds slow_threshold_{};
+  slow_query_logger slow_logger_ = &query_stats::log_to_stderr;
+  std::size_t max_entries_ = 1000;
+  uint64_t dropped_ = 0;
+};
+
+}  // namespace ormpp
@@ -0,0 +1,493 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "db_error.hpp"
+#include "utility.hpp"
+
+namespace ormpp {
+
+// One finished statement, handed to the tracer installed with
+// set_query_tracer(). The string views are only valid inside the callback.
+struct query_trace {
+  DBType db_type = DBType::unknown;
+  std::string_view sql;
+  uint64_t fingerprint = 0;
+  std::chrono::nanoseconds prepare_time{};
+  std::chrono::nanoseconds execute_time{};
+  std::chrono::nanoseconds fetch_time{};
+  uint64_t rows = 0;
+  uint64_t bytes = 0;
+  bool ok = true;
+  std::string_view error;
+
+  std::chrono::nanoseconds total_time() const {
+    return prepare_time + execute_time + fetch_time;
+  }
+};
+
+using query_tracer = std::function<void(const query_trace &)>;
+
+namespace detail {
+inline bool is_sql_identifier_char(char c) {
+  return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$';
+}
+
+// Outputs of the normalizer: the normalized text, or only its FNV-1a hash so
+// that fingerprinting a statement allocates nothing. mark() and rewind()
+// take back what was written since the mark.
+struct sql_text_out {
+  std::string text;
+
+  void push(char c) { text.push_back(c); }
+  std::size_t mark() const { return text.size(); }
+  void rewind(std::size_t mark) { text.resize(mark); }
+};
+
+struct sql_hash_out {
+  uint64_t hash = 14695981039346656037ull;
+
+  void push(char c) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ull;
+  }
+  uint64_t mark() const { return hash; }
+  void rewind(uint64_t mark) { hash = mark; }
+};
+
+// Replaces every parenthesized list made only of placeholders with "(?+)"
+// and folds a run of such lists into one, so that IN lists and multi-row
+// VALUES of any length share a fingerprint. A list is written through as it
+// is read and taken back at its ')'.
+template <typename Out>
+class placeholder_list_folder {
+ public:
+  explicit placeholder_list_folder(Out &out) : out_(out) {}
+
+  void push(char c) {
+    if (in_list_) {
+      if (c == '?' || c == ',' || c == ' ') {
+        has_placeholder_ |= c == '?';
+        write(c);
+        return;
+      }
+      in_list_ = false;
+      if (c == ')' && has_placeholder_) {
+        // a list right after "(?+)," or "(?+), " joins the one before
+        if (fold_) {
+          out_.rewind(list_end_);
+        }
+        else {
+          out_.rewind(list_start_);
+          for (char ch : std::string_view("(?+)")) {
+            out_.push(ch);
+          }
+          list_end_ = out_.mark();
+        }
+        set_tail("(?+)");
+        return;
+      }
+    }
+
+    if (c == '(') {
+      fold_ = tail_ends_with("(?+),") || tail_ends_with("(?+), ");
+      list_start_ = out_.mark();
+      in_list_ = true;
+      has_placeholder_ = false;
+    }
+    write(c);
+  }
+
+ private:
+  using mark_t = decltype(std::declval<const Out &>().mark());
+
+  void write(char c) {
+    out_.push(c);
+    std::copy(tail_.begin() + 1, tail_.end(), tail_.begin());
+    tail_.back() = c;
+    if (c == ')' && tail_ends_with("(?+)")) {
+      list_end_ = out_.mark();
+    }
+  }
+
+  void set_tail(std::string_view text) {
+    tail_.fill('\0');
+    std::copy(text.begin(), text.end(), tail_.end() - text.size());
+  }
+
+  bool tail_ends_with(std::string_view text) const {
+    return std::string_view(tail_.data(), tail_.size()).ends_with(text);
+  }
+
+  Out &out_;
+  bool in_list_ = false;
+  bool has_placeholder_ = false;
+  bool fold_ = false;
+  // the last characters written, enough to recognize "(?+), "
+  std::array<char, 6> tail_{};
+  mark_t list_start_{};
+  // just after the last "(?+)" written
+  mark_t list_end_{};
+};
+
+// Writes the normalized statement to out one character at a time, see
+// normalize_sql.
+template <typename Out>
+void normalize_sql_to(std::string_view sql, Out &out) {
+  bool started = false;
+  bool pending_space = false;
+  auto put = [&](std::string_view token) {
+    if (pending_space && started) {
+      out.push(' ');
+    }
+    pending_space = false;
+    started = true;
+    for (char c : token) {
+      out.push(c);
+    }
+  };
+
+  for (std::size_t i = 0; i < sql.size(); ++i) {
+    char c = sql[i];
+    if (std::isspace(static_cast<unsigned char>(c))) {
+      pending_space = true;
+      continue;
+    }
+
+    std::size_t end = skip_sql_quoted_or_comment(sql, i);
+    if (end != i) {
+      if (c == '\'') {
+        put("?");
+      }
+      else if (c == '"') {
+        put(sql.substr(i, end - i + 1));
+      }
+      else {
+        pending_space = true;
+      }
+      i = end;
+      continue;
+    }
+
+    if (c == '`') {
+      end = sql.find('`', i + 1);
+      end = end == std::string_view::npos ? sql.size() - 1 : end;
+      put(sql.substr(i, end - i + 1));
+      i = end;
+    }
+    else if (c == '$' && i + 1 < sql.size() &&
+             std::isdigit(static_cast<unsigned char>(sql[i + 1])) &&
+             (i == 0 || !is_sql_identifier_char(sql[i - 1]))) {
+      while (i + 1 < sql.size() &&
+             std::isdigit(static_cast<unsigned char>(sql[i + 1]))) {
+        ++i;
+      }
+      put("?");
+    }
+    else if (std::isdigit(static_cast<unsigned char>(c)) &&
+             (i == 0 || !is_sql_identifier_char(sql[i - 1]))) {
+      // decimal, hex and exponent forms: 42, 1.5, 0x1f, 2e-3
+      while (i + 1 < sql.size()) {
+        char next = sql[i + 1];
+        bool sign = (next == '+' || next == '-') &&
+                    (sql[i] == 'e' || sql[i] == 'E');
+        if (!std::isalnum(static_cast<unsigned char>(next)) && next != '.' &&
+            !sign) {
+          break;
+        }
+        ++i;
+      }
+      put("?");
+    }
+    else {
+      char lower =
+          static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+      put(std::string_view(&lower, 1));
+    }
+  }
+}
+}  // namespace detail
+
+// Normalizes a statement so that executions differing only in literal values
+// compare equal: string and numeric literals and $n parameters become '?',
+// comments are dropped, whitespace is collapsed and keywords are lowercased.
+// Quotes and comments are recognized the same way placeholders are found
+// when rewriting SQL for postgresql.
+inline std::string normalize_sql(std::string_view sql) {
+  detail::sql_text_out out;
+  out.text.reserve(sql.size());
+  detail::placeholder_list_folder folder(out);
+  detail::normalize_sql_to(sql, folder);
+  return std::move(out.text);
+}
+
+// FNV-1a of the normalized statement, stable across processes so that
+// fingerprints can be compared between runs and hosts. It is hashed while
+// normalizing, without building the normalized text.
+inline uint64_t sql_fingerprint(std::string_view sql) {
+  detail::sql_hash_out out;
+  detail::placeholder_list_folder folder(out);
+  detail::normalize_sql_to(sql, folder);
+  return out.hash;
+}
+
+// Approximate payload size of a materialized row or value.
+template <typename T>
+inline uint64_t value_bytes(const T &value) {
+  using U = std::remove_cvref_t<T>;
+  if constexpr (iguana::optional_v<U>) {
+    return value.has_value() ? value_bytes(*value) : 0;
+  }
+  else if constexpr (std::is_arithmetic_v<U> || std::is_enum_v<U>) {
+    return sizeof(U);
+  }
+  else if constexpr (iguana::c_array_v<U>) {
+    return sizeof(U);
+  }
+  else if constexpr (requires { value.size(); }) {
+    return value.size();
+  }
+  else if constexpr (iguana::is_tuple<U>::value) {
+    uint64_t total = 0;
+    std::apply(
+        [&total](auto &...item) {
+          ((total += value_bytes(item)), ...);
+        },
+        value);
+    return total;
+  }
+  else if constexpr (iguana::ylt_refletable_v<U>) {
+    uint64_t total = 0;
+    ylt::reflection::for_each(value,
+                              [&total](auto &field, auto /*name*/,
+                                       auto /*index*/) {
+                                total += value_bytes(field);
+                              });
+    return total;
+  }
+  else {
+    return sizeof(U);
+  }
+}
+
+#ifdef ORMPP_ENABLE_TRACE
+namespace detail {
+// Replaced as a whole by set_query_tracer, a statement finishing meanwhile
+// calls the tracer it loaded, old or new, which its copy keeps alive.
+using shared_query_tracer = std::shared_ptr<const query_tracer>;
+
+#ifdef __cpp_lib_atomic_shared_ptr
+inline std::atomic<shared_query_tracer> &global_query_tracer() {
+  static std::atomic<shared_query_tracer> tracer;
+  return tracer;
+}
+
+inline shared_query_tracer load_query_tracer() {
+  return global_query_tracer().load(std::memory_order_acquire);
+}
+
+inline void store_query_tracer(shared_query_tracer tracer) {
+  global_query_tracer().store(std::move(tracer), std::memory_order_release);
+}
+#else
+inline shared_query_tracer &global_query_tracer() {
+  static shared_query_tracer tracer;
+  return tracer;
+}
+
+inline shared_query_tracer load_query_tracer() {
+  return std::atomic_load_explicit(&global_query_tracer(),
+                                   std::memory_order_acquire);
+}
+
+inline void store_query_tracer(shared_query_tracer tracer) {
+  std::atomic_store_explicit(&global_query_tracer(), std::move(tracer),
+                             std::memory_order_release);
+}
+#endif
+
+// Internal consumer of finished statements next to the user tracer, used by
+// query_stats so that both can be active at the same time.
+using query_trace_sink = void (*)(const query_trace &);
+
+inline std::atomic<query_trace_sink> &query_stats_sink() {
+  static std::atomic<query_trace_sink> sink{nullptr};
+  return sink;
+}
+
+inline std::atomic<bool> &query_tracer_enabled() {
+  static std::atomic<bool> enabled{false};
+  return enabled;
+}
+
+// Called after the tracer or the sink changed. The recompute is serialized,
+// so the last one sees every change made before it and a stale result can
+// not be stored after a fresh one.
+inline void refresh_query_tracer_enabled() {
+  static std::mutex mtx;
+  std::scoped_lock lock(mtx);
+  query_tracer_enabled().store(
+      load_query_tracer() != nullptr ||
+          query_stats_sink().load(std::memory_order_acquire) != nullptr,
+      std::memory_order_release);
+}
+}  // namespace detail
+
+// May be called while statements are in flight, each of them reports to
+// the tracer installed when it finished. Pass nullptr to turn tracing off
+// again.
+inline void set_query_tracer(query_tracer tracer) {
+  detail::shared_query_tracer installed;
+  if (tracer) {
+    installed = std::make_shared<const query_tracer>(std::move(tracer));
+  }
+  detail::store_query_tracer(std::move(installed));
+  detail::refresh_query_tracer_enabled();
+}
+
+// Times one statement and reports it to the tracer when it goes out of
+// scope. The backend marks the end of the prepare and execute phases, the
+// rest is attributed to fetching. Errors are either reported with fail() or
+// taken from the backend's error state at that point.
+class trace_scope {
+  using clock = std::chrono::steady_clock;
+
+ public:
+  trace_scope(DBType db_type, std::string_view sql)
+      : active_(
+            detail::query_tracer_enabled().load(std::memory_order_acquire)) {
+    if (active_) {
+      trace_.db_type = db_type;
+      trace_.sql = sql;
+      mark_ = clock::now();
+    }
+  }
+
+  trace_scope(DBType db_type, std::string_view sql, const db_error &error)
+      : trace_scope(db_type, sql) {
+    error_state_ = &error;
+  }
+
+  ~trace_scope() {
+    if (!active_) {
+      return;
+    }
+    auto now = clock::now();
+    if (stage_ == 0) {
+      trace_.prepare_time = now - mark_;
+    }
+    else if (stage_ == 1) {
+      trace_.execute_time = now - mark_;
+    }
+    else {
+      trace_.fetch_time = now - mark_;
+    }
+    trace_.fingerprint = sql_fingerprint(trace_.sql);
+    if (failed_) {
+      trace_.ok = false;
+      trace_.error = error_;
+    }
+    else if (error_state_ && *error_state_) {
+      trace_.ok = false;
+      trace_.error = error_state_->message;
+    }
+    if (auto tracer = detail::load_query_tracer()) {
+      (*tracer)(trace_);
+    }
+    auto sink = detail::query_stats_sink().load(std::memory_order_acquire);
+    if (sink) {
+      sink(trace_);
+    }
+  }
+
+  trace_scope(const trace_scope &) = delete;
+  trace_scope &operator=(const trace_scope &) = delete;
+
+  // Only the first call of each mark counts, so the marks can be placed in
+  // loops which execute the same statement many times.
+  void prepared() {
+    if (active_ && stage_ == 0) {
+      auto now = clock::now();
+      trace_.prepare_time = now - mark_;
+      mark_ = now;
+      stage_ = 1;
+    }
+  }
+
+  void executed() {
+    if (!active_ || stage_ == 2) {
+      return;
+    }
+    // statements which are not prepared report their whole round trip here
+    auto now = clock::now();
+    trace_.execute_time = now - mark_;
+    mark_ = now;
+    stage_ = 2;
+  }
+
+  void set_rows(uint64_t rows) {
+    if (active_) {
+      trace_.rows = rows;
+    }
+  }
+
+  template <typename Row>
+  void add_row(const Row &row) {
+    if (active_) {
+      ++trace_.rows;
+      trace_.bytes += value_bytes(row);
+    }
+  }
+
+  void add_bytes(uint64_t bytes) {
+    if (active_) {
+      trace_.bytes += bytes;
+    }
+  }
+
+  void fail(std::string_view error) {
+    if (active_) {
+      failed_ = true;
+      error_ = error;
+    }
+  }
+
+ private:
+  bool active_;
+  bool failed_ = false;
+  int stage_ = 0;
+  const db_error *error_state_ = nullptr;
+  std::string error_;
+  clock::time_point mark_;
+  query_trace trace_;
+};
+#else
+// Tracing is compiled out, see ORMPP_ENABLE_TRACE.
+inline void set_query_tracer(query_tracer) {}
+
+class trace_scope {
+ public:
+  trace_scope(DBType, std::string_view) {}
+  trace_scope(DBType, std::string_view, const db_error &) {}
+  void prepared() {}
+  void executed() {}
+  void set_rows(uint64_t) {}
+  template <typename Row>
+  void add_row(const Row &) {}
+  void add_bytes(uint64_t) {}
+  void fail(std::string_view) {}
+};
+#endif
+
+}  // namespace ormpp
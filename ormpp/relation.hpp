@@ -0,0 +1,180 @@
+#ifndef ORMPP_RELATION_HPP
+#define ORMPP_RELATION_HPP
+
+#include <algorithm>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "utility.hpp"
+
+// One-to-many relations loaded for a whole batch of parents:
+//
+//   struct customer_order {
+//     int id;
+//     std::string customer;
+//     std::vector<order_item> items;
+//   };
+//   YLT_REFL(customer_order, id, customer);  // items is not a column
+//   REGISTER_AUTO_KEY(customer_order, id);
+//   REGISTER_RELATION(customer_order, items, order_item::order_id);
+//
+//   auto orders = db.select(ormpp::all)
+//                     .from<customer_order>()
+//                     .with<&customer_order::items>()
+//                     .collect();
+//
+// The children of all parents come from one query per relation (and per
+// relation_batch_size parent keys),
+//   select ... from order_item where order_id in (<parent keys>)
+// and are put into their parents in memory, instead of one query per parent.
+// The parent key is the id member of the parent, a parent keyed by another
+// member names it with
+//   REGISTER_RELATION_KEYS(customer_order, items, customer_order::order_no,
+//                          order_item::order_no);
+// A parent without the key member does not compile.
+namespace ormpp {
+
+template <typename Parent, auto member>
+struct relation_tag {};
+
+// REGISTER_RELATION declares ormpp_relation_key next to the parent, where
+// argument dependent lookup finds it.
+template <typename Parent, auto member>
+concept has_relation = requires {
+  ormpp_relation_key(relation_tag<Parent, member>{});
+};
+
+#define REGISTER_RELATION_KEYS(PARENT, FIELD, PARENT_KEY, CHILD_KEY) \
+  inline constexpr auto ormpp_relation_key(                          \
+      ormpp::relation_tag<PARENT, &PARENT::FIELD>) {                 \
+    return std::make_pair(&PARENT_KEY, &CHILD_KEY);                  \
+  }
+
+#define REGISTER_RELATION(PARENT, FIELD, CHILD_KEY) \
+  REGISTER_RELATION_KEYS(PARENT, FIELD, PARENT::id, CHILD_KEY)
+
+// parent keys per query, bounds the length of the in (...) list
+inline constexpr size_t relation_batch_size = 1000;
+
+namespace detail::relations {
+
+// the value of an optional key, nullptr when it is empty
+template <typename K, typename F>
+const K *key_of(const F &field) {
+  if constexpr (is_optional_v<F>::value) {
+    return field.has_value() ? &*field : nullptr;
+  }
+  else {
+    return &field;
+  }
+}
+
+template <typename F>
+struct key_value {
+  using type = F;
+};
+
+template <typename F>
+struct key_value<std::optional<F>> {
+  using type = F;
+};
+
+}  // namespace detail::relations
+
+// Fills parent.*member for every parent, with one query per
+// relation_batch_size distinct keys. false if a query failed, the parents
+// are then left without children.
+template <auto member, typename DB, typename T>
+bool load_relation(DB db, std::vector<T> &parents) {
+  static_assert(has_relation<T, member>,
+                "register the relation with REGISTER_RELATION");
+  using children_t =
+      ylt::reflection::remove_cvref_t<decltype(std::declval<T &>().*member)>;
+  using C = typename children_t::value_type;
+  constexpr auto relation_keys = ormpp_relation_key(relation_tag<T, member>{});
+  constexpr auto parent_key = relation_keys.first;
+  constexpr auto foreign_key = relation_keys.second;
+  using F = ylt::reflection::remove_cvref_t<
+      decltype(std::declval<C &>().*foreign_key)>;
+  using K = typename detail::relations::key_value<F>::type;
+  using P = ylt::reflection::remove_cvref_t<
+      decltype(std::declval<T &>().*parent_key)>;
+  using PK = typename detail::relations::key_value<P>::type;
+  static_assert(std::is_convertible_v<const PK &, K>,
+                "the parent key does not convert to the child key");
+
+  // parents sharing a key all get the children
+  std::unordered_map<K, std::vector<size_t>> by_key;
+  std::vector<std::string> key_lists;
+  size_t in_list = relation_batch_size;
+  for (size_t i = 0; i < parents.size(); ++i) {
+    (parents[i].*member).clear();
+    auto *value = detail::relations::key_of<PK>(parents[i].*parent_key);
+    if (value == nullptr) {
+      continue;
+    }
+    auto [it, added] = by_key.try_emplace(K(*value));
+    if (added) {
+      if (in_list == relation_batch_size) {
+        key_lists.emplace_back();
+        in_list = 0;
+      }
+      auto &keys = key_lists.back();
+      if (in_list++ != 0) {
+        keys.append(",");
+      }
+      keys.append(to_str(it->first));
+    }
+    it->second.push_back(i);
+  }
+
+  auto names = ylt::reflection::get_member_names<C>();
+  std::string_view column = names[ylt::reflection::index_of<foreign_key>()];
+  std::vector<C> children;
+  for (auto &keys : key_lists) {
+    std::string where(column);
+    where.append(" in (").append(keys).append(")");
+    auto part = db->template query_s<C>(where);
+    if (db->has_error()) {
+      return false;
+    }
+    if (children.empty()) {
+      children = std::move(part);
+    }
+    else {
+      std::move(part.begin(), part.end(), std::back_inserter(children));
+    }
+  }
+
+  for (auto &child : children) {
+    auto *key = detail::relations::key_of<K>(child.*foreign_key);
+    if (key == nullptr) {
+      continue;
+    }
+    auto it = by_key.find(*key);
+    if (it == by_key.end()) {
+      continue;
+    }
+    auto &owners = it->second;
+    for (size_t j = 0; j + 1 < owners.size(); ++j) {
+      (parents[owners[j]].*member).push_back(child);
+    }
+    (parents[owners.back()].*member).push_back(std::move(child));
+  }
+  return true;
+}
+
+template <auto... members, typename DB, typename T>
+bool load_relations(DB db, std::vector<T> &parents) {
+  return (load_relation<members>(db, parents) && ...);
+}
+
+}  // namespace ormpp
+
+#endif  // ORMPP_RELATION_HPP
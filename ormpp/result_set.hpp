@@ -0,0 +1,120 @@
+#ifndef ORMPP_RESULT_SET_HPP
+#define ORMPP_RESULT_SET_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Results whose std::string_view and std::span<const char> fields point into
+// memory owned by the result instead of a buffer shared by all rows:
+//
+//   auto people = db.query_view<person_view>("age > ?", 20);
+//   for (auto &p : people) {
+//     lookup(p.name);  // valid as long as people is
+//   }
+//
+// The text is copied once into a chunked arena, so decoding a row does no
+// allocation per field. Moving the result keeps the views valid.
+namespace ormpp {
+
+// Read-only view of a blob column, only valid in query_view results.
+using blob_view = std::span<const char>;
+
+template <typename T>
+inline constexpr bool is_blob_view_v = std::is_same_v<T, blob_view>;
+
+class string_arena {
+ public:
+  explicit string_arena(size_t chunk_size = 64 * 1024)
+      : chunk_size_(chunk_size) {}
+
+  // the moved-from arena must not hand out the chunks it gave away
+  string_arena(string_arena &&other) noexcept
+      : chunk_size_(other.chunk_size_),
+        chunks_(std::move(other.chunks_)),
+        pos_(std::exchange(other.pos_, nullptr)),
+        left_(std::exchange(other.left_, 0)) {}
+
+  string_arena &operator=(string_arena &&other) noexcept {
+    chunk_size_ = other.chunk_size_;
+    chunks_ = std::move(other.chunks_);
+    pos_ = std::exchange(other.pos_, nullptr);
+    left_ = std::exchange(other.left_, 0);
+    return *this;
+  }
+
+  std::string_view store(const char *data, size_t size) {
+    if (size == 0) {
+      return {};
+    }
+    if (size > left_) {
+      // values bigger than a chunk get a chunk of their own
+      size_t n = (std::max)(size, chunk_size_);
+      chunks_.push_back(std::make_unique<char[]>(n));
+      pos_ = chunks_.back().get();
+      left_ = n;
+    }
+    std::memcpy(pos_, data, size);
+    std::string_view str(pos_, size);
+    pos_ += size;
+    left_ -= size;
+    return str;
+  }
+
+  std::string_view store(std::string_view str) {
+    return store(str.data(), str.size());
+  }
+
+  size_t chunk_count() const { return chunks_.size(); }
+
+ private:
+  size_t chunk_size_;
+  std::vector<std::unique_ptr<char[]>> chunks_;
+  char *pos_ = nullptr;
+  size_t left_ = 0;
+};
+
+// Where a backend puts the text of a view field: the arena of a query_view
+// call, otherwise the connection's single buffer, as query_s always did.
+inline std::string_view hold_result_text(string_arena *arena,
+                                         std::string &buffer, const char *data,
+                                         size_t size) {
+  if (arena) {
+    return arena->store(data, size);
+  }
+  buffer.assign(data, size);
+  return buffer;
+}
+
+template <typename T>
+class result_set {
+ public:
+  using value_type = T;
+  using const_iterator = typename std::vector<T>::const_iterator;
+
+  result_set() = default;
+  result_set(std::vector<T> rows, string_arena arena)
+      : rows_(std::move(rows)), arena_(std::move(arena)) {}
+
+  const_iterator begin() const { return rows_.begin(); }
+  const_iterator end() const { return rows_.end(); }
+  size_t size() const { return rows_.size(); }
+  bool empty() const { return rows_.empty(); }
+  const T &operator[](size_t i) const { return rows_[i]; }
+  const T &front() const { return rows_.front(); }
+  const std::vector<T> &rows() const { return rows_; }
+
+ private:
+  std::vector<T> rows_;
+  string_arena arena_;
+};
+
+}  // namespace ormpp
+
+#endif  // ORMPP_RESULT_SET_HPP
@@ -0,0 +1,295 @@
+#ifndef ORMPP_SESSION_HPP
+#define ORMPP_SESSION_HPP
+
+#include <climits>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "utility.hpp"
+
+// A unit of work over one connection:
+//
+//   auto s = db.session();
+//   for (person *p : s.query<person>("age > ?", 20)) {
+//     p->age += 1;
+//   }
+//   s.flush();
+//
+// Rows read through the session are tracked by their conflict key
+// (REGISTER_CONFLICT_KEY, or REGISTER_AUTO_KEY) together with a snapshot of
+// what was read, and reading a tracked row again returns the same object.
+// flush() compares every row with its snapshot and sends one prepared
+// "update t set <changed columns> where <key>" per table and set of changed
+// columns, run for all rows of that group, inside one transaction. Rows that
+// did not change cost nothing.
+namespace ormpp {
+
+template <typename DB>
+class session {
+ public:
+  explicit session(DB &db) : db_(db) {}
+  session(const session &) = delete;
+  session &operator=(const session &) = delete;
+
+  // The rows matching the condition, as query_s takes it. A row which is
+  // already tracked is returned as the session holds it, not as read again.
+  // Nothing is read, and the error is set, for a struct whose rows can not
+  // be told apart, see tracked_table::keyed.
+  template <typename T, typename... Args>
+  std::vector<T *> query(const std::string &str = "", Args &&...args) {
+    if (!check_keyed<T>()) {
+      return {};
+    }
+    auto rows = db_.template query_s<T>(str, std::forward<Args>(args)...);
+    std::vector<T *> tracked;
+    tracked.reserve(rows.size());
+    auto &tb = table<T>();
+    for (auto &row : rows) {
+      tracked.push_back(tb.track(std::move(row)));
+    }
+    return tracked;
+  }
+
+  // Tracks a row read without the session, row is taken as the database
+  // state. nullptr if the struct has no usable key, as for query.
+  template <typename T>
+  T *attach(T row) {
+    if (!check_keyed<T>()) {
+      return nullptr;
+    }
+    return table<T>().track(std::move(row));
+  }
+
+  // number of tracked rows
+  size_t size() const {
+    size_t n = 0;
+    for (auto &tb : tables_) {
+      n += tb->size();
+    }
+    return n;
+  }
+
+  // Returns the number of rows updated, INT_MIN on error. After an error the
+  // transaction is rolled back and the rows stay dirty.
+  int flush() {
+    size_t dirty = 0;
+    for (auto &tb : tables_) {
+      if (!tb->collect(dirty)) {
+        db_.set_last_error("a tracked row changed its conflict key",
+                           db_errc::invalid_argument);
+        return INT_MIN;
+      }
+    }
+    if (dirty == 0) {
+      return 0;
+    }
+
+    if (!db_.begin()) {
+      return INT_MIN;
+    }
+    int rows = 0;
+    for (auto &tb : tables_) {
+      int n = tb->execute(db_);
+      if (n == INT_MIN) {
+        // keep the error of the failed statement
+        auto error = db_.get_error();
+        db_.rollback();
+        db_.set_last_error(error.message, error.code);
+        return INT_MIN;
+      }
+      rows += n;
+    }
+    if (!db_.commit()) {
+      return INT_MIN;
+    }
+    for (auto &tb : tables_) {
+      tb->flushed();
+    }
+    return rows;
+  }
+
+  // forgets all tracked rows, pointers to them dangle afterwards
+  void clear() {
+    tables_.clear();
+    by_type_.clear();
+  }
+
+ private:
+  struct table_base {
+    virtual ~table_base() = default;
+    virtual size_t size() const = 0;
+    // Groups the dirty rows by their changed columns and adds their number
+    // to dirty, false if a row changed its key.
+    virtual bool collect(size_t &dirty) = 0;
+    virtual int execute(DB &db) = 0;
+    // the grouped rows were written, they become their own snapshot
+    virtual void flushed() = 0;
+  };
+
+  template <typename T>
+  class tracked_table : public table_base {
+    struct entry {
+      T row;
+      T snapshot;
+    };
+
+   public:
+    // Rows are told apart by their conflict key members, which must exist
+    // and hold strings or plain values; a blob key would give every row the
+    // same identity.
+    static bool keyed() {
+      static const bool ok = [] {
+        uint64_t keys = conflict_key_columns<T>();
+        using refs_t =
+            decltype(ylt::reflection::object_to_tuple(std::declval<T &>()));
+        return keys != 0 && [keys]<size_t... Is>(std::index_sequence<Is...>) {
+          return ((!(keys >> Is & 1) ||
+                   key_type<ylt::reflection::remove_cvref_t<
+                       std::tuple_element_t<Is, refs_t>>>()) &&
+                  ...);
+        }(std::make_index_sequence<std::tuple_size_v<refs_t>>{});
+      }();
+      return ok;
+    }
+
+    T *track(T row) {
+      auto key = row_key(row);
+      auto it = by_key_.find(key);
+      if (it != by_key_.end()) {
+        return &it->second->row;
+      }
+      auto &e = entries_.emplace_back(new entry{row, std::move(row)});
+      by_key_.emplace(std::move(key), e.get());
+      return &e->row;
+    }
+
+    size_t size() const override { return entries_.size(); }
+
+    bool collect(size_t &dirty) override {
+      groups_.clear();
+      uint64_t keys = conflict_key_columns<T>();
+      for (auto &e : entries_) {
+        uint64_t columns = differing_columns(e->snapshot, e->row);
+        if (columns & keys) {
+          groups_.clear();
+          return false;
+        }
+        if (columns != 0) {
+          groups_[columns].push_back(e.get());
+          ++dirty;
+        }
+      }
+      return true;
+    }
+
+    int execute(DB &db) override {
+      int rows = 0;
+      std::vector<T> batch;
+      for (auto &[columns, group] : groups_) {
+        batch.clear();
+        for (auto *e : group) {
+          batch.push_back(e->row);
+        }
+        int n = db.template update_columns<T>(batch, columns);
+        if (n == INT_MIN) {
+          return INT_MIN;
+        }
+        rows += n;
+      }
+      return rows;
+    }
+
+    void flushed() override {
+      for (auto &[columns, group] : groups_) {
+        for (auto *e : group) {
+          e->snapshot = e->row;
+        }
+      }
+      groups_.clear();
+    }
+
+   private:
+    // the conflict key columns as bytes, one entry per key in the session
+    static std::string row_key(const T &row) {
+      uint64_t keys = conflict_key_columns<T>();
+      std::string key;
+      ylt::reflection::for_each(row, [&key, keys](auto &field, auto /*name*/,
+                                                  size_t index) {
+        if (keys >> index & 1) {
+          append_key(key, field);
+          key.push_back('\0');
+        }
+      });
+      return key;
+    }
+
+    template <typename U>
+    static constexpr bool key_type() {
+      if constexpr (is_optional_v<U>::value) {
+        return key_type<typename U::value_type>();
+      }
+      else {
+        return std::is_convertible_v<const U &, std::string_view> ||
+               std::is_trivially_copyable_v<U>;
+      }
+    }
+
+    // only called for the types key_type accepts
+    template <typename U>
+    static void append_key(std::string &key, const U &value) {
+      if constexpr (is_optional_v<U>::value) {
+        key.push_back(value.has_value() ? '1' : '0');
+        if (value.has_value()) {
+          append_key(key, *value);
+        }
+      }
+      else if constexpr (std::is_convertible_v<const U &, std::string_view>) {
+        key.append(std::string_view(value));
+      }
+      else if constexpr (std::is_trivially_copyable_v<U>) {
+        key.append(reinterpret_cast<const char *>(&value), sizeof(U));
+      }
+    }
+
+    std::vector<std::unique_ptr<entry>> entries_;
+    std::unordered_map<std::string, entry *> by_key_;
+    std::map<uint64_t, std::vector<entry *>> groups_;
+  };
+
+  template <typename T>
+  bool check_keyed() {
+    if (tracked_table<T>::keyed()) {
+      return true;
+    }
+    db_.set_last_error(
+        "session needs a conflict key of strings or plain values for " +
+            std::string(get_short_struct_name<T>()),
+        db_errc::invalid_argument);
+    return false;
+  }
+
+  template <typename T>
+  tracked_table<T> &table() {
+    auto [it, added] = by_type_.try_emplace(type_key_of<T>(), nullptr);
+    if (added) {
+      it->second = tables_.emplace_back(new tracked_table<T>()).get();
+    }
+    return static_cast<tracked_table<T> &>(*it->second);
+  }
+
+  DB &db_;
+  // in the order the tables were first read, flush keeps it
+  std::vector<std::unique_ptr<table_base>> tables_;
+  std::unordered_map<type_key, table_base *> by_type_;
+};
+
+}  // namespace ormpp
+
+#endif  // ORMPP_SESSION_HPP
@@ -0,0 +1,183 @@
+#ifndef ORMPP_SHARDED_ASYNC_CONNECTION_POOL_HPP
+#define ORMPP_SHARDED_ASYNC_CONNECTION_POOL_HPP
+
+#include <asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "async_connection_pool.hpp"
+
+namespace ormpp {
+
+// Connection pool for a set of io_contexts each run by its own thread, like
+// coro_io's io_context pool. Every executor owns a sub-pool whose
+// connections are bound to it, a caller checks out from the sub-pool of the
+// executor it runs on and never leaves its thread. Only when that sub-pool
+// has no idle connection are the siblings tried, in order, before waiting on
+// the own one. Connections always return to the sub-pool which created them.
+template <typename DB>
+  requires is_async_db_v<DB>
+class sharded_async_connection_pool {
+ public:
+  using executor_type = asio::any_io_executor;
+  template <typename T>
+  using awaitable = asio::awaitable<T, executor_type>;
+  using shard_type = async_connection_pool<DB>;
+
+  explicit sharded_async_connection_pool(std::vector<executor_type> executors,
+                                         pool_options options = {}) {
+    if (executors.empty()) {
+      throw std::invalid_argument(
+          "sharded_async_connection_pool: no executor given");
+    }
+    shards_.reserve(executors.size());
+    for (auto& executor : executors) {
+      auto pool = std::make_shared<shard_type>(executor, options);
+      shards_.push_back(shard{std::move(executor), std::move(pool)});
+    }
+  }
+
+  sharded_async_connection_pool(const sharded_async_connection_pool&) = delete;
+  sharded_async_connection_pool& operator=(
+      const sharded_async_connection_pool&) = delete;
+
+  size_t shard_count() const { return shards_.size(); }
+
+  // Sub-pool bound to executors[index]
+  shard_type& shard_at(size_t index) { return *shards_.at(index).pool; }
+
+  // Initialize every sub-pool with pool_size_per_shard connections, each
+  // sub-pool connects on its own executor.
+  awaitable<bool> init(size_t pool_size_per_shard, const std::string& host,
+                       const std::string& user = "",
+                       const std::string& passwd = "",
+                       const std::string& db = "",
+                       const std::optional<int>& timeout = {},
+                       const std::optional<int>& port = {}) {
+    bool ok = true;
+    for (auto& s : shards_) {
+      auto op = asio::co_spawn(
+          s.executor,
+          s.pool->init(pool_size_per_shard, host, user, passwd, db, timeout,
+                       port),
+          asio::use_awaitable);
+      ok = co_await std::move(op) && ok;
+    }
+    co_return ok;
+  }
+
+  // Get a connection, from the caller's own sub-pool when it has an idle one,
+  // stolen from a sibling otherwise. When all are busy, waits on the own
+  // sub-pool up to timeout (dynamic expansion included).
+  awaitable<std::shared_ptr<DB>> get(
+      std::chrono::seconds timeout = std::chrono::seconds(10)) {
+    auto caller = co_await asio::this_coro::executor;
+    size_t home = home_shard(caller);
+
+    auto connection = co_await try_get_from(home, caller);
+    if (connection) {
+      co_return connection;
+    }
+    for (size_t i = 1; i < shards_.size(); ++i) {
+      connection = co_await try_get_from((home + i) % shards_.size(), caller);
+      if (connection) {
+        steal_count_.fetch_add(1, std::memory_order_relaxed);
+        co_return connection;
+      }
+    }
+
+    auto& s = shards_[home];
+    if (s.executor == caller) {
+      co_return co_await s.pool->get(timeout);
+    }
+    auto op =
+        asio::co_spawn(s.executor, s.pool->get(timeout), asio::use_awaitable);
+    co_return co_await std::move(op);
+  }
+
+  // Get a connection as get() does and start a transaction pinned to it
+  awaitable<async_transaction<DB>> transaction(
+      std::chrono::seconds timeout = std::chrono::seconds(10)) {
+    auto connection = co_await get(timeout);
+    auto op = async_transaction<DB>::begin(std::move(connection));
+    co_return co_await std::move(op);
+  }
+
+  // Sum of the sub-pool statistics
+  // Returns: (pool_size, available, in_use, dynamic_count)
+  awaitable<std::tuple<size_t, size_t, size_t, size_t>> get_stats() {
+    std::tuple<size_t, size_t, size_t, size_t> total{};
+    for (auto& s : shards_) {
+      auto op = asio::co_spawn(s.executor, s.pool->get_stats(),
+                               asio::use_awaitable);
+      auto stats = co_await std::move(op);
+      std::get<0>(total) += std::get<0>(stats);
+      std::get<1>(total) += std::get<1>(stats);
+      std::get<2>(total) += std::get<2>(stats);
+      std::get<3>(total) += std::get<3>(stats);
+    }
+    co_return total;
+  }
+
+  // Number of checkouts served by a sibling sub-pool
+  size_t steal_count() const {
+    return steal_count_.load(std::memory_order_relaxed);
+  }
+
+  awaitable<void> close_all(
+      bool wait_for_return = false,
+      std::chrono::seconds max_wait = std::chrono::seconds(30)) {
+    for (auto& s : shards_) {
+      auto op = asio::co_spawn(s.executor,
+                               s.pool->close_all(wait_for_return, max_wait),
+                               asio::use_awaitable);
+      co_await std::move(op);
+    }
+  }
+
+ private:
+  struct shard {
+    executor_type executor;
+    std::shared_ptr<shard_type> pool;
+  };
+
+  size_t home_shard(const executor_type& caller) {
+    for (size_t i = 0; i < shards_.size(); ++i) {
+      if (shards_[i].executor == caller) {
+        return i;
+      }
+    }
+    // called from an executor outside the pool, spread the load
+    return next_shard_.fetch_add(1, std::memory_order_relaxed) %
+           shards_.size();
+  }
+
+  // The sub-pool is only touched on its own executor, a foreign one costs a
+  // hop there and back.
+  awaitable<std::shared_ptr<DB>> try_get_from(size_t index,
+                                              const executor_type& caller) {
+    auto& s = shards_[index];
+    if (s.executor == caller) {
+      co_return co_await s.pool->try_get();
+    }
+    auto op =
+        asio::co_spawn(s.executor, s.pool->try_get(), asio::use_awaitable);
+    co_return co_await std::move(op);
+  }
+
+  std::vector<shard> shards_;
+  std::atomic<size_t> next_shard_ = 0;
+  std::atomic<size_t> steal_count_ = 0;
+};
+
+}  // namespace ormpp
+
+#endif  // ORMPP_SHARDED_ASYNC_CONNECTION_POOL_HPP
@@ -0,0 +1,347 @@
+#ifndef ORMPP_SQL_TYPES_HPP
+#define ORMPP_SQL_TYPES_HPP
+
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Timestamps, dates and exact decimals as plain members:
+//
+//   struct order {
+//     int id;
+//     std::chrono::system_clock::time_point created;
+//     std::chrono::year_month_day due;
+//     ormpp::decimal<2> amount;
+//   };
+//
+// A time_point of the system clock is a UTC timestamp with microsecond
+// precision: DATETIME(6) in mysql, timestamp in postgresql, microseconds since
+// the epoch in a sqlite INTEGER. A year_month_day is a DATE, or days since the
+// epoch in sqlite. decimal<Scale> keeps the unscaled value in an int64_t,
+// DECIMAL(18,Scale) in mysql and postgresql and the unscaled INTEGER in
+// sqlite, so values compare and sum exactly.
+namespace ormpp {
+
+template <typename T>
+struct is_sys_time : std::false_type {};
+
+template <typename Duration>
+struct is_sys_time<std::chrono::time_point<std::chrono::system_clock, Duration>>
+    : std::true_type {};
+
+template <typename T>
+inline constexpr bool is_sys_time_v = is_sys_time<T>::value;
+
+template <typename T>
+inline constexpr bool is_sql_date_v =
+    std::is_same_v<T, std::chrono::year_month_day>;
+
+// what a timestamp column holds
+using sql_timestamp = std::chrono::sys_time<std::chrono::microseconds>;
+
+namespace detail::sql_types {
+
+inline constexpr int64_t pow10(int n) {
+  int64_t v = 1;
+  for (int i = 0; i < n; ++i) {
+    v *= 10;
+  }
+  return v;
+}
+
+// The text forms below have fixed positions, so they are read and written
+// digit by digit instead of going through a stream or strptime.
+inline bool parse_digits(const char *p, int n, int &out) {
+  int v = 0;
+  for (int i = 0; i < n; ++i) {
+    unsigned d = (unsigned char)p[i] - '0';
+    if (d > 9) {
+      return false;
+    }
+    v = v * 10 + (int)d;
+  }
+  out = v;
+  return true;
+}
+
+inline char *write_digits(char *out, unsigned v, int n) {
+  for (int i = n - 1; i >= 0; --i) {
+    out[i] = char('0' + v % 10);
+    v /= 10;
+  }
+  return out + n;
+}
+
+// YYYY-MM-DD
+inline bool parse_date(std::string_view str, std::chrono::year_month_day &ymd) {
+  int y, m, d;
+  if (str.size() < 10 || str[4] != '-' || str[7] != '-' ||
+      !parse_digits(str.data(), 4, y) || !parse_digits(str.data() + 5, 2, m) ||
+      !parse_digits(str.data() + 8, 2, d)) {
+    return false;
+  }
+  ymd = std::chrono::year_month_day{std::chrono::year{y},
+                                    std::chrono::month{(unsigned)m},
+                                    std::chrono::day{(unsigned)d}};
+  return ymd.ok();
+}
+
+// YYYY-MM-DD HH:MM:SS with an optional fraction, a 'T' is accepted for the
+// space. Digits after the sixth of the fraction are dropped.
+inline bool parse_timestamp(std::string_view str, sql_timestamp &tp) {
+  std::chrono::year_month_day ymd;
+  int h, mi, s;
+  if (str.size() < 19 || !parse_date(str, ymd) ||
+      (str[10] != ' ' && str[10] != 'T') || str[13] != ':' ||
+      str[16] != ':' || !parse_digits(str.data() + 11, 2, h) ||
+      !parse_digits(str.data() + 14, 2, mi) ||
+      !parse_digits(str.data() + 17, 2, s)) {
+    return false;
+  }
+  int64_t us = 0;
+  if (str.size() > 20 && str[19] == '.') {
+    int n = 0;
+    for (size_t i = 20; i < str.size() && n < 6; ++i, ++n) {
+      unsigned d = (unsigned char)str[i] - '0';
+      if (d > 9) {
+        break;
+      }
+      us = us * 10 + d;
+    }
+    us *= pow10(6 - n);
+  }
+  tp = std::chrono::sys_days(ymd) + std::chrono::hours(h) +
+       std::chrono::minutes(mi) + std::chrono::seconds(s) +
+       std::chrono::microseconds(us);
+  return true;
+}
+
+inline constexpr size_t date_size = 10;
+inline constexpr size_t timestamp_size = 26;
+
+// writes date_size chars
+inline char *format_date(char *out, std::chrono::year_month_day ymd) {
+  out = write_digits(out, (unsigned)(int)ymd.year(), 4);
+  *out++ = '-';
+  out = write_digits(out, (unsigned)ymd.month(), 2);
+  *out++ = '-';
+  return write_digits(out, (unsigned)ymd.day(), 2);
+}
+
+// writes timestamp_size chars, YYYY-MM-DD HH:MM:SS.ffffff
+inline char *format_timestamp(char *out, sql_timestamp tp) {
+  auto days = std::chrono::floor<std::chrono::days>(tp);
+  std::chrono::hh_mm_ss<std::chrono::microseconds> time(tp - days);
+  out = format_date(out, std::chrono::year_month_day(days));
+  *out++ = ' ';
+  out = write_digits(out, (unsigned)time.hours().count(), 2);
+  *out++ = ':';
+  out = write_digits(out, (unsigned)time.minutes().count(), 2);
+  *out++ = ':';
+  out = write_digits(out, (unsigned)time.seconds().count(), 2);
+  *out++ = '.';
+  return write_digits(out, (unsigned)time.subseconds().count(), 6);
+}
+
+// An optional sign, digits and an optional fraction. The fraction is cut to
+// scale digits, at most 18 significant digits fit.
+inline bool parse_decimal(std::string_view str, int scale, int64_t &value) {
+  const char *p = str.data();
+  const char *end = p + str.size();
+  bool neg = p != end && *p == '-';
+  if (p != end && (*p == '-' || *p == '+')) {
+    ++p;
+  }
+  uint64_t v = 0;
+  int digits = 0;
+  bool any = false;
+  for (; p != end && unsigned(*p - '0') <= 9; ++p) {
+    any = true;
+    if (v != 0 || *p != '0') {
+      ++digits;
+    }
+    v = v * 10 + unsigned(*p - '0');
+  }
+  int frac = 0;
+  if (p != end && *p == '.') {
+    for (++p; p != end && unsigned(*p - '0') <= 9; ++p) {
+      any = true;
+      if (frac < scale) {
+        v = v * 10 + unsigned(*p - '0');
+        ++frac;
+      }
+    }
+  }
+  if (!any || p != end || digits + scale > 18) {
+    return false;
+  }
+  v *= (uint64_t)pow10(scale - frac);
+  value = neg ? -(int64_t)v : (int64_t)v;
+  return true;
+}
+
+// writes at most 21 chars
+inline char *format_decimal(char *out, int64_t value, int scale) {
+  uint64_t mag = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+  uint64_t factor = (uint64_t)pow10(scale);
+  if (value < 0) {
+    *out++ = '-';
+  }
+  out = std::to_chars(out, out + 20, mag / factor).ptr;
+  if (scale > 0) {
+    *out++ = '.';
+    uint64_t frac = mag % factor;
+    for (int i = scale - 1; i >= 0; --i) {
+      out[i] = char('0' + frac % 10);
+      frac /= 10;
+    }
+    out += scale;
+  }
+  return out;
+}
+
+}  // namespace detail::sql_types
+
+template <int Scale>
+class decimal {
+  static_assert(Scale >= 0 && Scale <= 18, "decimal scale is 0 to 18");
+
+ public:
+  static constexpr int scale = Scale;
+
+  constexpr decimal() = default;
+
+  // from_unscaled(1234) is 12.34 for a decimal<2>
+  static constexpr decimal from_unscaled(int64_t value) {
+    decimal d;
+    d.value_ = value;
+    return d;
+  }
+
+  static std::optional<decimal> parse(std::string_view str) {
+    int64_t value;
+    if (!detail::sql_types::parse_decimal(str, Scale, value)) {
+      return std::nullopt;
+    }
+    return from_unscaled(value);
+  }
+
+  constexpr int64_t unscaled() const { return value_; }
+
+  double to_double() const {
+    return (double)value_ / (double)detail::sql_types::pow10(Scale);
+  }
+
+  std::string to_string() const {
+    char buf[24];
+    auto end = detail::sql_types::format_decimal(buf, value_, Scale);
+    return std::string(buf, end);
+  }
+
+  friend constexpr decimal operator+(decimal a, decimal b) {
+    return from_unscaled(a.value_ + b.value_);
+  }
+
+  friend constexpr decimal operator-(decimal a, decimal b) {
+    return from_unscaled(a.value_ - b.value_);
+  }
+
+  friend constexpr auto operator<=>(const decimal &,
+                                    const decimal &) = default;
+
+ private:
+  int64_t value_ = 0;
+};
+
+template <typename T>
+struct is_decimal : std::false_type {};
+
+template <int Scale>
+struct is_decimal<decimal<Scale>> : std::true_type {};
+
+template <typename T>
+inline constexpr bool is_decimal_v = is_decimal<T>::value;
+
+// The integer sqlite stores, and its inverse.
+template <typename T>
+int64_t to_sql_integer(const T &value) {
+  if constexpr (is_sys_time_v<T>) {
+    return std::chrono::floor<std::chrono::microseconds>(value)
+        .time_since_epoch()
+        .count();
+  }
+  else if constexpr (is_sql_date_v<T>) {
+    return std::chrono::sys_days(value).time_since_epoch().count();
+  }
+  else {
+    return value.unscaled();
+  }
+}
+
+template <typename T>
+T from_sql_integer(int64_t value) {
+  if constexpr (is_sys_time_v<T>) {
+    return std::chrono::time_point_cast<typename T::duration>(
+        sql_timestamp(std::chrono::microseconds(value)));
+  }
+  else if constexpr (is_sql_date_v<T>) {
+    return std::chrono::year_month_day(
+        std::chrono::sys_days(std::chrono::days(value)));
+  }
+  else {
+    return T::from_unscaled(value);
+  }
+}
+
+// The text mysql and postgresql read and write, appended to out.
+template <typename T>
+void append_sql_text(std::string &out, const T &value) {
+  char buf[32];
+  char *end;
+  if constexpr (is_sys_time_v<T>) {
+    end = detail::sql_types::format_timestamp(
+        buf, std::chrono::floor<std::chrono::microseconds>(value));
+  }
+  else if constexpr (is_sql_date_v<T>) {
+    end = detail::sql_types::format_date(buf, value);
+  }
+  else {
+    end = detail::sql_types::format_decimal(buf, value.unscaled(), T::scale);
+  }
+  out.append(buf, end);
+}
+
+template <typename T>
+bool parse_sql_text(std::string_view str, T &value) {
+  if constexpr (is_sys_time_v<T>) {
+    sql_timestamp tp;
+    if (!detail::sql_types::parse_timestamp(str, tp)) {
+      return false;
+    }
+    value = std::chrono::time_point_cast<typename T::duration>(tp);
+    return true;
+  }
+  else if constexpr (is_sql_date_v<T>) {
+    return detail::sql_types::parse_date(str, value);
+  }
+  else {
+    int64_t v;
+    if (!detail::sql_types::parse_decimal(str, T::scale, v)) {
+      return false;
+    }
+    value = T::from_unscaled(v);
+    return true;
+  }
+}
+
+template <typename T>
+inline constexpr bool is_sql_value_type_v =
+    is_sys_time_v<T> || is_sql_date_v<T> || is_decimal_v<T>;
+
+}  // namespace ormpp
+
+#endif  // ORMPP_SQL_TYPES_HPP
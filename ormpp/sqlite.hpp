@@ -6,11 +6,17 @@
 
 #include <sqlite3.h>
 
+#include <algorithm>
 #include <climits>
+#include <map>
 #include <string>
 #include <vector>
 
+#include "column_set.hpp"
+#include "db_error.hpp"
 #include "query.hpp"
+#include "query_trace.hpp"
+#include "result_set.hpp"
 
 namespace ormpp {
 class sqlite {
@@ -19,20 +25,23 @@ class sqlite {
 
   ~sqlite() { disconnect(); }
 
-  bool has_error() const { return has_error_; }
+  bool has_error() const { return static_cast<bool>(error_); }
 
-  static void reset_error() {
-    has_error_ = false;
-    last_error_ = {};
-  }
+  void reset_error() { error_.clear(); }
+
+  // string_view and blob_view fields of the following results are stored
+  // here, see dbng::query_view
+  void set_result_arena(string_arena *arena) { arena_ = arena; }
 
-  static void set_last_error(std::string last_error) {
-    has_error_ = true;
-    last_error_ = std::move(last_error);
-    std::cout << last_error_ << std::endl;  // todo, write to log file
+  void set_last_error(std::string last_error,
+                      db_errc code = db_errc::unknown) {
+    error_.assign(code, std::move(last_error));
+    std::cout << error_.message << std::endl;  // todo, write to log file
   }
 
-  std::string get_last_error() const { return last_error_; }
+  std::string get_last_error() const { return error_.message; }
+
+  const db_error &get_error() const { return error_; }
 
   bool connect(
       const std::tuple<std::string, std::string, std::string, std::string,
@@ -40,7 +49,7 @@ class sqlite {
     reset_error();
     auto r = sqlite3_open(std::get<3>(tp).c_str(), &handle_);
     if (r != SQLITE_OK) {
-      set_last_error(sqlite3_errmsg(handle_));
+      set_handle_error();
       return false;
     }
 
@@ -51,7 +60,7 @@ class sqlite {
       std::string key = std::get<2>(tp);
       auto r2 = sqlite3_key(handle_, key.c_str(), key.length());
       if (r2 != SQLITE_OK) {
-        set_last_error(sqlite3_errmsg(handle_));
+        set_handle_error();
         return false;
       }
 
@@ -61,14 +70,14 @@ class sqlite {
       sqlite3_stmt *stmt = nullptr;
       auto r3 = sqlite3_prepare_v2(handle_, test_query, -1, &stmt, nullptr);
       if (r3 != SQLITE_OK) {
-        set_last_error(sqlite3_errmsg(handle_));
+        set_handle_error();
         can_query = false;
       }
       else {
         r3 = sqlite3_step(stmt);
         sqlite3_finalize(stmt);
         if (r3 != SQLITE_ROW) {
-          set_last_error("Invalid SQLCipher key");
+          set_last_error("Invalid SQLCipher key", db_errc::connection);
           can_query = false;
         }
       }
@@ -89,17 +98,18 @@ class sqlite {
                                    db.empty() ? host : db, timeout, port));
   }
 
-  bool ping() { return true; }
+  bool ping() { return handle_ != nullptr; }
 
   template <typename... Args>
   bool disconnect(Args &&...args) {
     if (handle_ != nullptr) {
+      clear_update_stmts();
       auto r = sqlite3_close(handle_);
       handle_ = nullptr;
       if (r == SQLITE_OK) {
         return true;
       }
-      set_last_error(sqlite3_errmsg(handle_));
+      set_handle_error();
       return false;
     }
     return true;
@@ -112,12 +122,7 @@ class sqlite {
 #ifdef ORMPP_ENABLE_LOG
     std::cout << sql << std::endl;
 #endif
-    if (sqlite3_exec(handle_, sql.data(), nullptr, nullptr, nullptr) !=
-        SQLITE_OK) {
-      set_last_error(sqlite3_errmsg(handle_));
-      return false;
-    }
-    return true;
+    return simple_query(sql.data());
   }
 
   template <typename T, typename... Args>
@@ -177,56 +182,88 @@ class sqlite {
 #ifdef ORMPP_ENABLE_LOG
     std::cout << sql << std::endl;
 #endif
+    if (cursor_busy()) {
+      return 0;
+    }
+    trace_scope trace(db_type_v, sql, error_);
     int result = sqlite3_prepare_v2(handle_, sql.data(), (int)sql.size(),
                                     &stmt_, nullptr);
     if (result != SQLITE_OK) {
-      set_last_error(sqlite3_errmsg(handle_));
+      set_handle_error();
       return 0;
     }
+    trace.prepared();
 
     if constexpr (sizeof...(Args) > 0) {
       size_t index = 0;
       (set_param_bind(args, ++index), ...);
     }
 
-    auto guard = guard_statment(stmt_);
+    auto guard = guard_statment(stmt_, *this);
     if (sqlite3_step(stmt_) != SQLITE_DONE) {
-      set_last_error(sqlite3_errmsg(handle_));
+      set_handle_error();
       return 0;
     }
-    return sqlite3_changes(handle_);
+    trace.executed();
+    uint64_t affected = sqlite3_changes(handle_);
+    trace.set_rows(affected);
+    return affected;
   }
 
   template <typename T, typename... Args>
   std::enable_if_t<iguana::ylt_refletable_v<T>, std::vector<T>> query_s(
       const std::string &str, Args &&...args) {
+    std::vector<T> v;
+    query_each<T>(
+        str,
+        [&v](T &t) {
+          v.push_back(std::move(t));
+        },
+        std::forward<Args>(args)...);
+    return v;
+  }
+
+  // Calls f(row) for every row as it is stepped instead of collecting them.
+  template <typename T, typename F, typename... Args>
+  bool query_each(const std::string &str, F &&f, Args &&...args) {
     std::string sql =
         contains_select(str) ? str : generate_query_sql<T>(db_type_v, str);
 #ifdef ORMPP_ENABLE_LOG
     std::cout << sql << std::endl;
 #endif
+    if (cursor_busy()) {
+      return false;
+    }
+    trace_scope trace(db_type_v, sql, error_);
+    // the cursor is held here, stmt_ only points at it for the binding and
+    // column helpers
+    sqlite3_stmt *stmt = nullptr;
     int result = sqlite3_prepare_v2(handle_, sql.data(), (int)sql.size(),
-                                    &stmt_, nullptr);
+                                    &stmt, nullptr);
+    stmt_ = stmt;
     if (result != SQLITE_OK) {
-      set_last_error(sqlite3_errmsg(handle_));
-      return {};
+      set_handle_error();
+      return false;
     }
+    trace.prepared();
 
     if constexpr (sizeof...(Args) > 0) {
       size_t index = 0;
       (set_param_bind(args, ++index), ...);
     }
 
-    auto guard = guard_statment(stmt_);
+    auto guard = guard_statment(stmt, *this);
+    cursor_scope cursor(in_cursor_);
 
-    std::vector<T> v;
     while (true) {
-      result = sqlite3_step(stmt_);
+      stmt_ = stmt;
+      result = sqlite3_step(stmt);
+      trace.executed();
       if (result == SQLITE_DONE)
         break;
 
       if (result != SQLITE_ROW)
-        break;
+        return false;
 
       T t = {};
       ylt::reflection::for_each(t,
@@ -234,10 +271,11 @@ class sqlite {
                                   assign(field, index);
                                 });
 
-      v.push_back(std::move(t));
+      trace.add_row(t);
+      f(t);
     }
 
-    return v;
+    return true;
   }
 
   template <typename T, typename... Args>
@@ -247,23 +285,29 @@ class sqlite {
 #ifdef ORMPP_ENABLE_LOG
     std::cout << sql << std::endl;
 #endif
+    if (cursor_busy()) {
+      return {};
+    }
+    trace_scope trace(db_type_v, sql, error_);
     int result = sqlite3_prepare_v2(handle_, sql.data(), (int)sql.size(),
                                     &stmt_, nullptr);
     if (result != SQLITE_OK) {
-      set_last_error(sqlite3_errmsg(handle_));
+      set_handle_error();
       return {};
     }
+    trace.prepared();
 
     if constexpr (sizeof...(Args) > 0) {
       size_t index = 0;
       (set_param_bind(args, ++index), ...);
     }
 
-    auto guard = guard_statment(stmt_);
+    auto guard = guard_statment(stmt_, *this);
 
     std::vector<T> v;
     while (true) {
       result = sqlite3_step(stmt_);
+      trace.executed();
       if (result == SQLITE_DONE)
         break;
 
@@ -291,13 +335,57 @@ class sqlite {
           },
           std::make_index_sequence<std::tuple_size_v<T>>{});
 
-      if (index > 0)
+      if (index > 0) {
+        trace.add_row(tp);
         v.push_back(std::move(tp));
+      }
     }
 
     return v;
   }
 
+  template <typename T, typename... Args>
+  column_set<T> query_columns(const std::string &str, Args &&...args) {
+    std::string sql =
+        contains_select(str) ? str : generate_query_sql<T>(db_type_v, str);
+#ifdef ORMPP_ENABLE_LOG
+    std::cout << sql << std::endl;
+#endif
+    if (cursor_busy()) {
+      return {};
+    }
+    trace_scope trace(db_type_v, sql, error_);
+    int result = sqlite3_prepare_v2(handle_, sql.data(), (int)sql.size(),
+                                    &stmt_, nullptr);
+    if (result != SQLITE_OK) {
+      set_handle_error();
+      return {};
+    }
+    trace.prepared();
+
+    if constexpr (sizeof...(Args) > 0) {
+      size_t index = 0;
+      (set_param_bind(args, ++index), ...);
+    }
+
+    auto guard = guard_statment(stmt_, *this);
+
+    column_set<T> cols;
+    while ((result = sqlite3_step(stmt_)) == SQLITE_ROW) {
+      trace.executed();
+      cols.append_row([this](auto &value, size_t i) {
+        if (sqlite3_column_type(stmt_, (int)i) == SQLITE_NULL) {
+          return true;
+        }
+        assign(value, (int)i);
+        return false;
+      });
+    }
+    trace.executed();
+    trace.set_rows(cols.size());
+    return cols;
+  }
+
   template <typename... Args>
   auto select(Args... args) {
     return ormpp::select(this, args...);
@@ -324,6 +412,64 @@ class sqlite {
   auto make_alter_table() {
     return ormpp::make_alter_table_builder<T>(this);
   }
+
+  template <typename T>
+  auto make_upsert() {
+    return ormpp::make_upsert_builder<T>(this);
+  }
+
+  // Multi-row VALUES, one statement per batch:
+  //   insert into t(a,b) values(?,?),(?,?),... on conflict(a) do update set
+  //   b=excluded.b
+  // The statement of a full batch is prepared once, the batch size is capped
+  // by the number of parameters sqlite accepts.
+  template <typename T>
+  int bulk_upsert(const std::vector<T> &v, const bulk_upsert_sql &stmt,
+                  size_t batch_size) {
+    size_t width = std::count(stmt.columns.begin(), stmt.columns.end(), true);
+    size_t max_rows =
+        sqlite3_limit(handle_, SQLITE_LIMIT_VARIABLE_NUMBER, -1) / width;
+    batch_size = (std::min)(batch_size, (std::max)(max_rows, size_t(1)));
+    size_t full = v.size() - v.size() % batch_size;
+
+    if (transaction_ && !begin()) {
+      return INT_MIN;
+    }
+    int rows = upsert_batches(v, stmt, 0, full, batch_size);
+    if (rows != INT_MIN && full < v.size()) {
+      int tail = upsert_batches(v, stmt, full, v.size(), v.size() - full);
+      rows = tail == INT_MIN ? INT_MIN : rows + tail;
+    }
+    if (rows == INT_MIN) {
+      if (transaction_) {
+        // keep the error of the failed batch
+        auto error = error_;
+        rollback();
+        error_ = std::move(error);
+      }
+      return INT_MIN;
+    }
+
+    if (transaction_ && !commit()) {
+      return INT_MIN;
+    }
+    return rows;
+  }
+
+  // update t set <columns> where <conflict keys>, bit i of columns is
+  // member i. The statement of each struct and column mask is prepared once
+  // per connection and kept. No transaction is opened, the caller groups the
+  // statements.
+  template <typename T>
+  int update_columns(const T &t, uint64_t columns) {
+    return update_columns_impl(&t, 1, columns);
+  }
+
+  template <typename T>
+  int update_columns(const std::vector<T> &v, uint64_t columns) {
+    return update_columns_impl(v.data(), v.size(), columns);
+  }
+
   // restriction, all the args are string, the first is the where condition,
   // rest are append conditions
   template <typename T, typename... Args>
@@ -333,18 +479,24 @@ class sqlite {
 #ifdef ORMPP_ENABLE_LOG
     std::cout << sql << std::endl;
 #endif
+    if (cursor_busy()) {
+      return {};
+    }
+    trace_scope trace(db_type_v, sql, error_);
     int result = sqlite3_prepare_v2(handle_, sql.data(), (int)sql.size(),
                                     &stmt_, nullptr);
     if (result != SQLITE_OK) {
-      set_last_error(sqlite3_errmsg(handle_));
+      set_handle_error();
       return {};
     }
+    trace.prepared();
 
-    auto guard = guard_statment(stmt_);
+    auto guard = guard_statment(stmt_, *this);
 
     std::vector<T> v;
     while (true) {
       result = sqlite3_step(stmt_);
+      trace.executed();
       if (result == SQLITE_DONE)
         break;
 
@@ -356,6 +508,7 @@ class sqlite {
                                 [this](auto &field, auto /*name*/, auto index) {
                                   assign(field, index);
                                 });
+      trace.add_row(t);
       v.push_back(std::move(t));
     }
 
@@ -379,18 +532,24 @@ class sqlite {
       sql = get_sql(sql, std::forward<Args>(args)...);
     }
 
+    if (cursor_busy()) {
+      return {};
+    }
+    trace_scope trace(db_type_v, sql, error_);
     int result = sqlite3_prepare_v2(handle_, sql.data(), (int)sql.size(),
                                     &stmt_, nullptr);
     if (result != SQLITE_OK) {
-      set_last_error(sqlite3_errmsg(handle_));
+      set_handle_error();
       return {};
     }
+    trace.prepared();
 
-    auto guard = guard_statment(stmt_);
+    auto guard = guard_statment(stmt_, *this);
 
     std::vector<T> v;
     while (true) {
       result = sqlite3_step(stmt_);
+      trace.executed();
       if (result == SQLITE_DONE)
         break;
 
@@ -418,8 +577,10 @@ class sqlite {
           },
           std::make_index_sequence<SIZE>{});
 
-      if (index > 0)
+      if (index > 0) {
+        trace.add_row(tp);
         v.push_back(std::move(tp));
+      }
     }
 
     return v;
@@ -430,54 +591,48 @@ class sqlite {
 #ifdef ORMPP_ENABLE_LOG
     std::cout << sql << std::endl;
 #endif
+    if (cursor_busy()) {
+      return false;
+    }
+    trace_scope trace(db_type_v, sql, error_);
     int result = sqlite3_prepare_v2(handle_, sql.data(), (int)sql.size(),
                                     &stmt_, nullptr);
     if (result != SQLITE_OK) {
-      set_last_error(sqlite3_errmsg(handle_));
+      set_handle_error();
       return false;
     }
+    trace.prepared();
 
-    auto guard = guard_statment(stmt_);
+    auto guard = guard_statment(stmt_, *this);
     if (sqlite3_step(stmt_) != SQLITE_DONE) {
-      set_last_error(sqlite3_errmsg(handle_));
+      set_handle_error();
       return false;
     }
+    trace.executed();
+    trace.set_rows(sqlite3_changes(handle_));
     return true;
   }
 
-  int get_last_affect_rows() { return sqlite3_changes(handle_); }
+  int get_last_affect_rows() {
+    return handle_ == nullptr ? 0 : sqlite3_changes(handle_);
+  }
 
   // transaction
   void set_enable_transaction(bool enable) { transaction_ = enable; }
 
   bool begin() {
     reset_error();
-    if (sqlite3_exec(handle_, "BEGIN", nullptr, nullptr, nullptr) !=
-        SQLITE_OK) {
-      set_last_error(sqlite3_errmsg(handle_));
-      return false;
-    }
-    return true;
+    return simple_query("BEGIN");
   }
 
   bool commit() {
     reset_error();
-    if (sqlite3_exec(handle_, "COMMIT", nullptr, nullptr, nullptr) !=
-        SQLITE_OK) {
-      set_last_error(sqlite3_errmsg(handle_));
-      return false;
-    }
-    return true;
+    return simple_query("COMMIT");
   }
 
   bool rollback() {
     reset_error();
-    if (sqlite3_exec(handle_, "ROLLBACK", nullptr, nullptr, nullptr) !=
-        SQLITE_OK) {
-      set_last_error(sqlite3_errmsg(handle_));
-      return false;
-    }
-    return true;
+    return simple_query("ROLLBACK");
   }
 
  private:
@@ -538,8 +693,8 @@ class sqlite {
     std::string sql;
     sql.append("CREATE TABLE IF NOT EXISTS ").append(table_name).append("(");
     T t;
-    ylt::reflection::for_each(t, [&](auto &field, auto name, size_t index) {
-      using item_type = std::decay_t<decltype(field)>;
+    ylt::reflection::for_each(t, [&](auto & /*field*/, auto name,
+                                     size_t index) {
       sql.append(name).append(" ").append(type_name_arr[index]);
 
       std::string str_name(name);
@@ -619,12 +774,12 @@ class sqlite {
     }
 
     if (!bind_ok) {
-      set_last_error(sqlite3_errmsg(handle_));
+      set_handle_error();
       return INT_MIN;
     }
 
     if (sqlite3_step(stmt_) != SQLITE_DONE) {
-      set_last_error(sqlite3_errmsg(handle_));
+      set_handle_error();
       return INT_MIN;
     }
 
@@ -669,6 +824,15 @@ class sqlite {
       return SQLITE_OK ==
              sqlite3_bind_text(stmt_, i, value, strlen(value), nullptr);
     }
+    else if constexpr (is_sql_value_type_v<U>) {
+      return SQLITE_OK == sqlite3_bind_int64(stmt_, i, to_sql_integer(value));
+    }
+    else if constexpr (is_json_column_v<U>) {
+      std::string text;
+      append_column_text(text, value, column_text::json);
+      return SQLITE_OK == sqlite3_bind_text(stmt_, i, text.data(),
+                                            (int)text.size(), SQLITE_TRANSIENT);
+    }
     else if constexpr (std::is_same_v<blob, U>) {
       return SQLITE_OK == sqlite3_bind_blob(stmt_, i, value.data(),
                                             static_cast<size_t>(value.size()),
@@ -722,10 +886,9 @@ class sqlite {
                    (size_t)sqlite3_column_bytes(stmt_, i));
     }
     else if constexpr (std::is_same_v<std::string_view, U>) {
-      sv_.reserve(sqlite3_column_bytes(stmt_, i));
-      sv_.assign((const char *)sqlite3_column_text(stmt_, i),
-                 (size_t)sqlite3_column_bytes(stmt_, i));
-      value = sv_;
+      value = hold_result_text(arena_, sv_,
+                               (const char *)sqlite3_column_text(stmt_, i),
+                               (size_t)sqlite3_column_bytes(stmt_, i));
     }
     else if constexpr (iguana::array_v<U>) {
       memcpy(value.data(), sqlite3_column_text(stmt_, i), sizeof(U));
@@ -733,10 +896,26 @@ class sqlite {
     else if constexpr (iguana::c_array_v<U>) {
       memcpy(value, sqlite3_column_text(stmt_, i), sizeof(U));
     }
+    else if constexpr (is_sql_value_type_v<U>) {
+      value = from_sql_integer<U>(sqlite3_column_int64(stmt_, i));
+    }
+    else if constexpr (is_json_column_v<U>) {
+      std::string_view text((const char *)sqlite3_column_text(stmt_, i),
+                            (size_t)sqlite3_column_bytes(stmt_, i));
+      if (!parse_column_text(text, value, column_text::json)) {
+        value = U{};
+      }
+    }
     else if constexpr (std::is_same_v<blob, U>) {
       auto p = (const char *)sqlite3_column_blob(stmt_, i);
       value = blob(p, p + sqlite3_column_bytes(stmt_, i));
     }
+    else if constexpr (is_blob_view_v<U>) {
+      auto str = hold_result_text(arena_, sv_,
+                                  (const char *)sqlite3_column_blob(stmt_, i),
+                                  (size_t)sqlite3_column_bytes(stmt_, i));
+      value = blob_view(str.data(), str.size());
+    }
 #ifdef ORMPP_WITH_CSTRING
     else if constexpr (std::is_same_v<CString, U>) {
       value.SetString((const char *)sqlite3_column_text(stmt_, i));
@@ -766,7 +945,8 @@ class sqlite {
     auto sql = generate_update_sql<T, members...>(db_type_v,
                                                   std::forward<Args>(args)...);
     if (sql.empty()) {
-      set_last_error("update requires a conflict key or where condition");
+      set_last_error("update requires a conflict key or where condition",
+                     db_errc::invalid_argument);
       return INT_MIN;
     }
     auto res = insert_or_update_impl<members...>(t, sql, OptType::update, false,
@@ -779,7 +959,8 @@ class sqlite {
     auto sql = generate_update_sql<T, members...>(db_type_v,
                                                   std::forward<Args>(args)...);
     if (sql.empty()) {
-      set_last_error("update requires a conflict key or where condition");
+      set_last_error("update requires a conflict key or where condition",
+                     db_errc::invalid_argument);
       return INT_MIN;
     }
     auto res = insert_or_update_impl<members...>(v, sql, OptType::update, false,
@@ -796,18 +977,25 @@ class sqlite {
 #ifdef ORMPP_ENABLE_LOG
     std::cout << sql << std::endl;
 #endif
+    if (cursor_busy()) {
+      return std::nullopt;
+    }
+    trace_scope trace(db_type_v, sql, error_);
     if (sqlite3_prepare_v2(handle_, sql.data(), (int)sql.size(), &stmt_,
                            nullptr) != SQLITE_OK) {
-      set_last_error(sqlite3_errmsg(handle_));
+      set_handle_error();
       return std::nullopt;
     }
+    trace.prepared();
 
-    auto guard = guard_statment(stmt_);
+    auto guard = guard_statment(stmt_, *this);
 
     if (stmt_execute<members...>(t, type, std::forward<Args>(args)...) ==
         INT_MIN) {
       return std::nullopt;
     }
+    trace.executed();
+    trace.set_rows(1);
 
     return get_insert_id ? sqlite3_last_insert_rowid(handle_) : 1;
   }
@@ -821,13 +1009,18 @@ class sqlite {
 #ifdef ORMPP_ENABLE_LOG
     std::cout << sql << std::endl;
 #endif
+    if (cursor_busy()) {
+      return std::nullopt;
+    }
+    trace_scope trace(db_type_v, sql, error_);
     if (sqlite3_prepare_v2(handle_, sql.data(), (int)sql.size(), &stmt_,
                            nullptr) != SQLITE_OK) {
-      set_last_error(sqlite3_errmsg(handle_));
+      set_handle_error();
       return std::nullopt;
     }
+    trace.prepared();
 
-    auto guard = guard_statment(stmt_);
+    auto guard = guard_statment(stmt_, *this);
 
     if (transaction_ && !begin()) {
       return std::nullopt;
@@ -846,11 +1039,14 @@ class sqlite {
         if (transaction_) {
           rollback();
         }
-        set_last_error(sqlite3_errmsg(handle_));
+        set_handle_error();
         return std::nullopt;
       }
     }
 
+    trace.executed();
+    trace.set_rows(v.size());
+
     if (transaction_ && !commit()) {
       return std::nullopt;
     }
@@ -859,28 +1055,243 @@ class sqlite {
   }
 
  private:
+  // Rows [first, last) in statements of batch_size rows each
+  template <typename T>
+  int upsert_batches(const std::vector<T> &v, const bulk_upsert_sql &stmt,
+                     size_t first, size_t last, size_t batch_size) {
+    if (first == last) {
+      return 0;
+    }
+    std::string row = "(";
+    for (bool inserted : stmt.columns) {
+      if (inserted) {
+        row.append("?,");
+      }
+    }
+    row.back() = ')';
+    std::string sql = stmt.head;
+    sql.append(" values");
+    for (size_t i = 0; i < batch_size; ++i) {
+      sql.append(row).append(",");
+    }
+    sql.pop_back();
+    sql.append(stmt.conflict);
+#ifdef ORMPP_ENABLE_LOG
+    std::cout << sql << std::endl;
+#endif
+
+    if (cursor_busy()) {
+      return INT_MIN;
+    }
+    trace_scope trace(db_type_v, sql, error_);
+    if (sqlite3_prepare_v2(handle_, sql.data(), (int)sql.size(), &stmt_,
+                           nullptr) != SQLITE_OK) {
+      set_handle_error();
+      return INT_MIN;
+    }
+    trace.prepared();
+
+    auto guard = guard_statment(stmt_, *this);
+
+    int rows = 0;
+    for (size_t r = first; r < last; r += batch_size) {
+      int index = 0;
+      bool bind_ok = true;
+      for (size_t i = r; i < r + batch_size; ++i) {
+        ylt::reflection::for_each(v[i], [&](auto &field, auto /*name*/,
+                                            size_t member) {
+          if (bind_ok && stmt.columns[member]) {
+            bind_ok = set_param_bind(field, ++index);
+          }
+        });
+      }
+      if (!bind_ok || sqlite3_step(stmt_) != SQLITE_DONE) {
+        set_handle_error();
+        sqlite3_reset(stmt_);
+        return INT_MIN;
+      }
+      rows += sqlite3_changes(handle_);
+      sqlite3_reset(stmt_);
+    }
+    trace.executed();
+    trace.set_rows(rows);
+    return rows;
+  }
+
+  struct cached_update {
+    sqlite3_stmt *stmt = nullptr;
+    std::string sql;
+  };
+
+  template <typename T>
+  int update_columns_impl(const T *rows, size_t n, uint64_t columns) {
+    if (cursor_busy()) {
+      return INT_MIN;
+    }
+    auto key = std::make_pair(type_key_of<T>(), columns);
+    auto it = update_stmts_.find(key);
+    if (it == update_stmts_.end()) {
+      auto sql = generate_update_columns_sql<T>(db_type_v, columns);
+      if (sql.empty()) {
+        set_last_error("update requires a conflict key and a column",
+                       db_errc::invalid_argument);
+        return INT_MIN;
+      }
+      if (update_stmts_.size() >= update_stmt_cache_size) {
+        clear_update_stmts();
+      }
+      it = update_stmts_.emplace(key, cached_update{nullptr, std::move(sql)})
+               .first;
+    }
+    stmt_ = it->second.stmt;
+    int count = execute_update(it->second, rows, n, columns);
+    stmt_ = nullptr;
+    // A failed row (constraint, busy ...) leaves the statement good. It is
+    // prepared again next time only if preparing failed or the schema
+    // changed under it.
+    if (count == INT_MIN && (it->second.stmt == nullptr ||
+                             (error_.native_code & 0xff) == SQLITE_SCHEMA)) {
+      sqlite3_finalize(it->second.stmt);
+      update_stmts_.erase(it);
+    }
+    return count;
+  }
+
+  template <typename T>
+  int execute_update(cached_update &cached, const T *rows, size_t n,
+                     uint64_t columns) {
+    reset_error();
+#ifdef ORMPP_ENABLE_LOG
+    std::cout << cached.sql << std::endl;
+#endif
+    trace_scope trace(db_type_v, cached.sql, error_);
+    if (cached.stmt == nullptr) {
+      if (sqlite3_prepare_v2(handle_, cached.sql.data(),
+                             (int)cached.sql.size(), &cached.stmt,
+                             nullptr) != SQLITE_OK) {
+        set_handle_error();
+        return INT_MIN;
+      }
+      stmt_ = cached.stmt;
+    }
+    trace.prepared();
+
+    uint64_t keys = conflict_key_columns<T>();
+    int count = 0;
+    for (size_t r = 0; r < n; ++r) {
+      int index = 0;
+      bool bind_ok = true;
+      for (uint64_t mask : {columns, keys}) {
+        ylt::reflection::for_each(rows[r], [&](auto &field, auto /*name*/,
+                                               size_t member) {
+          if (bind_ok && (mask >> member & 1)) {
+            bind_ok = set_param_bind(field, ++index);
+          }
+        });
+      }
+      if (!bind_ok || sqlite3_step(stmt_) != SQLITE_DONE) {
+        set_handle_error();
+        sqlite3_reset(stmt_);
+        return INT_MIN;
+      }
+      count += sqlite3_changes(handle_);
+      sqlite3_reset(stmt_);
+    }
+    trace.executed();
+    trace.set_rows(count);
+    return count;
+  }
+
+  void clear_update_stmts() {
+    for (auto &[key, cached] : update_stmts_) {
+      sqlite3_finalize(cached.stmt);
+    }
+    update_stmts_.clear();
+  }
+
+  bool simple_query(const char *sql) {
+    if (cursor_busy()) {
+      return false;
+    }
+    trace_scope trace(db_type_v, sql, error_);
+    int ret = sqlite3_exec(handle_, sql, nullptr, nullptr, nullptr);
+    trace.executed();
+    if (ret != SQLITE_OK) {
+      set_handle_error();
+      return false;
+    }
+    return true;
+  }
+
+  void set_handle_error() {
+    int native = sqlite3_extended_errcode(handle_);
+    error_.assign(to_errc(native), sqlite3_errmsg(handle_), native);
+    std::cout << error_.message << std::endl;  // todo, write to log file
+  }
+
+  static db_errc to_errc(int native) {
+    switch (native & 0xff) {
+      case SQLITE_CONSTRAINT:
+        return db_errc::constraint;
+      case SQLITE_BUSY:
+      case SQLITE_LOCKED:
+        return db_errc::transaction;
+      case SQLITE_INTERRUPT:
+        return db_errc::timeout;
+      case SQLITE_CANTOPEN:
+      case SQLITE_NOTADB:
+        return db_errc::connection;
+      case SQLITE_MISUSE:
+      case SQLITE_RANGE:
+        return db_errc::invalid_argument;
+      default:
+        return db_errc::statement;
+    }
+  }
+
   struct guard_statment {
-    guard_statment(sqlite3_stmt *stmt) : stmt_(stmt) { reset_error(); }
+    guard_statment(sqlite3_stmt *stmt, sqlite &db) : stmt_(stmt), db_(db) {
+      db_.reset_error();
+    }
     ~guard_statment() {
       if (stmt_ != nullptr) {
         auto status = sqlite3_finalize(stmt_);
         if (status) {
-          set_last_error("close statment error code " + std::to_string(status));
+          db_.error_.assign(to_errc(status),
+                            "close statment error code " +
+                                std::to_string(status),
+                            status);
+          std::cout << db_.error_.message << std::endl;
         }
       }
     }
 
    private:
     sqlite3_stmt *stmt_ = nullptr;
+    sqlite &db_;
   };
 
  private:
+  // fails a statement issued from inside a query_each callback, see
+  // cursor_scope
+  bool cursor_busy() {
+    if (!in_cursor_) {
+      return false;
+    }
+    set_last_error(std::string(cursor_busy_error), db_errc::invalid_argument);
+    return true;
+  }
+
   sqlite3 *handle_ = nullptr;
   sqlite3_stmt *stmt_ = nullptr;
-  inline static std::string sv_;
-  inline static std::string last_error_;
-  inline static bool has_error_ = false;
-  inline static bool transaction_ = true;
+  std::string sv_;
+  string_arena *arena_ = nullptr;
+  // set while query_each reads rows
+  bool in_cursor_ = false;
+  db_error error_;
+  bool transaction_ = true;
+  // update_columns statements by struct and column mask
+  std::map<std::pair<type_key, uint64_t>, cached_update> update_stmts_;
 };
 }  // namespace ormpp
 
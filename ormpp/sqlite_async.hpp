@@ -0,0 +1,432 @@
+#ifndef ORMPP_SQLITE_ASYNC_HPP
+#define ORMPP_SQLITE_ASYNC_HPP
+
+#include <algorithm>
+#include <asio.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "async_traits.hpp"
+#include "sqlite.hpp"
+
+namespace ormpp {
+
+// Threads running the blocking sqlite calls of the sqlite_async handles. A
+// handle is pinned to one worker for its whole life, so its statements are
+// serialized without any locking and the sqlite connection never migrates
+// between threads. The number of workers bounds the number of statements
+// blocking at the same time, whatever the number of handles.
+class sqlite_worker_pool {
+ public:
+  using executor_type = asio::io_context::executor_type;
+
+  explicit sqlite_worker_pool(std::size_t threads = default_threads()) {
+    threads = std::max<std::size_t>(threads, 1);
+    workers_.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i) {
+      workers_.push_back(std::make_unique<worker>());
+    }
+    for (auto &w : workers_) {
+      w->thd = std::thread([ctx = &w->ctx] {
+        ctx->run();
+      });
+    }
+  }
+
+  ~sqlite_worker_pool() {
+    for (auto &w : workers_) {
+      w->guard.reset();
+    }
+    for (auto &w : workers_) {
+      if (w->thd.joinable()) {
+        w->thd.join();
+      }
+    }
+  }
+
+  sqlite_worker_pool(const sqlite_worker_pool &) = delete;
+  sqlite_worker_pool &operator=(const sqlite_worker_pool &) = delete;
+
+  static sqlite_worker_pool &instance() {
+    static sqlite_worker_pool pool;
+    return pool;
+  }
+
+  // Round robin, handles are expected to be long lived (pooled connections).
+  executor_type pick() {
+    auto idx = next_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+    return workers_[idx]->ctx.get_executor();
+  }
+
+  std::size_t size() const { return workers_.size(); }
+
+  static std::size_t default_threads() {
+    return std::clamp<std::size_t>(std::thread::hardware_concurrency(), 1, 4);
+  }
+
+ private:
+  struct worker {
+    asio::io_context ctx{1};
+    asio::executor_work_guard<executor_type> guard{ctx.get_executor()};
+    std::thread thd;
+  };
+
+  std::vector<std::unique_ptr<worker>> workers_;
+  std::atomic<std::size_t> next_{0};
+};
+
+// Coroutine front end of the sqlite backend: every call is run on the worker
+// the handle is pinned to, and the awaiting coroutine is resumed on its own
+// executor once the statement is done, so asio threads never block in
+// sqlite3_step.
+class sqlite_async {
+ public:
+  using executor_type = asio::any_io_executor;
+  template <typename T>
+  using awaitable = asio::awaitable<T, executor_type>;
+
+  static constexpr DBType db_type_v = DBType::sqlite;
+
+  explicit sqlite_async(
+      executor_type executor,
+      sqlite_worker_pool &workers = sqlite_worker_pool::instance())
+      : executor_(std::move(executor)),
+        worker_(workers.pick()),
+        db_(std::make_shared<sqlite>()) {}
+
+  ~sqlite_async() {
+    if (db_) {
+      // close the handle on its worker, after anything still queued there
+      asio::post(worker_, [db = std::move(db_)] {});
+    }
+  }
+
+  // Not movable: calls still queued on the worker hold this object, and a
+  // moved from one would have no handle. Keep it in a shared_ptr as the pool
+  // does.
+  sqlite_async(const sqlite_async &) = delete;
+  sqlite_async &operator=(const sqlite_async &) = delete;
+  sqlite_async(sqlite_async &&) = delete;
+  sqlite_async &operator=(sqlite_async &&) = delete;
+
+  // The error state belongs to the handle, it is only read once the awaited
+  // call completed on the worker.
+  bool has_error() const { return db_->has_error(); }
+
+  std::string get_last_error() const { return db_->get_last_error(); }
+
+  const db_error &get_error() const { return db_->get_error(); }
+
+  int get_last_affect_rows() const { return last_affect_rows_; }
+
+  awaitable<bool> connect(
+      std::tuple<std::string, std::string, std::string, std::string,
+                 std::optional<int>, std::optional<int>>
+          tp) {
+    auto fn = [tp = std::move(tp)](sqlite &db) {
+      return db.connect(tp);
+    };
+    co_return co_await run(std::move(fn));
+  }
+
+  awaitable<bool> connect(const std::string &host, const std::string &user,
+                          const std::string &passwd, const std::string &db,
+                          const std::optional<int> &timeout = {},
+                          const std::optional<int> &port = {}) {
+    auto tp = std::make_tuple(host, user, passwd, db, timeout, port);
+    co_return co_await connect(std::move(tp));
+  }
+
+  awaitable<bool> connect(const std::string &path) {
+    auto tp = std::make_tuple(std::string{}, std::string{}, std::string{}, path,
+                              std::optional<int>{}, std::optional<int>{});
+    co_return co_await connect(std::move(tp));
+  }
+
+  awaitable<bool> disconnect() {
+    co_return co_await run([](sqlite &db) {
+      return db.disconnect();
+    });
+  }
+
+  // false once the handle is closed, checked on the worker which owns it
+  awaitable<bool> ping() {
+    co_return co_await run([](sqlite &db) {
+      return db.ping();
+    });
+  }
+
+  void set_enable_transaction(bool enable) {
+    // only read on the worker by the following calls
+    db_->set_enable_transaction(enable);
+  }
+
+  template <typename T, typename... Args>
+  awaitable<bool> create_datatable(Args &&...args) {
+    auto fn = [args = std::make_tuple(std::forward<Args>(args)...)](
+                  sqlite &db) {
+      return std::apply(
+          [&db](auto &...items) {
+            return db.template create_datatable<T>(items...);
+          },
+          args);
+    };
+    co_return co_await run(std::move(fn));
+  }
+
+  template <typename T, typename... Args>
+  awaitable<int> insert(const T &t, Args &&...args) {
+    co_return co_await run_with(
+        [&t](sqlite &db, auto &...items) {
+          return db.insert(t, items...);
+        },
+        std::forward<Args>(args)...);
+  }
+
+  template <typename T, typename... Args>
+  awaitable<int> insert(const std::vector<T> &v, Args &&...args) {
+    co_return co_await run_with(
+        [&v](sqlite &db, auto &...items) {
+          return db.insert(v, items...);
+        },
+        std::forward<Args>(args)...);
+  }
+
+  template <typename T, typename... Args>
+  awaitable<int> replace(const T &t, Args &&...args) {
+    co_return co_await run_with(
+        [&t](sqlite &db, auto &...items) {
+          return db.replace(t, items...);
+        },
+        std::forward<Args>(args)...);
+  }
+
+  template <typename T, typename... Args>
+  awaitable<int> replace(const std::vector<T> &v, Args &&...args) {
+    co_return co_await run_with(
+        [&v](sqlite &db, auto &...items) {
+          return db.replace(v, items...);
+        },
+        std::forward<Args>(args)...);
+  }
+
+  template <auto... members, typename T, typename... Args>
+  awaitable<int> update(const T &t, Args &&...args) {
+    co_return co_await run_with(
+        [&t](sqlite &db, auto &...items) {
+          return db.template update<members...>(t, items...);
+        },
+        std::forward<Args>(args)...);
+  }
+
+  template <auto... members, typename T, typename... Args>
+  awaitable<int> update(const std::vector<T> &v, Args &&...args) {
+    co_return co_await run_with(
+        [&v](sqlite &db, auto &...items) {
+          return db.template update<members...>(v, items...);
+        },
+        std::forward<Args>(args)...);
+  }
+
+  template <typename T, typename... Args>
+  awaitable<uint64_t> get_insert_id_after_insert(const T &t, Args &&...args) {
+    co_return co_await run_with(
+        [&t](sqlite &db, auto &...items) {
+          return db.get_insert_id_after_insert(t, items...);
+        },
+        std::forward<Args>(args)...);
+  }
+
+  template <typename T, typename... Args>
+  awaitable<uint64_t> get_insert_id_after_insert(const std::vector<T> &v,
+                                                 Args &&...args) {
+    co_return co_await run_with(
+        [&v](sqlite &db, auto &...items) {
+          return db.get_insert_id_after_insert(v, items...);
+        },
+        std::forward<Args>(args)...);
+  }
+
+  template <typename T, typename... Args>
+  awaitable<uint64_t> delete_records_s(const std::string &str = "",
+                                       Args &&...args) {
+    co_return co_await run_with(
+        [&str](sqlite &db, auto &...items) {
+          return db.template delete_records_s<T>(str, items...);
+        },
+        std::forward<Args>(args)...);
+  }
+
+  template <typename T, typename... Args>
+  awaitable<std::vector<T>> query_s(const std::string &str = "",
+                                    Args &&...args) {
+    co_return co_await run_with(
+        [&str](sqlite &db, auto &...items) {
+          return db.template query_s<T>(str, items...);
+        },
+        std::forward<Args>(args)...);
+  }
+
+  template <typename T, typename... Args>
+  awaitable<bool> delete_records(Args &&...where_condition) {
+    auto sql = generate_delete_sql<T>(
+        db_type_v, std::forward<Args>(where_condition)...);
+    co_return co_await execute(sql);
+  }
+
+  template <typename T, typename... Args>
+  awaitable<std::vector<T>> query(Args &&...args) {
+    static_assert(sizeof...(Args) > 0);
+    auto sql = generate_query_sql<T>(db_type_v, std::forward<Args>(args)...);
+    co_return co_await query_s<T>(sql);
+  }
+
+  template <typename... Args>
+  auto select(Args... args) {
+    return ormpp::select(this, args...);
+  }
+
+  auto select(all_t) { return ormpp::select_all(this); }
+
+  auto select_all() { return ormpp::select_all(this); }
+
+  template <typename T>
+  auto make_update() {
+    return ormpp::make_update_builder<T>(this);
+  }
+
+  template <typename T>
+  auto make_delete() {
+    return ormpp::make_delete_builder<T>(this);
+  }
+
+  template <typename T>
+  auto make_create_table() {
+    return ormpp::make_create_table_builder<T>(this);
+  }
+
+  template <typename T>
+  auto make_alter_table() {
+    return ormpp::make_alter_table_builder<T>(this);
+  }
+
+  awaitable<bool> execute(const std::string &sql) {
+    co_return co_await run([&sql](sqlite &db) {
+      return db.execute(sql);
+    });
+  }
+
+  awaitable<bool> begin() {
+    co_return co_await run([](sqlite &db) {
+      return db.begin();
+    });
+  }
+
+  awaitable<bool> commit() {
+    co_return co_await run([](sqlite &db) {
+      return db.commit();
+    });
+  }
+
+  awaitable<bool> rollback() {
+    co_return co_await run([](sqlite &db) {
+      return db.rollback();
+    });
+  }
+
+  // Runs fn(sqlite&) on the worker of this handle and resumes the caller on
+  // its executor with the result. fn must return a value, exceptions are
+  // rethrown in the caller. References captured by fn must stay valid until
+  // the call completes.
+  template <typename F>
+  awaitable<std::invoke_result_t<F &, sqlite &>> run(F fn) {
+    using R = std::invoke_result_t<F &, sqlite &>;
+    static_assert(!std::is_void_v<R>, "fn must return a value");
+    // Not a coroutine itself: fn is moved straight into the operation instead
+    // of being kept in a coroutine frame.
+    return asio::async_initiate<const asio::use_awaitable_t<executor_type> &,
+                                void(std::exception_ptr, R)>(
+        [this](auto handler, std::shared_ptr<sqlite> db,
+               sqlite_worker_pool::executor_type worker, F fn) {
+          auto caller = asio::prefer(asio::get_associated_executor(handler),
+                                     asio::execution::outstanding_work.tracked);
+          asio::post(worker, [this, db = std::move(db), fn = std::move(fn),
+                              handler = std::move(handler),
+                              caller = std::move(caller)]() mutable {
+            std::exception_ptr ep;
+            R result{};
+            int affect_rows = 0;
+            try {
+              result = fn(*db);
+              affect_rows = db->get_last_affect_rows();
+            } catch (...) {
+              ep = std::current_exception();
+            }
+            asio::post(caller, [this, handler = std::move(handler), ep,
+                                result = std::move(result),
+                                affect_rows]() mutable {
+              last_affect_rows_ = affect_rows;
+              std::move(handler)(ep, std::move(result));
+            });
+          });
+        },
+        asio::use_awaitable_t<executor_type>{}, db_, worker_, std::move(fn));
+  }
+
+ private:
+  // String literals are stored as std::string, a decayed char pointer can not
+  // be bound by the sqlite backend.
+  template <typename U>
+  static auto own_arg(U &&arg) {
+    using D = std::decay_t<U>;
+    if constexpr (std::is_same_v<D, const char *> ||
+                  std::is_same_v<D, char *>) {
+      return std::string(arg);
+    }
+    else {
+      return D(std::forward<U>(arg));
+    }
+  }
+
+  // The extra arguments are copied into the task, the entity and the sql
+  // string are parameters of the awaiting coroutine and outlive the call.
+  template <typename F, typename... Args>
+  auto run_with(F fn, Args &&...args) {
+    return run([fn = std::move(fn),
+                args = std::make_tuple(own_arg(std::forward<Args>(args))...)](
+                   sqlite &db) mutable {
+      return std::apply(
+          [&](auto &...items) {
+            return fn(db, items...);
+          },
+          args);
+    });
+  }
+
+  executor_type executor_;
+  sqlite_worker_pool::executor_type worker_;
+  std::shared_ptr<sqlite> db_;
+  int last_affect_rows_ = 0;
+};
+
+template <>
+struct db_execution_traits<sqlite_async> {
+  static constexpr bool is_async = true;
+
+  template <typename T>
+  using awaitable_type = sqlite_async::awaitable<T>;
+};
+
+}  // namespace ormpp
+
+#endif  // ORMPP_SQLITE_ASYNC_HPP
@@ -5,7 +5,9 @@
 #include <string_view>
 #include <vector>
 
+#include "json_column.hpp"
 #include "pg_types.h"
+#include "sql_types.hpp"
 
 using namespace std::string_view_literals;
 
@@ -73,6 +75,25 @@ inline auto type_to_name(identity<std::array<char, N>>) noexcept {
   std::string s = "varchar(" + std::to_string(N) + ")";
   return s;
 }
+template <typename Duration>
+inline constexpr auto type_to_name(
+    identity<std::chrono::sys_time<Duration>>) noexcept {
+  return "DATETIME(6)"sv;
+}
+inline constexpr auto type_to_name(
+    identity<std::chrono::year_month_day>) noexcept {
+  return "DATE"sv;
+}
+template <int Scale>
+inline auto type_to_name(identity<decimal<Scale>>) noexcept {
+  std::string s = "DECIMAL(18," + std::to_string(Scale) + ")";
+  return s;
+}
+template <typename T>
+  requires is_json_column_v<T>
+inline constexpr auto type_to_name(identity<T>) noexcept {
+  return "JSON"sv;
+}
 
 // type_to_id uses MYSQL_TYPE_* constants — only available with <mysql.h>
 #ifdef ORMPP_ENABLE_MYSQL
@@ -147,6 +168,25 @@ inline auto type_to_name(identity<std::array<char, N>>) noexcept {
   std::string s = "varchar(" + std::to_string(N) + ")";
   return s;
 }
+// epoch microseconds, epoch days and the unscaled decimal
+template <typename Duration>
+inline constexpr auto type_to_name(
+    identity<std::chrono::sys_time<Duration>>) noexcept {
+  return "INTEGER"sv;
+}
+inline constexpr auto type_to_name(
+    identity<std::chrono::year_month_day>) noexcept {
+  return "INTEGER"sv;
+}
+template <int Scale>
+inline constexpr auto type_to_name(identity<decimal<Scale>>) noexcept {
+  return "INTEGER"sv;
+}
+template <typename T>
+  requires is_json_column_v<T>
+inline constexpr auto type_to_name(identity<T>) noexcept {
+  return "TEXT"sv;
+}
 }  // namespace ormpp_sqlite
 
 namespace ormpp_postgresql {
@@ -196,6 +236,33 @@ inline auto type_to_name(identity<std::array<char, N>>) noexcept {
   std::string s = "varchar(" + std::to_string(N) + ")";
   return s;
 }
+template <typename Duration>
+inline constexpr auto type_to_name(
+    identity<std::chrono::sys_time<Duration>>) noexcept {
+  return "timestamp"sv;
+}
+inline constexpr auto type_to_name(
+    identity<std::chrono::year_month_day>) noexcept {
+  return "date"sv;
+}
+template <int Scale>
+inline auto type_to_name(identity<decimal<Scale>>) noexcept {
+  std::string s = "numeric(18," + std::to_string(Scale) + ")";
+  return s;
+}
+template <typename T>
+  requires is_sql_array_v<decoded_column_t<T>>
+inline auto type_to_name(identity<T>) noexcept {
+  using E = typename decoded_column_t<T>::value_type;
+  std::string s(type_to_name(identity<E>{}));
+  s.append("[]");
+  return s;
+}
+template <typename T>
+  requires is_json_document_v<decoded_column_t<T>>
+inline constexpr auto type_to_name(identity<T>) noexcept {
+  return "jsonb"sv;
+}
 }  // namespace ormpp_postgresql
 
 }  // namespace ormpp
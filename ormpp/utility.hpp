@@ -431,7 +431,7 @@ inline std::string generate_insert_sql(DBType db_type, bool insert,
     std::string set;
     std::string fields = "(";
     std::string values = "values(";
-    for (auto i = 0; i < Count; ++i) {
+    for (size_t i = 0; i < Count; ++i) {
       std::string field_name(ylt::reflection::name_of<T>(i));
       std::string value = "$" + std::to_string(++index);
       append(set, field_name, "=", value);
@@ -577,6 +577,141 @@ inline std::string generate_update_sql(DBType db_type, Args &&...args) {
   return sql;
 }
 
+// Identifies a struct for maps keyed by type. get_struct_name is not enough:
+// with get_alias_struct_name, several structs can share one table name.
+template <typename T>
+inline constexpr char type_key_tag = 0;
+
+using type_key = const void *;
+
+template <typename T>
+constexpr type_key type_key_of() {
+  return &type_key_tag<T>;
+}
+
+// Marks a connection as reading query_each rows while it lives. A statement
+// the callback runs on that connection would break the open cursor, the
+// backends fail it with cursor_busy_error instead.
+class cursor_scope {
+ public:
+  explicit cursor_scope(bool &open) : open_(open) { open_ = true; }
+  ~cursor_scope() { open_ = false; }
+  cursor_scope(const cursor_scope &) = delete;
+  cursor_scope &operator=(const cursor_scope &) = delete;
+
+ private:
+  bool &open_;
+};
+
+inline constexpr std::string_view cursor_busy_error =
+    "the connection is reading query_each rows, the callback can not use it";
+
+// Bit i of a column mask is member i of the struct.
+inline constexpr size_t column_mask_limit = 64;
+
+// Column masks a connection keeps a prepared update statement for, the
+// cache starts over when it is full.
+inline constexpr size_t update_stmt_cache_size = 128;
+
+// The members named by REGISTER_CONFLICT_KEY, or the auto key.
+template <typename T>
+inline uint64_t conflict_key_columns() {
+  static const uint64_t columns = [] {
+    uint64_t mask = 0;
+    auto names = ylt::reflection::get_member_names<T>();
+    for (size_t i = 0; i < names.size(); ++i) {
+      if (is_conflict_key<T>(names[i], DBType::sqlite)) {
+        mask |= uint64_t(1) << i;
+      }
+    }
+    return mask;
+  }();
+  return columns;
+}
+
+// update t set <columns> where <conflict keys>, both in member order. Empty
+// without a conflict key or without a column.
+template <typename T>
+inline std::string generate_update_columns_sql(DBType db_type,
+                                               uint64_t columns) {
+  static_assert(ylt::reflection::members_count_v<T> <= column_mask_limit,
+                "a column mask holds 64 members");
+  uint64_t keys = conflict_key_columns<T>();
+  if (columns == 0 || keys == 0) {
+    return {};
+  }
+
+  std::string sql = "update ";
+  sql.append(get_short_struct_name<T>()).append(" set ");
+  std::string where = " where ";
+  size_t index = 0;
+  auto append_column = [&](std::string &out, std::string_view name) {
+    if (db_type == DBType::mysql) {
+      out.append("`").append(name).append("`");
+    }
+    else {
+      out.append(name);
+    }
+    if (db_type == DBType::postgresql) {
+      out.append("=$").append(std::to_string(++index));
+    }
+    else {
+      out.append("=?");
+    }
+  };
+  auto names = ylt::reflection::get_member_names<T>();
+  for (size_t i = 0; i < names.size(); ++i) {
+    if (columns >> i & 1) {
+      append_column(sql, names[i]);
+      sql.append(",");
+    }
+  }
+  sql.pop_back();
+  for (size_t i = 0; i < names.size(); ++i) {
+    if (keys >> i & 1) {
+      append_column(where, names[i]);
+      where.append(" and ");
+    }
+  }
+  where.resize(where.size() - 5);
+  return sql.append(where);
+}
+
+namespace detail {
+
+template <typename U>
+bool same_field(const U &a, const U &b) {
+  if constexpr (iguana::c_array_v<U>) {
+    return std::equal(std::begin(a), std::end(a), std::begin(b));
+  }
+  else if constexpr (requires { bool(a == b); }) {
+    return a == b;
+  }
+  else {
+    return false;
+  }
+}
+
+}  // namespace detail
+
+// The members whose values differ between a and b. A member without
+// operator== always counts as changed.
+template <typename T>
+inline uint64_t differing_columns(const T &a, const T &b) {
+  static_assert(ylt::reflection::members_count_v<T> <= column_mask_limit,
+                "a column mask holds 64 members");
+  auto old_refs = ylt::reflection::object_to_tuple(a);
+  auto new_refs = ylt::reflection::object_to_tuple(b);
+  uint64_t columns = 0;
+  [&]<size_t... Is>(std::index_sequence<Is...>) {
+    ((columns |= uint64_t(!detail::same_field(std::get<Is>(old_refs),
+                                              std::get<Is>(new_refs)))
+                 << Is),
+     ...);
+  }(std::make_index_sequence<ylt::reflection::members_count_v<T>>{});
+  return columns;
+}
+
 inline bool is_empty(const std::string &t) { return t.empty(); }
 
 template <typename T, typename... Args>
@@ -651,6 +786,58 @@ inline std::string escape_sql_string(std::string_view input) {
   return result;
 }
 
+// If a quoted literal, quoted identifier or comment starts at sql[pos],
+// returns the position of its last character (sql.size() when it is not
+// terminated), otherwise returns pos. Doubled quotes inside a quoted token
+// are escapes and do not end it.
+inline std::size_t skip_sql_quoted_or_comment(std::string_view sql,
+                                              std::size_t pos) {
+  std::size_t i = pos;
+  switch (sql[i]) {
+    case '\'':
+    case '"': {
+      const char quote = sql[i];
+      ++i;
+      while (i < sql.size()) {
+        if (sql[i] == quote) {
+          if (i + 1 < sql.size() && sql[i + 1] == quote) {
+            i += 2;
+            continue;
+          }
+          break;
+        }
+        ++i;
+      }
+      break;
+    }
+    case '-':
+      if (i + 1 < sql.size() && sql[i + 1] == '-') {
+        i += 2;
+        while (i < sql.size() && sql[i] != '\n' && sql[i] != '\r') {
+          ++i;
+        }
+      }
+      break;
+    case '/':
+      if (i + 1 < sql.size() && sql[i + 1] == '*') {
+        i += 2;
+        while (i + 1 < sql.size() && !(sql[i] == '*' && sql[i + 1] == '/')) {
+          ++i;
+        }
+        if (i + 1 < sql.size()) {
+          ++i;
+        }
+        else {
+          i = sql.size();
+        }
+      }
+      break;
+    default:
+      break;
+  }
+  return i;
+}
+
 template <typename T>
 inline constexpr auto to_str(T &&t) {
   if constexpr (std::is_arithmetic_v<std::decay_t<T>>) {
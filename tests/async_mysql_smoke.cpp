@@ -1,7 +1,9 @@
 #ifdef ORMPP_ENABLE_MYSQL_ASYNC
 
+#include <algorithm>
 #include <asio.hpp>
 #include <cstdlib>
+#include <cstring>
 #include <stdexcept>
 #include <string>
 #include <string_view>
@@ -590,6 +592,22 @@ asio::awaitable<void> run_async_mysql_smoke() {
           .collect();
   require_async(join_rows.size() == 3, "namespaced join row count mismatch");
 
+  // a statement past its deadline is killed and its connection closed
+  mysql_async slow(executor);
+  require_async(co_await slow.connect(cfg.db_ip, cfg.user_name, cfg.pwd,
+                                      cfg.db_name, cfg.timeout, cfg.db_port),
+                "deadline connect failed");
+  slow.set_query_timeout(std::chrono::milliseconds(200));
+  auto slow_start = std::chrono::steady_clock::now();
+  require_async(!co_await slow.execute("select sleep(3)"),
+                "statement past its deadline succeeded");
+  require_async(slow.get_error().code == db_errc::timeout,
+                "deadline error is not a timeout");
+  require_async(!slow.is_open(), "timed out connection still open");
+  require_async(
+      std::chrono::steady_clock::now() - slow_start < std::chrono::seconds(2),
+      "deadline did not cut the wait short");
+
   require_async(co_await db.disconnect(), "disconnect failed");
 }
 
@@ -635,6 +653,81 @@ TEST_CASE("mysql async formats placeholders with question marks in values") {
       "mysql_async: tuple column count mismatch", std::runtime_error);
 }
 
+TEST_CASE("mysql async resets decimals that do not parse") {
+  using ormpp::detail::mysql_async::invalid_value;
+  using ormpp::detail::mysql_async::map_row;
+  using row_t = std::tuple<int, ormpp::decimal<2>>;
+
+  invalid_value.clear();
+  auto good = map_row<row_t>({std::string("1"), std::string("1.50")});
+  CHECK(std::get<1>(good).unscaled() == 150);
+  CHECK(invalid_value.empty());
+  auto bad = map_row<row_t>({std::string("2"), std::string("abc")});
+  CHECK(std::get<1>(bad) == ormpp::decimal<2>{});
+  CHECK(invalid_value == "invalid decimal or temporal value 'abc'");
+  invalid_value.clear();
+}
+
+TEST_CASE("mysql async pipelines BEGIN only with a SELECT") {
+  using ormpp::detail::mysql_async::is_plain_select;
+
+  CHECK(is_plain_select("select * from t"));
+  CHECK(is_plain_select("  SELECT 1"));
+  CHECK(is_plain_select("/* hint */ -- note\nselect(1)"));
+  CHECK(!is_plain_select("insert into t values(1)"));
+  CHECK(!is_plain_select("update t set a=1"));
+  CHECK(!is_plain_select("selected"));
+  CHECK(!is_plain_select("with x as (select 1) delete from t"));
+  CHECK(!is_plain_select("'select'"));
+  CHECK(!is_plain_select(""));
+}
+
+TEST_CASE("mysql async packet buffer splits and joins packets") {
+  using ormpp::detail::mysql_async::byte;
+  using ormpp::detail::mysql_async::bytes;
+  using ormpp::detail::mysql_async::packet_buffer;
+
+  // copies data the way socket reads would, at most one prepare() at a time
+  auto feed = [](packet_buffer& buf, const bytes& data) {
+    std::size_t pos = 0;
+    while (pos < data.size()) {
+      auto dst = buf.prepare();
+      auto n = (std::min)(dst.size(), data.size() - pos);
+      std::memcpy(dst.data(), data.data() + pos, n);
+      buf.commit(n);
+      pos += n;
+    }
+  };
+
+  packet_buffer buf;
+  bytes payload;
+  byte seq = 0;
+  CHECK(!buf.take_packet(payload, seq));
+
+  // two packets in one read, the second one incomplete
+  feed(buf, bytes{2, 0, 0, 0, 'a', 'b', 3, 0, 0, 1, 'c'});
+  REQUIRE(buf.take_packet(payload, seq));
+  CHECK(payload == bytes{'a', 'b'});
+  CHECK(seq == 1);
+  CHECK(!buf.take_packet(payload, seq));
+  feed(buf, bytes{'d', 'e'});
+  REQUIRE(buf.take_packet(payload, seq));
+  CHECK(payload == bytes{'c', 'd', 'e'});
+  CHECK(seq == 2);
+
+  // a 16MB - 1 chunk is joined with its continuation
+  bytes big(4 + 0xffffff, 'x');
+  big[0] = big[1] = big[2] = 0xff;
+  big[3] = 4;
+  feed(buf, big);
+  CHECK(!buf.take_packet(payload, seq));
+  feed(buf, bytes{1, 0, 0, 5, 'y'});
+  REQUIRE(buf.take_packet(payload, seq));
+  CHECK(payload.size() == 0x1000000);
+  CHECK(payload.back() == 'y');
+  CHECK(seq == 6);
+}
+
 TEST_CASE("mysql async smoke") {
   asio::io_context ctx;
   auto fut = asio::co_spawn(ctx, run_async_mysql_smoke(), asio::use_future);
@@ -503,6 +503,42 @@ TestTask<void> safe_cancel_after_completion_task(
 }
 #endif
 
+TestTask<void> native_operation_task(asio::any_io_executor executor,
+                                     asio::ip::tcp::socket* client,
+                                     asio::ip::tcp::socket* server) {
+  asio::steady_timer timer(executor);
+  timer.expires_after(std::chrono::milliseconds(0));
+  co_await adapter::async_op<void>([&](auto handler) {
+    timer.async_wait(std::move(handler));
+  }).coAwait(nullptr);
+
+  std::string out = "ping";
+  auto written =
+      co_await adapter::async_op<std::size_t>([&](auto handler) {
+        asio::async_write(*client, asio::buffer(out), std::move(handler));
+      }).coAwait(nullptr);
+  CHECK(written == 4);
+
+  std::array<char, 4> in{};
+  auto read = co_await adapter::async_op<std::size_t>([&](auto handler) {
+                asio::async_read(*server, asio::buffer(in), std::move(handler));
+              }).coAwait(nullptr);
+  CHECK(read == 4);
+  CHECK(std::string(in.data(), in.size()) == "ping");
+
+  server->close();
+  bool thrown = false;
+  try {
+    co_await adapter::async_op<std::size_t>([&](auto handler) {
+      asio::async_read(*client, asio::buffer(in), std::move(handler));
+    }).coAwait(nullptr);
+  } catch (const asio::system_error& e) {
+    CHECK(e.code() == asio::error::eof);
+    thrown = true;
+  }
+  CHECK(thrown);
+}
+
 }  // namespace
 
 TEST_CASE("asio async_simple adapter timing: start and resume are posted") {
@@ -568,6 +604,25 @@ TEST_CASE("asio async_simple adapter timing: result and exception paths") {
   CHECK_NOTHROW(task.result());
 }
 
+TEST_CASE("asio async_simple native operation: results and errors") {
+  asio::io_context ctx;
+  asio::ip::tcp::acceptor acceptor(
+      ctx, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+  asio::ip::tcp::socket client(ctx);
+  client.connect(acceptor.local_endpoint());
+  auto server = acceptor.accept();
+
+  bool done = false;
+  auto task = native_operation_task(ctx.get_executor(), &client, &server);
+  asio::post(ctx, [&] {
+    task.start(done);
+  });
+  run_until(ctx, [&] {
+    return done;
+  });
+  CHECK_NOTHROW(task.result());
+}
+
 TEST_CASE("asio async_simple safe adapter: result and exception paths") {
   asio::io_context ctx;
   bool done = false;
@@ -17,7 +17,9 @@
 #include "connection_pool.hpp"
 #include "dbng.hpp"
 #include "doctest.h"
+#include "iguana/pb_reader.hpp"
 #include "ormpp_cfg.hpp"
+#include "parallel_query.hpp"
 
 using namespace std::string_literals;
 
@@ -4361,3 +4363,1186 @@ TEST_CASE("issue #238: multi-thread concurrent conflict-key cache") {
   CHECK(fail_count == 0);
   CHECK(success_count == thread_count);
 }
+
+#ifdef ORMPP_ENABLE_TRACE
+struct trace_person {
+  int id;
+  std::string name;
+  int age;
+};
+REGISTER_AUTO_KEY(trace_person, id)
+
+TEST_CASE("query tracer reports sqlite statements") {
+  std::vector<query_trace> traces;
+  std::vector<std::string> sqls;
+  std::vector<std::string> errors;
+  set_query_tracer([&](const query_trace &trace) {
+    traces.push_back(trace);
+    sqls.emplace_back(trace.sql);
+    errors.emplace_back(trace.error);
+  });
+
+  dbng<sqlite> sqlite;
+  REQUIRE(sqlite.connect(db));
+  REQUIRE(sqlite.execute("drop table if exists trace_person"));
+  REQUIRE(sqlite.create_datatable<trace_person>(ormpp_auto_key{"id"}));
+  traces.clear();
+  sqls.clear();
+  errors.clear();
+
+  REQUIRE(sqlite.insert<trace_person>({0, "tom", 20}) == 1);
+  REQUIRE(traces.size() == 1);
+  CHECK(traces[0].db_type == DBType::sqlite);
+  CHECK(traces[0].ok);
+  CHECK(traces[0].rows == 1);
+  CHECK(sqls[0].find("insert into trace_person") == 0);
+
+  traces.clear();
+  sqls.clear();
+  errors.clear();
+  auto v = sqlite.query_s<trace_person>("name=?", "tom");
+  REQUIRE(v.size() == 1);
+  REQUIRE(traces.size() == 1);
+  CHECK(traces[0].ok);
+  CHECK(traces[0].rows == 1);
+  CHECK(traces[0].bytes == sizeof(int) * 2 + 3);
+  CHECK(traces[0].fingerprint == sql_fingerprint(sqls[0]));
+  CHECK(traces[0].total_time() ==
+        traces[0].prepare_time + traces[0].execute_time +
+            traces[0].fetch_time);
+
+  traces.clear();
+  sqls.clear();
+  errors.clear();
+  CHECK(!sqlite.execute("select * from no_such_table"));
+  REQUIRE(traces.size() == 1);
+  CHECK(!traces[0].ok);
+  CHECK(errors[0].find("no_such_table") != std::string::npos);
+
+  set_query_tracer(nullptr);
+  traces.clear();
+  sqlite.query_s<trace_person>();
+  CHECK(traces.empty());
+  sqlite.execute("drop table if exists trace_person");
+}
+
+TEST_CASE("query tracer can be replaced while statements run") {
+  std::atomic<int> reported{0};
+  std::atomic<bool> stop{false};
+  std::thread worker([&] {
+    dbng<sqlite> sqlite;
+    if (sqlite.connect(db)) {
+      while (!stop) {
+        sqlite.execute("select 1");
+      }
+    }
+  });
+  // the captured string is freed with the replaced tracer
+  for (int i = 0; i < 200 || (reported == 0 && i < 1000000); ++i) {
+    set_query_tracer([&reported, name = std::to_string(i)](
+                         const query_trace &) {
+      reported += !name.empty();
+    });
+  }
+  set_query_tracer(nullptr);
+  stop = true;
+  worker.join();
+  CHECK(reported > 0);
+}
+#endif
+
+TEST_CASE("normalize sql for fingerprints") {
+  CHECK(normalize_sql("SELECT * FROM t WHERE id = 42 AND name='tom'") ==
+        "select * from t where id = ? and name=?");
+  CHECK(normalize_sql("select  *\n from t -- note\n where x=$1") ==
+        "select * from t where x=?");
+  CHECK(normalize_sql("select \"Col1\" from `T2` where v > 1.5e-3") ==
+        "select \"Col1\" from `T2` where v > ?");
+  CHECK(normalize_sql("select * from t where id in (1, 2, 3)") ==
+        "select * from t where id in (?+)");
+  CHECK(normalize_sql("insert into t values (1,'a'),(2,'b'), (3,'c')") ==
+        "insert into t values (?+)");
+  CHECK(normalize_sql("select 'it''s ?' /* ? */ from t2") ==
+        "select ? from t2");
+  CHECK(sql_fingerprint("select * from t where id=1") ==
+        sql_fingerprint("select *   from t where id=2"));
+  CHECK(sql_fingerprint("select * from t where id=1") !=
+        sql_fingerprint("select * from t2 where id=1"));
+  CHECK(normalize_sql("select (1, x), (?, ?) , (?)") ==
+        "select (?, x), (?+) , (?+)");
+  // hashed while normalizing, it must match the hash of the normalized text
+  for (std::string_view sql : {"insert into t values (1,'a'),(2,'b'), (3,'c')",
+                               "select (1, x), (?, ?) , (?)"}) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : normalize_sql(sql)) {
+      hash ^= c;
+      hash *= 1099511628211ull;
+    }
+    CHECK(sql_fingerprint(sql) == hash);
+  }
+}
+
+TEST_CASE("latency sketch quantiles") {
+  latency_sketch sketch;
+  CHECK(sketch.quantile(0.99).count() == 0);
+  for (int i = 1; i <= 1000; ++i) {
+    sketch.add(std::chrono::microseconds(i));
+  }
+  CHECK(sketch.count() == 1000);
+  auto p99 = sketch.quantile(0.99).count();
+  CHECK(p99 >= 990000);
+  CHECK(p99 <= 990000 * 5 / 4);
+  auto p50 = sketch.quantile(0.5).count();
+  CHECK(p50 >= 500000);
+  CHECK(p50 <= 500000 * 5 / 4);
+}
+
+#ifdef ORMPP_ENABLE_TRACE
+TEST_CASE("query stats aggregate sqlite statements") {
+  auto &stats = query_stats::instance();
+  stats.reset();
+  std::vector<std::string> slow;
+  stats.set_slow_threshold(std::chrono::nanoseconds(1));
+  stats.set_slow_logger([&](const query_trace &trace) {
+    slow.emplace_back(trace.sql);
+  });
+  stats.enable();
+  CHECK(stats.enabled());
+
+  dbng<sqlite> sqlite;
+  REQUIRE(sqlite.connect(db));
+  REQUIRE(sqlite.execute("drop table if exists trace_person"));
+  REQUIRE(sqlite.create_datatable<trace_person>(ormpp_auto_key{"id"}));
+  for (int i = 0; i < 3; ++i) {
+    REQUIRE(sqlite.execute("insert into trace_person(name, age) values('p" +
+                           std::to_string(i) + "', " + std::to_string(i) +
+                           ")"));
+  }
+  CHECK(!sqlite.execute("select * from no_such_table where id=1"));
+  CHECK(!sqlite.execute("select * from no_such_table where id=2"));
+
+  auto v = stats.snapshot();
+  auto find = [&v](std::string_view prefix) -> const query_stat * {
+    for (auto &stat : v) {
+      if (stat.sql.starts_with(prefix)) {
+        return &stat;
+      }
+    }
+    return nullptr;
+  };
+  auto insert = find("insert into trace_person(name, age) values");
+  REQUIRE(insert != nullptr);
+  CHECK(insert->sql == "insert into trace_person(name, age) values(?+)");
+  CHECK(insert->db_type == DBType::sqlite);
+  CHECK(insert->calls == 3);
+  CHECK(insert->errors == 0);
+  CHECK(insert->rows == 3);
+  CHECK(insert->max_time <= insert->total_time);
+  CHECK(insert->p99_time.count() > 0);
+  auto failed = find("select * from no_such_table");
+  REQUIRE(failed != nullptr);
+  CHECK(failed->calls == 2);
+  CHECK(failed->errors == 2);
+  CHECK(slow.size() >= 5);
+
+  stats.enable(false);
+  stats.set_slow_threshold(std::chrono::nanoseconds(0));
+  stats.reset();
+  sqlite.execute("drop table if exists trace_person");
+  CHECK(stats.snapshot().empty());
+}
+
+TEST_CASE("query stats stay on while the tracer is removed") {
+  auto &stats = query_stats::instance();
+  for (int i = 0; i < 200; ++i) {
+    set_query_tracer([](const query_trace &) {});
+    stats.enable(false);
+    std::thread remove([] {
+      set_query_tracer(nullptr);
+    });
+    stats.enable(true);
+    remove.join();
+    REQUIRE(detail::query_tracer_enabled().load());
+  }
+
+  dbng<sqlite> sqlite;
+  REQUIRE(sqlite.connect(db));
+  stats.reset();
+  REQUIRE(sqlite.execute("drop table if exists no_such_table"));
+  CHECK(stats.snapshot().size() == 1);
+  stats.enable(false);
+  stats.reset();
+  CHECK(!detail::query_tracer_enabled().load());
+}
+#endif
+
+TEST_CASE("error state is per connection") {
+  dbng<sqlite> sqlite1;
+  dbng<sqlite> sqlite2;
+#ifdef SQLITE_HAS_CODEC
+  REQUIRE(sqlite1.connect(db, password));
+  REQUIRE(sqlite2.connect(db, password));
+#else
+  REQUIRE(sqlite1.connect(db));
+  REQUIRE(sqlite2.connect(db));
+#endif
+  sqlite1.execute("drop table if exists person");
+  REQUIRE(sqlite1.create_datatable<person>(ormpp_auto_key{"id"},
+                                           ormpp_unique{{"name", "age"}}));
+  CHECK(!sqlite1.get_error());
+  CHECK(sqlite1.get_error().code == db_errc::ok);
+
+  REQUIRE(sqlite1.insert<person>({"purecpp", 1}) == 1);
+  CHECK(sqlite1.insert<person>({"purecpp", 1}) == INT_MIN);
+  CHECK(sqlite1.has_error());
+  CHECK(sqlite1.get_error().code == db_errc::constraint);
+  CHECK(sqlite1.get_error().native_code != 0);
+  CHECK(!sqlite1.get_last_error().empty());
+  CHECK(!sqlite2.has_error());
+  CHECK(sqlite2.get_last_error().empty());
+
+  CHECK(!sqlite2.execute("select * from no_such_table"));
+  CHECK(sqlite2.get_error().code == db_errc::statement);
+  CHECK(sqlite1.get_error().code == db_errc::constraint);
+
+  CHECK(sqlite1.query_s<person>().size() == 1);
+  CHECK(!sqlite1.has_error());
+  CHECK(sqlite2.has_error());
+  CHECK(to_string(db_errc::constraint) == "constraint");
+  sqlite1.execute("drop table if exists person");
+}
+
+TEST_CASE("parallel query over connection_pool") {
+  const char *parallel_db = "test_parallel_query.db";
+  dbng<sqlite> setup;
+  REQUIRE(setup.connect(parallel_db));
+  setup.execute("drop table if exists person");
+  REQUIRE(setup.create_datatable<person>(ormpp_auto_key{"id"}));
+  std::vector<person> people;
+  for (int i = 0; i < 100; ++i) {
+    people.push_back({"p" + std::to_string(i), i, 0});
+  }
+  REQUIRE(setup.insert(people) == 100);
+
+  auto &pool = connection_pool<dbng<sqlite>>::instance();
+  pool.init(3, "", "", "", parallel_db);
+  std::vector<std::pair<int, int>> ranges;
+  for (int i = 1; i <= 100; i += 10) {
+    ranges.emplace_back(i, i + 10);
+  }
+  auto slice = [](dbng<sqlite> &db, const std::pair<int, int> &r) {
+    return db.query_s<person>("id >= ? and id < ? order by id", r.first,
+                              r.second);
+  };
+
+  auto rows = parallel_query(pool, ranges, slice, 3);
+  REQUIRE(rows.size() == 100);
+  for (int i = 0; i < 100; ++i) {
+    CHECK(rows[i].id == i + 1);
+  }
+  CHECK(pool.size() == 3);
+
+  std::atomic<size_t> streamed = 0;
+  parallel_query_each(
+      pool, ranges, slice,
+      [&streamed](size_t, std::vector<person> &&part) {
+        streamed += part.size();
+      },
+      2);
+  CHECK(streamed == 100);
+
+  auto failing = [](dbng<sqlite> &db, const std::pair<int, int> &r) {
+    if (r.first > 50) {
+      throw std::runtime_error("slice failed");
+    }
+    return db.query_s<person>("id >= ? and id < ?", r.first, r.second);
+  };
+  CHECK_THROWS_AS(parallel_query(pool, ranges, failing, 3), std::runtime_error);
+  CHECK(pool.size() == 3);
+
+  // a failed query returns no rows, it must not pass for an empty slice
+  auto missing = [](dbng<sqlite> &db, const std::pair<int, int> &r) {
+    if (r.first > 50) {
+      return db.query_s<person>("no_such_column = ?", r.first);
+    }
+    return db.query_s<person>("id >= ? and id < ?", r.first, r.second);
+  };
+  size_t failed_task = 0;
+  try {
+    parallel_query(pool, ranges, missing, 3);
+  } catch (const parallel_query_error &e) {
+    failed_task = e.task;
+    CHECK(e.error.code == db_errc::statement);
+  }
+  CHECK(failed_task > 4);
+  CHECK(pool.size() == 3);
+  setup.execute("drop table if exists person");
+}
+
+TEST_CASE("keyset pagination") {
+  dbng<sqlite> sqlite_db;
+  REQUIRE(sqlite_db.connect("test_keyset_pagination.db"));
+  sqlite_db.execute("drop table if exists person");
+  REQUIRE(sqlite_db.create_datatable<person>(ormpp_auto_key{"id"}));
+  std::vector<person> people;
+  for (int i = 0; i < 25; ++i) {
+    people.push_back({"p" + std::to_string(i), i % 5, 0});
+  }
+  REQUIRE(sqlite_db.insert(people) == 25);
+
+  auto l = sqlite_db.select(all)
+               .from<person>()
+               .after(col(&person::id), 20)
+               .limit(3)
+               .collect();
+  REQUIRE(l.size() == 3);
+  CHECK(l.front().id == 21);
+  CHECK(l.back().id == 23);
+
+  auto pager = sqlite_db.select(all).from<person>().paginate_by(
+      col(&person::id), 10);
+  std::vector<size_t> sizes;
+  int expected = 1;
+  for (auto &page : pager) {
+    sizes.push_back(page.size());
+    for (auto &p : page) {
+      CHECK(p.id == expected++);
+    }
+  }
+  CHECK(sizes == std::vector<size_t>{10, 10, 5});
+  CHECK(pager.done());
+  CHECK(std::get<0>(*pager.last_key()) == 25);
+
+  auto resumed = pager.after(15).next();
+  REQUIRE(resumed.size() == 10);
+  CHECK(resumed.front().id == 16);
+
+  auto desc = sqlite_db.select(all).from<person>().paginate_by(
+      col(&person::id).desc(), 10);
+  CHECK(desc.next().front().id == 25);
+  CHECK(desc.next().front().id == 15);
+
+  auto by_age = sqlite_db.select(all)
+                    .from<person>()
+                    .where(col(&person::age) > 0)
+                    .paginate_by(col(&person::age), col(&person::id), 7);
+  std::vector<person> rows;
+  while (!by_age.done()) {
+    auto page = by_age.next();
+    rows.insert(rows.end(), page.begin(), page.end());
+  }
+  REQUIRE(rows.size() == 20);
+  for (size_t i = 1; i < rows.size(); ++i) {
+    CHECK(std::tie(rows[i - 1].age, rows[i - 1].id) <
+          std::tie(rows[i].age, rows[i].id));
+  }
+  CHECK(rows.front().age == 1);
+
+  CHECK_THROWS_AS(
+      sqlite_db.select(all).from<person>().paginate_by(col(&person::id), 0),
+      std::invalid_argument);
+  sqlite_db.execute("drop table if exists person");
+}
+
+TEST_CASE("bulk upsert") {
+  dbng<sqlite> sqlite_db;
+  REQUIRE(sqlite_db.connect("test_bulk_upsert.db"));
+  sqlite_db.execute("drop table if exists person");
+  REQUIRE(sqlite_db.create_datatable<person>(ormpp_auto_key{"id"}));
+  std::vector<person> people;
+  for (int i = 0; i < 5; ++i) {
+    people.push_back({"p" + std::to_string(i), i, 0});
+  }
+  REQUIRE(sqlite_db.insert(people) == 5);
+
+  // ids 1..5 exist, 6..8 are new, 3 rows per statement
+  std::vector<person> rows;
+  for (int id = 1; id <= 8; ++id) {
+    rows.push_back({"new" + std::to_string(id), 100 + id, id});
+  }
+  CHECK(sqlite_db.upsert<person>()
+            .on_conflict(col(&person::id))
+            .update(col(&person::age))
+            .batch_size(3)
+            .execute(rows) == 8);
+  auto all_people = sqlite_db.query_s<person>("order by id");
+  REQUIRE(all_people.size() == 8);
+  CHECK(all_people[0].name == "p0");
+  CHECK(all_people[0].age == 101);
+  CHECK(all_people[7].name == "new8");
+  CHECK(all_people[7].age == 108);
+
+  // without a conflict key the upsert is refused
+  dbng<sqlite> no_key_db;
+  REQUIRE(no_key_db.connect("test_bulk_upsert.db"));
+  CHECK(no_key_db.upsert<simple>().execute({}) == INT_MIN);
+  CHECK(no_key_db.get_error().code == db_errc::invalid_argument);
+  sqlite_db.execute("drop table if exists person");
+
+  using namespace test_ns;
+  sqlite_db.execute("drop table if exists im_message_clear");
+  REQUIRE(sqlite_db.create_datatable<message_clear>(
+      ormpp_unique{{"room_id", "user_id"}}));
+  std::vector<message_clear> clears;
+  for (int64_t user = 1; user <= 4; ++user) {
+    clears.push_back({1, user, 10, 0, 0});
+  }
+  // REGISTER_CONFLICT_KEY(message_clear, room_id, user_id)
+  CHECK(sqlite_db.upsert<message_clear>().execute(clears) == 4);
+  for (auto &c : clears) {
+    c.message_id = 20;
+  }
+  clears.push_back({2, 1, 30, 0, 0});
+  CHECK(sqlite_db.upsert<message_clear>().execute(clears) == 5);
+  auto stored = sqlite_db.query_s<message_clear>("room_id=1");
+  REQUIRE(stored.size() == 4);
+  for (auto &c : stored) {
+    CHECK(c.message_id == 20);
+  }
+  sqlite_db.execute("drop table if exists im_message_clear");
+}
+
+TEST_CASE("mysql bulk_load") {
+#ifdef ORMPP_ENABLE_MYSQL
+  dbng<mysql> mysql;
+  if (mysql.connect(ip, username, password, db)) {
+    mysql.execute("drop table if exists person");
+    mysql.create_datatable<person>(ormpp_auto_key{"id"});
+    std::vector<person> people;
+    for (int i = 0; i < 1000; ++i) {
+      people.push_back({"p" + std::to_string(i), i, 0});
+    }
+    people[1].name = "tab\there\\ and\nnewline";
+    // bulk_load needs it on the server, off by default since 8.0
+    REQUIRE(mysql.execute("set global local_infile=1"));
+    int n = mysql.bulk_load<person>(people);
+    INFO(mysql.get_last_error());
+    REQUIRE(n == 1000);
+    auto rows = mysql.query_s<person>("order by id");
+    REQUIRE(rows.size() == 1000);
+    CHECK(rows[0].id == 1);
+    CHECK(rows[1].name == "tab\there\\ and\nnewline");
+    CHECK(rows[999].age == 999);
+
+    CHECK(mysql.bulk_load<person, &person::name>(
+              std::vector<person>{{"only_name", 1, 0}}) == 1);
+    auto named = mysql.query_s<person>("name=?", "only_name");
+    REQUIRE(named.size() == 1);
+    CHECK(named.front().age == 0);
+
+    // the client allows local files only during bulk_load
+    CHECK(!mysql.execute(
+        "load data local infile '/etc/hostname' into table person"));
+    mysql.execute("drop table if exists person");
+  }
+#endif
+}
+
+TEST_CASE("mysql grows result buffers for large values") {
+#ifdef ORMPP_ENABLE_MYSQL
+  dbng<mysql> mysql;
+  if (mysql.connect(ip, username, password, db)) {
+    mysql.execute("drop table if exists image");
+    mysql.create_datatable<image>();
+    std::vector<image> images(3);
+    for (int i = 0; i < 3; ++i) {
+      images[i].id = i + 1;
+    }
+    images[0].bin.assign(200, 'a');
+    images[1].bin.assign(100000, 'b');
+    images[1].bin[50000] = '\0';
+    images[2].bin.assign(10, 'c');
+    CHECK(mysql.insert(images) == 3);
+
+    // the buffer grows on the second row and is reused for the third
+    for (int round = 0; round < 2; ++round) {
+      auto vec = mysql.query_s<image>("order by id");
+      REQUIRE(vec.size() == 3);
+      CHECK(vec[0].bin == images[0].bin);
+      CHECK(vec[1].bin == images[1].bin);
+      CHECK(vec[2].bin == images[2].bin);
+    }
+    mysql.execute("drop table if exists image");
+  }
+#endif
+}
+
+#ifdef ORMPP_ENABLE_MYSQL
+TEST_CASE("mysql gives back result buffers grown past the retained size") {
+  mysql::column_buffer buf;
+  buf.reset(64);
+  CHECK(buf.data.size() == 64);
+  // a large value grows the buffer while it is fetched
+  buf.data.resize(8 * 1024 * 1024);
+  buf.reset(64);
+  CHECK(buf.data.size() == 64);
+  CHECK(buf.data.capacity() < 1024 * 1024);
+  // buffers below the limit are kept for the next rows
+  buf.data.resize(4096);
+  buf.reset(64);
+  CHECK(buf.data.size() == 4096);
+}
+#endif
+
+struct person_view {
+  std::string_view name;
+  int age;
+  int id;
+};
+
+struct image_view {
+  int id;
+  blob_view bin;
+};
+
+TEST_CASE("query_view keeps string_view fields per row") {
+  dbng<sqlite> sqlite_db;
+  REQUIRE(sqlite_db.connect("test_query_view.db"));
+  sqlite_db.execute("drop table if exists person");
+  REQUIRE(sqlite_db.create_datatable<person>(ormpp_auto_key{"id"}));
+  std::vector<person> people;
+  for (int i = 0; i < 100; ++i) {
+    people.push_back({"name_" + std::to_string(i), i, 0});
+  }
+  REQUIRE(sqlite_db.insert(people) == 100);
+
+  result_set<person_view> rows;
+  {
+    auto views = sqlite_db.query_view<person_view>(
+        "select name, age, id from person order by id");
+    REQUIRE(views.size() == 100);
+    rows = std::move(views);
+  }
+  // every row keeps its own text, also after the result was moved
+  for (size_t i = 0; i < rows.size(); ++i) {
+    CHECK(rows[i].name == "name_" + std::to_string(i));
+  }
+  auto filtered = sqlite_db.query_view<person_view>(
+      "select name, age, id from person where age > ?", 97);
+  REQUIRE(filtered.size() == 2);
+  CHECK(filtered.front().name == "name_98");
+
+  sqlite_db.execute("drop table if exists image");
+  REQUIRE(sqlite_db.create_datatable<image>());
+  image img{1};
+  img.bin.assign(300, 'x');
+  img.bin[10] = '\0';
+  REQUIRE(sqlite_db.insert(img) == 1);
+  auto images = sqlite_db.query_view<image_view>("select id, bin from image");
+  REQUIRE(images.size() == 1);
+  CHECK(std::equal(images.front().bin.begin(), images.front().bin.end(),
+                   img.bin.begin(), img.bin.end()));
+
+  sqlite_db.execute("drop table if exists person");
+  sqlite_db.execute("drop table if exists image");
+}
+
+TEST_CASE("string arena") {
+  string_arena arena(16);
+  auto a = arena.store("hello");
+  auto b = arena.store("world, longer than a chunk");
+  auto c = arena.store("!");
+  CHECK(a == "hello");
+  CHECK(b == "world, longer than a chunk");
+  CHECK(c == "!");
+  CHECK(arena.store("").empty());
+  CHECK(arena.chunk_count() == 3);
+}
+
+struct sale {
+  int id;
+  std::string region;
+  std::optional<int> amount;
+  double price;
+};
+
+TEST_CASE("query_columns and column helpers") {
+  dbng<sqlite> sqlite_db;
+  REQUIRE(sqlite_db.connect("test_query_columns.db"));
+  sqlite_db.execute("drop table if exists sale");
+  REQUIRE(sqlite_db.create_datatable<sale>(ormpp_auto_key{"id"}));
+  std::vector<sale> sales;
+  for (int i = 0; i < 10; ++i) {
+    std::optional<int> amount;
+    if (i % 3 != 0) {
+      amount = i * 10;
+    }
+    sales.push_back({0, i % 2 ? "east" : "west", amount, i + 0.5});
+  }
+  REQUIRE(sqlite_db.insert(sales) == 10);
+
+  auto cols = sqlite_db.query_columns<sale>("order by id");
+  REQUIRE(cols.size() == 10);
+  auto &ids = cols.column<&sale::id>();
+  auto &amounts = cols.column<&sale::amount>();
+  auto &amount_nulls = cols.nulls<&sale::amount>();
+  static_assert(std::is_same_v<decltype(amounts), const std::vector<int> &>);
+  CHECK(ids.front() == 1);
+  CHECK(ids.back() == 10);
+  CHECK(cols.column<1>()[1] == "east");
+  CHECK(amount_nulls[0] == 1);
+  CHECK(amount_nulls[1] == 0);
+
+  // 10+20+40+50+70+80
+  CHECK(column_sum(amounts, amount_nulls) == 270);
+  CHECK(column_min(amounts, amount_nulls) == 10);
+  CHECK(column_max(amounts, amount_nulls) == 80);
+  CHECK(column_sum(cols.column<&sale::price>()) == doctest::Approx(50.0));
+
+  // sum of amounts in the east
+  auto east =
+      column_filter(cols.column<&sale::region>(), amount_nulls,
+                    [](const std::string &region) {
+                      return region == "east";
+                    });
+  CHECK(column_sum(amounts, east) == 10 + 50 + 70);
+  auto none = column_filter(amounts, amount_nulls, [](int a) {
+    return a > 1000;
+  });
+  CHECK(!column_max(amounts, none).has_value());
+
+  auto filtered = sqlite_db.query_columns<sale>("amount > ?", 60);
+  CHECK(filtered.size() == 2);
+  sqlite_db.execute("drop table if exists sale");
+}
+
+TEST_CASE("export json and csv") {
+  dbng<sqlite> sqlite_db;
+  REQUIRE(sqlite_db.connect("test_export.db"));
+  sqlite_db.execute("drop table if exists sale");
+  REQUIRE(sqlite_db.create_datatable<sale>(ormpp_auto_key{"id"}));
+  std::vector<sale> sales{{0, "east", 10, 1.5},
+                          {0, "west, \"north\"", {}, 2},
+                          {0, "south", 30, 0.25}};
+  REQUIRE(sqlite_db.insert(sales) == 3);
+
+  std::string json;
+  CHECK(sqlite_db.export_json<sale>("order by id", string_sink(json)));
+  CHECK(json ==
+        R"([{"id":1,"region":"east","amount":10,"price":1.5E0},)"
+        R"({"id":2,"region":"west, \"north\"","amount":null,"price":2E0},)"
+        R"({"id":3,"region":"south","amount":30,"price":2.5E-1}])");
+
+  std::string csv;
+  CHECK(sqlite_db.export_csv<sale>("amount is null or amount > ?",
+                                   string_sink(csv), 20));
+  CHECK(csv ==
+        "id,region,amount,price\r\n"
+        "2,\"west, \"\"north\"\"\",,2\r\n"
+        "3,south,30,0.25\r\n");
+
+  // a result bigger than a chunk reaches the sink in pieces
+  std::vector<sale> many(5000, sale{0, "region", 1, 1});
+  REQUIRE(sqlite_db.insert(many) == 5000);
+  size_t chunks = 0;
+  size_t bytes = 0;
+  CHECK(sqlite_db.export_csv<sale>("", [&](std::string_view chunk) {
+    ++chunks;
+    bytes += chunk.size();
+  }));
+  CHECK(chunks > 1);
+  CHECK(bytes > export_chunk_size);
+
+  size_t rows = 0;
+  CHECK(sqlite_db.query_each<sale>("", [&rows](const sale &) {
+    ++rows;
+  }));
+  CHECK(rows == 5003);
+  CHECK(!sqlite_db.export_json<sale>("select * from no_such_table",
+                                     string_sink(json)));
+  sqlite_db.execute("drop table if exists sale");
+}
+
+TEST_CASE("query_each rejects statements on its own connection") {
+  dbng<sqlite> sqlite_db;
+  REQUIRE(sqlite_db.connect("test_export.db"));
+  sqlite_db.execute("drop table if exists sale");
+  REQUIRE(sqlite_db.create_datatable<sale>(ormpp_auto_key{"id"}));
+  std::vector<sale> sales(5, sale{0, "east", 10, 1.5});
+  REQUIRE(sqlite_db.insert(sales) == 5);
+
+  size_t rows = 0;
+  size_t rejected = 0;
+  CHECK(sqlite_db.query_each<sale>("order by id", [&](const sale &s) {
+    ++rows;
+    CHECK(s.id == (int)rows);
+    if (sqlite_db.query_s<sale>("id = ?", s.id).empty() &&
+        sqlite_db.get_error().code == db_errc::invalid_argument) {
+      ++rejected;
+    }
+    CHECK(!sqlite_db.execute("delete from sale"));
+  }));
+  CHECK(rows == 5);
+  CHECK(rejected == 5);
+
+  // the connection is usable again once the rows are read
+  CHECK(sqlite_db.query_s<sale>().size() == 5);
+  sqlite_db.execute("drop table if exists sale");
+}
+
+TEST_CASE("export length-delimited protobuf") {
+  dbng<sqlite> sqlite_db;
+  REQUIRE(sqlite_db.connect("test_export.db"));
+  sqlite_db.execute("drop table if exists sale");
+  REQUIRE(sqlite_db.create_datatable<sale>(ormpp_auto_key{"id"}));
+  std::vector<sale> sales;
+  for (int i = 0; i < 300; ++i) {
+    sales.push_back({0, std::string(i, 'r'), i, i * 0.5});
+  }
+  REQUIRE(sqlite_db.insert(sales) == 300);
+
+  std::string out;
+  CHECK(sqlite_db.export_pb<sale>("order by id", string_sink(out)));
+  std::string_view rest = out;
+  std::vector<sale> decoded;
+  while (!rest.empty()) {
+    size_t pos = 0;
+    auto len = iguana::detail::decode_varint(rest, pos);
+    rest.remove_prefix(pos);
+    sale s{};
+    iguana::from_pb(s, rest.substr(0, len));
+    decoded.push_back(std::move(s));
+    rest.remove_prefix(len);
+  }
+  REQUIRE(decoded.size() == 300);
+  CHECK(decoded[0].id == 1);
+  CHECK(decoded[299].region == std::string(299, 'r'));
+  CHECK(decoded[299].amount == 299);
+  CHECK(decoded[10].price == 5.0);
+  sqlite_db.execute("drop table if exists sale");
+}
+
+struct ledger {
+  int id;
+  std::chrono::system_clock::time_point created;
+  std::chrono::year_month_day due;
+  ormpp::decimal<2> amount;
+  std::optional<std::chrono::sys_seconds> settled;
+};
+// chrono members hide the field count from aggregate reflection
+YLT_REFL(ledger, id, created, due, amount, settled);
+
+TEST_CASE("temporal and decimal columns") {
+  using namespace std::chrono;
+  auto amount = ormpp::decimal<2>::parse("-1234.5");
+  REQUIRE(amount.has_value());
+  CHECK(amount->unscaled() == -123450);
+  CHECK(amount->to_string() == "-1234.50");
+  CHECK(ormpp::decimal<2>::parse("0.129")->to_string() == "0.12");
+  CHECK(!ormpp::decimal<2>::parse("12a").has_value());
+  CHECK(!ormpp::decimal<2>::parse("1234567890123456789").has_value());
+
+  sys_time<microseconds> tp;
+  REQUIRE(ormpp::detail::sql_types::parse_timestamp("2024-02-29 23:59:58.5",
+                                                    tp));
+  std::string text;
+  ormpp::append_sql_text(text, tp);
+  CHECK(text == "2024-02-29 23:59:58.500000");
+  year_month_day ymd;
+  CHECK(!ormpp::detail::sql_types::parse_date("2023-02-29", ymd));
+
+  dbng<sqlite> sqlite_db;
+  REQUIRE(sqlite_db.connect("test_temporal.db"));
+  sqlite_db.execute("drop table if exists ledger");
+  REQUIRE(sqlite_db.create_datatable<ledger>(ormpp_auto_key{"id"}));
+  auto created = time_point_cast<system_clock::duration>(tp);
+  ledger row{0, created, 2024y / March / 31d, *amount, std::nullopt};
+  REQUIRE(sqlite_db.insert(row) == 1);
+  row.settled = sys_days(2024y / April / 1d) + 12h;
+  row.amount = ormpp::decimal<2>::from_unscaled(5);
+  REQUIRE(sqlite_db.insert(row) == 1);
+
+  auto rows = sqlite_db.query_s<ledger>("due = ? order by id",
+                                        2024y / March / 31d);
+  REQUIRE(rows.size() == 2);
+  CHECK(rows[0].created == created);
+  CHECK(rows[0].due == 2024y / March / 31d);
+  CHECK(rows[0].amount == *amount);
+  CHECK(!rows[0].settled.has_value());
+  CHECK(rows[1].settled == sys_days(2024y / April / 1d) + 12h);
+  CHECK(rows[1].amount.to_string() == "0.05");
+
+  // stored as integers, so they compare in sql
+  auto later = sqlite_db.query_s<ledger>("created > ?", created - 1s);
+  CHECK(later.size() == 2);
+  sqlite_db.execute("drop table if exists ledger");
+
+#if defined(ORMPP_ENABLE_MYSQL) || defined(ORMPP_ENABLE_PG)
+  // a value that does not parse is reset, not carried over from the row
+  // before it, and reported
+  using amount_row = std::tuple<int, ormpp::decimal<2>>;
+  const char *bad_amount = "select 1, '1.50' union all select 2, 'abc'";
+#endif
+#ifdef ORMPP_ENABLE_MYSQL
+  dbng<mysql> mysql;
+  if (mysql.connect(ip, username, password, db)) {
+    auto amounts = mysql.query_s<amount_row>(bad_amount);
+    REQUIRE(amounts.size() == 2);
+    CHECK(std::get<1>(amounts[0]).unscaled() == 150);
+    CHECK(std::get<1>(amounts[1]) == ormpp::decimal<2>{});
+    CHECK(mysql.get_error().code == db_errc::protocol);
+  }
+#endif
+#ifdef ORMPP_ENABLE_PG
+  dbng<postgresql> postgres;
+  if (postgres.connect(ip, username, password, db)) {
+    auto amounts = postgres.query_s<amount_row>(bad_amount);
+    REQUIRE(amounts.size() == 2);
+    CHECK(std::get<1>(amounts[0]).unscaled() == 150);
+    CHECK(std::get<1>(amounts[1]) == ormpp::decimal<2>{});
+    CHECK(postgres.get_error().code == db_errc::protocol);
+  }
+#endif
+}
+
+struct article_tag {
+  std::string name;
+  int weight;
+  bool operator==(const article_tag &) const = default;
+};
+
+struct article {
+  int id;
+  std::vector<int64_t> reader_ids;
+  std::vector<std::string> keywords;
+  article_tag main_tag;
+  lazy_column<std::vector<article_tag>> tags;
+};
+
+TEST_CASE("array and json columns") {
+  auto names = get_type_names<article>(DBType::postgresql);
+  CHECK(names[1] == "bigint[]");
+  CHECK(names[2] == "text[]");
+  CHECK(names[3] == "jsonb");
+  CHECK(names[4] == "jsonb");
+  CHECK(get_type_names<article>(DBType::mysql)[4] == "JSON");
+
+  std::vector<std::string> words;
+  REQUIRE(parse_column_text(R"({a,"b c","d\"e",NULL})", words,
+                            column_text::pg_array));
+  CHECK(words == std::vector<std::string>{"a", "b c", "d\"e", ""});
+  std::string literal;
+  append_column_text(literal, words, column_text::pg_array);
+  CHECK(literal == R"({"a","b c","d\"e",""})");
+  std::vector<int64_t> ids;
+  CHECK(parse_column_text("{}", ids, column_text::pg_array));
+  CHECK(!parse_column_text("{1,x}", ids, column_text::pg_array));
+
+  dbng<sqlite> sqlite_db;
+  REQUIRE(sqlite_db.connect("test_json_columns.db"));
+  sqlite_db.execute("drop table if exists article");
+  REQUIRE(sqlite_db.create_datatable<article>(ormpp_auto_key{"id"}));
+  article a{0,
+            {3, 1, 2},
+            {"orm", "c++"},
+            {"db", 2},
+            std::vector<article_tag>{{"sql", 1}, {"json", 5}}};
+  REQUIRE(sqlite_db.insert(a) == 1);
+
+  auto rows = sqlite_db.query_s<article>();
+  REQUIRE(rows.size() == 1);
+  auto &row = rows.front();
+  CHECK(row.reader_ids == std::vector<int64_t>{3, 1, 2});
+  CHECK(row.keywords == a.keywords);
+  CHECK(row.main_tag == article_tag{"db", 2});
+  CHECK(!row.tags.decoded());
+  CHECK(row.tags->size() == 2);
+  CHECK(row.tags.decoded());
+  CHECK(row.tags.get()[1] == article_tag{"json", 5});
+
+  // written back without being decoded
+  auto copy = sqlite_db.query_s<article>().front();
+  copy.id = 0;
+  REQUIRE(sqlite_db.insert(copy) == 1);
+  CHECK(!copy.tags.decoded());
+  auto both = sqlite_db.query_s<article>("order by id");
+  REQUIRE(both.size() == 2);
+  CHECK(both[1].tags == row.tags);
+  sqlite_db.execute("drop table if exists article");
+}
+
+struct order_item {
+  int id;
+  int order_id;
+  std::string sku;
+};
+
+struct customer_order {
+  int id;
+  std::string customer;
+  std::vector<order_item> items;
+};
+// items is loaded by the relation, it is not a column
+YLT_REFL(customer_order, id, customer);
+REGISTER_AUTO_KEY(customer_order, id);
+REGISTER_RELATION(customer_order, items, order_item::order_id);
+
+TEST_CASE("relations load children with one query") {
+  dbng<sqlite> sqlite_db;
+  REQUIRE(sqlite_db.connect("test_relation.db"));
+  sqlite_db.execute("drop table if exists customer_order");
+  sqlite_db.execute("drop table if exists order_item");
+  REQUIRE(sqlite_db.create_datatable<customer_order>(ormpp_auto_key{"id"}));
+  REQUIRE(sqlite_db.create_datatable<order_item>(ormpp_auto_key{"id"}));
+  for (auto name : {"tom", "ann", "bob"}) {
+    REQUIRE(sqlite_db.insert(customer_order{0, name, {}}) == 1);
+  }
+  std::vector<order_item> items{
+      {0, 1, "pen"}, {0, 2, "ink"}, {0, 1, "cup"}, {0, 9, "lost"}};
+  REQUIRE(sqlite_db.insert(items) == 4);
+
+  auto orders = sqlite_db.select(ormpp::all)
+                    .from<customer_order>()
+                    .where(col(&customer_order::id) < 3)
+                    .with<&customer_order::items>()
+                    .collect();
+  REQUIRE(orders.size() == 2);
+  REQUIRE(orders[0].items.size() == 2);
+  CHECK(orders[0].items[0].sku == "pen");
+  CHECK(orders[0].items[1].sku == "cup");
+  REQUIRE(orders[1].items.size() == 1);
+  CHECK(orders[1].items[0].sku == "ink");
+
+  auto all_orders = sqlite_db.query_s<customer_order>();
+  REQUIRE(all_orders.size() == 3);
+  CHECK(sqlite_db.load_relations<&customer_order::items>(all_orders));
+  CHECK(all_orders[0].items.size() == 2);
+  CHECK(all_orders[2].items.empty());
+
+  // more parents than keys per query
+  std::vector<customer_order> many(relation_batch_size + 1);
+  REQUIRE(sqlite_db.insert(many) == (int)many.size());
+  items.assign({{0, (int)relation_batch_size + 4, "far"}});
+  REQUIRE(sqlite_db.insert(items) == 1);
+  all_orders = sqlite_db.query_s<customer_order>("order by id");
+  REQUIRE(all_orders.size() == relation_batch_size + 4);
+  CHECK(sqlite_db.load_relations<&customer_order::items>(all_orders));
+  CHECK(all_orders[0].items.size() == 2);
+  REQUIRE(all_orders.back().items.size() == 1);
+  CHECK(all_orders.back().items[0].sku == "far");
+
+  // a failed relation query fails the select
+  sqlite_db.execute("drop table if exists order_item");
+  orders = sqlite_db.select(ormpp::all)
+               .from<customer_order>()
+               .with<&customer_order::items>()
+               .collect();
+  CHECK(orders.empty());
+  CHECK(sqlite_db.has_error());
+
+  sqlite_db.execute("drop table if exists customer_order");
+  sqlite_db.execute("drop table if exists order_item");
+}
+
+struct ledger_account {
+  int id;
+  std::string owner;
+  int balance;
+  std::string note;
+};
+REGISTER_AUTO_KEY(ledger_account, id)
+
+TEST_CASE("session flushes only the changed columns") {
+  dbng<sqlite> sqlite_db;
+  REQUIRE(sqlite_db.connect("test_session.db"));
+  sqlite_db.execute("drop table if exists ledger_account");
+  REQUIRE(sqlite_db.create_datatable<ledger_account>(ormpp_auto_key{"id"}));
+  std::vector<ledger_account> rows{
+      {0, "tom", 10, ""}, {0, "ann", 20, ""}, {0, "bob", 30, ""}};
+  REQUIRE(sqlite_db.insert(rows) == 3);
+
+  auto s = sqlite_db.session();
+  auto accounts = s.query<ledger_account>("order by id");
+  REQUIRE(accounts.size() == 3);
+  CHECK(s.flush() == 0);
+
+  accounts[0]->balance += 5;
+  accounts[1]->balance += 5;
+  accounts[2]->note = "vip";
+  // the same rows are handed out again, with the pending changes
+  auto again = s.query<ledger_account>("id = ?", 1);
+  REQUIRE(again.size() == 1);
+  CHECK(again[0] == accounts[0]);
+  CHECK(again[0]->balance == 15);
+  CHECK(s.size() == 3);
+
+  // columns the session did not change are left as they are in the table
+  REQUIRE(sqlite_db.execute("update ledger_account set note='x' where id=1"));
+  REQUIRE(sqlite_db.execute("update ledger_account set balance=99 "
+                            "where id=3"));
+  CHECK(s.flush() == 3);
+  auto stored = sqlite_db.query_s<ledger_account>("order by id");
+  REQUIRE(stored.size() == 3);
+  CHECK(stored[0].balance == 15);
+  CHECK(stored[0].note == "x");
+  CHECK(stored[1].balance == 25);
+  CHECK(stored[2].balance == 99);
+  CHECK(stored[2].note == "vip");
+  CHECK(s.flush() == 0);
+
+  // a failed flush rolls back and keeps the rows dirty
+  accounts[0]->owner = "tim";
+  REQUIRE(sqlite_db.execute("drop table ledger_account"));
+  CHECK(s.flush() == INT_MIN);
+  CHECK(sqlite_db.has_error());
+  REQUIRE(sqlite_db.create_datatable<ledger_account>(ormpp_auto_key{"id"}));
+  REQUIRE(sqlite_db.insert(stored) == 3);
+  CHECK(s.flush() == 1);
+  CHECK(sqlite_db.query_s<ledger_account>("id = ?", 1).front().owner == "tim");
+  sqlite_db.execute("drop table if exists ledger_account");
+}
+
+// a second struct on the ledger_account table
+struct ledger_balance {
+  int id;
+  int balance;
+  static constexpr std::string_view get_alias_struct_name(ledger_balance *) {
+    return "ledger_account";
+  }
+};
+REGISTER_AUTO_KEY(ledger_balance, id)
+
+TEST_CASE("session keeps structs sharing a table apart") {
+  dbng<sqlite> sqlite_db;
+  REQUIRE(sqlite_db.connect("test_session.db"));
+  sqlite_db.execute("drop table if exists ledger_account");
+  REQUIRE(sqlite_db.create_datatable<ledger_account>(ormpp_auto_key{"id"}));
+  REQUIRE(sqlite_db.insert(ledger_account{0, "tom", 10, ""}) == 1);
+
+  auto s = sqlite_db.session();
+  auto accounts = s.query<ledger_account>();
+  auto balances = s.query<ledger_balance>();
+  REQUIRE(accounts.size() == 1);
+  REQUIRE(balances.size() == 1);
+  CHECK(s.size() == 2);
+  CHECK(balances[0]->balance == 10);
+  accounts[0]->note = "vip";
+  CHECK(s.flush() == 1);
+  balances[0]->balance = 12;
+  CHECK(s.flush() == 1);
+  auto row = sqlite_db.query_s<ledger_account>().front();
+  CHECK(row.note == "vip");
+  CHECK(row.balance == 12);
+  sqlite_db.execute("drop table if exists ledger_account");
+}
+
+struct ledger_entry {
+  int id;
+  std::string text;
+};
+
+struct ledger_blob {
+  ormpp::blob digest;
+  int amount;
+};
+REGISTER_CONFLICT_KEY(ledger_blob, digest)
+
+TEST_CASE("session refuses rows it can not tell apart") {
+  dbng<sqlite> sqlite_db;
+  REQUIRE(sqlite_db.connect("test_session.db"));
+  auto s = sqlite_db.session();
+  // no conflict key
+  CHECK(s.query<ledger_entry>().empty());
+  CHECK(sqlite_db.get_error().code == db_errc::invalid_argument);
+  CHECK(s.attach(ledger_entry{1, "a"}) == nullptr);
+  // a key without a usable value
+  CHECK(s.attach(ledger_blob{{'a'}, 1}) == nullptr);
+  CHECK(sqlite_db.get_error().code == db_errc::invalid_argument);
+  CHECK(s.size() == 0);
+}
+
+TEST_CASE("update_changed writes only the differing columns") {
+  dbng<sqlite> sqlite_db;
+  REQUIRE(sqlite_db.connect("test_session.db"));
+  sqlite_db.execute("drop table if exists ledger_account");
+  REQUIRE(sqlite_db.create_datatable<ledger_account>(ormpp_auto_key{"id"}));
+  REQUIRE(sqlite_db.insert(ledger_account{0, "tom", 10, ""}) == 1);
+
+  auto before = sqlite_db.query_s<ledger_account>().front();
+  auto after = before;
+  CHECK(sqlite_db.update_changed(before, after) == 0);
+
+  after.balance = 12;
+  REQUIRE(sqlite_db.execute("update ledger_account set note='x'"));
+  CHECK(sqlite_db.update_changed(before, after) == 1);
+  auto row = sqlite_db.query_s<ledger_account>().front();
+  CHECK(row.balance == 12);
+  CHECK(row.note == "x");
+
+  // the same columns again, through the kept statement
+  before = after;
+  after.balance = 13;
+  CHECK(sqlite_db.update_changed(before, after) == 1);
+  after.owner = "tim";
+  CHECK(sqlite_db.update_changed(before, after) == 1);
+  row = sqlite_db.query_s<ledger_account>().front();
+  CHECK(row.balance == 13);
+  CHECK(row.owner == "tim");
+
+  // a rejected row leaves the kept statement usable
+  REQUIRE(sqlite_db.execute(
+      "create trigger ledger_no_debt before update on ledger_account when "
+      "new.balance < 0 begin select raise(abort, 'no debt'); end"));
+  before = after;
+  after.balance = -1;
+  CHECK(sqlite_db.update_changed(before, after) == INT_MIN);
+  CHECK(sqlite_db.get_error().code == db_errc::constraint);
+  after.balance = 13;
+  after.owner = "tom";
+  CHECK(sqlite_db.update_changed(before, after) == 1);
+  CHECK(sqlite_db.query_s<ledger_account>().front().owner == "tom");
+
+  auto moved = after;
+  moved.id = 2;
+  CHECK(sqlite_db.update_changed(after, moved) == INT_MIN);
+  CHECK(sqlite_db.get_error().code == db_errc::invalid_argument);
+
+  // a kept statement whose table is gone fails once and is prepared again
+  REQUIRE(sqlite_db.execute("drop table ledger_account"));
+  before = after;
+  after.balance = 14;
+  CHECK(sqlite_db.update_changed(before, after) == INT_MIN);
+  REQUIRE(sqlite_db.create_datatable<ledger_account>(ormpp_auto_key{"id"}));
+  REQUIRE(sqlite_db.insert(row) == 1);
+  CHECK(sqlite_db.update_changed(before, after) == 1);
+  CHECK(sqlite_db.query_s<ledger_account>().front().balance == 14);
+
+  // a struct sharing the table gets its own statement for the same mask
+  ledger_balance old_balance{1, 14};
+  auto new_balance = old_balance;
+  new_balance.balance = 15;
+  CHECK(sqlite_db.update_changed(old_balance, new_balance) == 1);
+  row = sqlite_db.query_s<ledger_account>().front();
+  CHECK(row.balance == 15);
+  CHECK(row.owner == "tim");
+  sqlite_db.execute("drop table if exists ledger_account");
+
+#ifdef ORMPP_ENABLE_PG
+  dbng<postgresql> postgres;
+  if (postgres.connect(ip, username, password, db)) {
+    postgres.execute("drop table if exists ledger_account");
+    REQUIRE(postgres.create_datatable<ledger_account>(ormpp_auto_key{"id"}));
+    REQUIRE(postgres.execute(
+        "create unique index ledger_owner on ledger_account(owner)"));
+    REQUIRE(postgres.insert(ledger_account{0, "tom", 10, ""}) == 1);
+    REQUIRE(postgres.insert(ledger_account{0, "tim", 10, ""}) == 1);
+    auto rows = postgres.query_s<ledger_account>("order by id");
+    REQUIRE(rows.size() == 2);
+    auto changed = rows[1];
+    changed.owner = "tom";
+    REQUIRE(postgres.begin());
+    CHECK(postgres.update_changed(rows[1], changed) == INT_MIN);
+    CHECK(postgres.get_error().code == db_errc::constraint);
+    REQUIRE(postgres.rollback());
+    changed.owner = "tam";
+    CHECK(postgres.update_changed(rows[1], changed) == 1);
+    // still the one statement, nothing left prepared twice
+    auto prepared = postgres.query_s<std::tuple<int>>(
+        "select count(1) from pg_prepared_statements where name like "
+        "'ormpp_update_%'");
+    REQUIRE(prepared.size() == 1);
+    CHECK(std::get<0>(prepared.front()) == 1);
+    postgres.execute("drop table if exists ledger_account");
+  }
+#endif
+}
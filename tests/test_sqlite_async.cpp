@@ -0,0 +1,415 @@
+#ifdef ORMPP_ENABLE_SQLITE_ASYNC
+
+#include <asio.hpp>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "async_connection_pool.hpp"
+#include "dbng.hpp"
+#include "doctest.h"
+#include "parallel_query.hpp"
+#include "sharded_async_connection_pool.hpp"
+#include "sqlite_async.hpp"
+
+using namespace ormpp;
+
+namespace {
+
+struct async_person {
+  int id;
+  std::string name;
+  int age;
+};
+REGISTER_AUTO_KEY(async_person, id)
+
+constexpr const char *async_db = "test_sqlite_async.db";
+
+template <typename F>
+void run_test(F &&f) {
+  asio::io_context ctx;
+  asio::co_spawn(ctx, std::forward<F>(f)(ctx.get_executor()),
+                 [](std::exception_ptr ep) {
+                   if (ep) {
+                     std::rethrow_exception(ep);
+                   }
+                 });
+  ctx.run();
+}
+
+}  // namespace
+
+TEST_CASE("sqlite async: crud and builder") {
+  run_test([](asio::any_io_executor ex) -> asio::awaitable<void> {
+    sqlite_async db(ex);
+    bool ok = co_await db.ping();
+    CHECK(!ok);
+    ok = co_await db.connect(async_db);
+    REQUIRE(ok);
+    ok = co_await db.ping();
+    CHECK(ok);
+    co_await db.execute("drop table if exists async_person");
+    // aggregates are kept in locals, gcc 12 mishandles their temporaries in
+    // co_await expressions
+    ormpp_auto_key key{"id"};
+    ok = co_await db.create_datatable<async_person>(key);
+    REQUIRE(ok);
+
+    auto caller = std::this_thread::get_id();
+    async_person tom{0, "tom", 20};
+    int n = co_await db.insert(tom);
+    CHECK(n == 1);
+    CHECK(std::this_thread::get_id() == caller);
+
+    std::vector<async_person> v{{0, "jack", 30}, {0, "mike", 40}};
+    n = co_await db.insert(v);
+    CHECK(n == 2);
+    async_person lily{0, "lily", 50};
+    auto id = co_await db.get_insert_id_after_insert(lily);
+    CHECK(id == 4);
+
+    auto people = co_await db.query_s<async_person>();
+    CHECK(people.size() == 4);
+    auto one = co_await db.query_s<async_person>("name=?", "jack");
+    REQUIRE(one.size() == 1);
+    CHECK(one.front().age == 30);
+
+    one.front().age = 31;
+    n = co_await db.update(one.front());
+    CHECK(n == 1);
+    CHECK(db.get_last_affect_rows() == 1);
+
+    auto older_task = db.select(all)
+                          .from<async_person>()
+                          .where(col(&async_person::age) > 30)
+                          .collect();
+    auto older = co_await std::move(older_task);
+    CHECK(older.size() == 3);
+    auto total =
+        co_await db.select(count()).from<async_person>().collect<uint64_t>();
+    CHECK(total == 4);
+
+    auto removed = co_await db.delete_records_s<async_person>("name=?", "tom");
+    CHECK(removed == 1);
+    people = co_await db.query_s<async_person>();
+    CHECK(people.size() == 3);
+
+    auto pager = db.select(all).from<async_person>().paginate_by(
+        col(&async_person::id), 2);
+    auto page = co_await pager.next();
+    CHECK(page.size() == 2);
+    page = co_await pager.next();
+    REQUIRE(page.size() == 1);
+    CHECK(page.front().name == "lily");
+    CHECK(pager.done());
+
+    ok = co_await db.execute("select * from no_such_table");
+    CHECK(!ok);
+    CHECK(db.has_error());
+    CHECK(db.get_error().code == db_errc::statement);
+
+    ok = co_await db.begin();
+    REQUIRE(ok);
+    async_person tmp{0, "tmp", 1};
+    n = co_await db.insert(tmp);
+    CHECK(n == 1);
+    ok = co_await db.rollback();
+    REQUIRE(ok);
+    people = co_await db.query_s<async_person>();
+    CHECK(people.size() == 3);
+
+    co_await db.execute("drop table if exists async_person");
+  });
+}
+
+TEST_CASE("sqlite async: runs on the worker and works with the pool") {
+  run_test([](asio::any_io_executor ex) -> asio::awaitable<void> {
+    pool_options options;
+    options.log_pool_exhaustion = false;
+    auto pool =
+        std::make_shared<async_connection_pool<sqlite_async>>(ex, options);
+    bool ok = co_await pool->init(2, "", "", "", async_db);
+    REQUIRE(ok);
+
+    auto conn = co_await pool->get();
+    REQUIRE(conn != nullptr);
+    auto caller = std::this_thread::get_id();
+    auto worker = co_await conn->run([](sqlite &) {
+      return std::this_thread::get_id();
+    });
+    CHECK(worker != caller);
+    CHECK(std::this_thread::get_id() == caller);
+    auto again = co_await conn->run([](sqlite &) {
+      return std::this_thread::get_id();
+    });
+    CHECK(again == worker);
+
+    bool thrown = false;
+    try {
+      co_await conn->run([](sqlite &) -> int {
+        throw std::runtime_error("boom");
+      });
+    } catch (const std::runtime_error &) {
+      thrown = true;
+    }
+    CHECK(thrown);
+
+    conn.reset();
+    co_await pool->close_all();
+  });
+}
+
+TEST_CASE("sqlite async: pooled transactions") {
+  run_test([](asio::any_io_executor ex) -> asio::awaitable<void> {
+    pool_options options;
+    options.log_pool_exhaustion = false;
+    auto pool =
+        std::make_shared<async_connection_pool<sqlite_async>>(ex, options);
+    bool ok = co_await pool->init(1, "", "", "", async_db);
+    REQUIRE(ok);
+    {
+      auto conn = co_await pool->get();
+      co_await conn->execute("drop table if exists async_person");
+      ormpp_auto_key key{"id"};
+      ok = co_await conn->create_datatable<async_person>(key);
+      REQUIRE(ok);
+    }
+
+    auto tx = co_await pool->transaction();
+    REQUIRE(tx);
+    async_person tom{0, "tom", 20};
+    int n = co_await tx->insert(tom);
+    CHECK(n == 1);
+    ok = co_await tx.commit();
+    CHECK(ok);
+    CHECK(!tx);
+
+    tx = co_await pool->transaction();
+    REQUIRE(tx);
+    async_person jack{0, "jack", 30};
+    n = co_await tx->insert(jack);
+    CHECK(n == 1);
+    ok = co_await tx.rollback();
+    CHECK(ok);
+
+    // abandoned by an exception, rolled back before the connection returns
+    try {
+      auto scoped = co_await pool->transaction();
+      REQUIRE(scoped);
+      async_person mike{0, "mike", 40};
+      co_await scoped->insert(mike);
+      throw std::runtime_error("abandon");
+    } catch (const std::runtime_error &) {
+    }
+
+    auto conn = co_await pool->get();
+    REQUIRE(conn != nullptr);
+    auto people = co_await conn->query_s<async_person>();
+    REQUIRE(people.size() == 1);
+    CHECK(people.front().name == "tom");
+    co_await conn->execute("drop table if exists async_person");
+    conn.reset();
+    co_await pool->close_all();
+  });
+}
+
+TEST_CASE("sqlite async: pool maintenance reaps idle connections") {
+  run_test([](asio::any_io_executor ex) -> asio::awaitable<void> {
+    pool_options options;
+    options.log_pool_exhaustion = false;
+    options.health_check_interval = std::chrono::seconds(1);
+    options.max_idle_time = std::chrono::seconds(1);
+    options.min_connections = 1;
+    auto pool =
+        std::make_shared<async_connection_pool<sqlite_async>>(ex, options);
+    bool ok = co_await pool->init(3, "", "", "", async_db);
+    REQUIRE(ok);
+
+    asio::steady_timer timer(ex);
+    timer.expires_after(std::chrono::milliseconds(2500));
+    co_await timer.async_wait(asio::use_awaitable);
+    auto [total, available, in_use, dynamic] = co_await pool->get_stats();
+    CHECK(total == 3);
+    CHECK(available == 1);
+
+    // reaped connections are replaced on demand, up to the pool size
+    std::vector<std::shared_ptr<sqlite_async>> conns;
+    for (int i = 0; i < 3; ++i) {
+      auto conn = co_await pool->try_get();
+      if (!conn) {
+        conn = co_await pool->get(std::chrono::seconds(1));
+      }
+      REQUIRE(conn != nullptr);
+      conns.push_back(std::move(conn));
+    }
+    auto none = co_await pool->try_get();
+    CHECK(none == nullptr);
+    auto stats = co_await pool->get_stats();
+    CHECK(std::get<2>(stats) == 3);
+    CHECK(std::get<3>(stats) == 0);
+
+    conns.clear();
+    co_await pool->close_all();
+  });
+}
+
+TEST_CASE("sqlite async: sharded pool checks out locally and steals") {
+  asio::io_context ctx0;
+  asio::io_context ctx1;
+  auto guard0 = asio::make_work_guard(ctx0);
+  auto guard1 = asio::make_work_guard(ctx1);
+  std::thread t0([&] {
+    ctx0.run();
+  });
+  std::thread t1([&] {
+    ctx1.run();
+  });
+
+  pool_options options;
+  options.log_pool_exhaustion = false;
+  std::vector<asio::any_io_executor> executors{ctx0.get_executor(),
+                                               ctx1.get_executor()};
+  sharded_async_connection_pool<sqlite_async> pool(executors, options);
+  CHECK(pool.shard_count() == 2);
+
+  auto fut = asio::co_spawn(
+      ctx0,
+      [&]() -> asio::awaitable<void> {
+        bool ok = co_await pool.init(1, "", "", "", async_db);
+        REQUIRE(ok);
+
+        auto local = co_await pool.get();
+        REQUIRE(local != nullptr);
+        CHECK(pool.steal_count() == 0);
+        auto stolen = co_await pool.get();
+        REQUIRE(stolen != nullptr);
+        CHECK(pool.steal_count() == 1);
+        auto [total, available, in_use, dynamic] = co_await pool.get_stats();
+        CHECK(total == 2);
+        CHECK(available == 0);
+        CHECK(in_use == 2);
+
+        bool done =
+            co_await stolen->execute("drop table if exists no_such_table");
+        CHECK(done);
+        stolen.reset();
+        local.reset();
+        local = co_await pool.get();
+        REQUIRE(local != nullptr);
+        CHECK(pool.steal_count() == 1);
+        local.reset();
+
+        co_await pool.close_all();
+      },
+      asio::use_future);
+  fut.get();
+
+  guard0.reset();
+  guard1.reset();
+  t0.join();
+  t1.join();
+}
+
+TEST_CASE("sqlite async: parallel query over the pool") {
+  run_test([](asio::any_io_executor ex) -> asio::awaitable<void> {
+    pool_options options;
+    options.log_pool_exhaustion = false;
+    auto pool =
+        std::make_shared<async_connection_pool<sqlite_async>>(ex, options);
+    bool ok = co_await pool->init(3, "", "", "", async_db);
+    REQUIRE(ok);
+    {
+      auto conn = co_await pool->get();
+      co_await conn->execute("drop table if exists async_person");
+      ormpp_auto_key key{"id"};
+      ok = co_await conn->create_datatable<async_person>(key);
+      REQUIRE(ok);
+      std::vector<async_person> people;
+      for (int i = 0; i < 50; ++i) {
+        people.push_back({0, "p" + std::to_string(i), i});
+      }
+      int n = co_await conn->insert(people);
+      REQUIRE(n == 50);
+    }
+
+    std::vector<std::pair<int, int>> ranges;
+    for (int i = 1; i <= 50; i += 5) {
+      ranges.emplace_back(i, i + 5);
+    }
+    auto slice = [](sqlite_async &db, const std::pair<int, int> &r)
+        -> asio::awaitable<std::vector<async_person>> {
+      co_return co_await db.query_s<async_person>(
+          "id >= ? and id < ? order by id", r.first, r.second);
+    };
+    auto query = parallel_query(*pool, ranges, slice, 3);
+    auto rows = co_await std::move(query);
+    REQUIRE(rows.size() == 50);
+    for (int i = 0; i < 50; ++i) {
+      CHECK(rows[i].id == i + 1);
+    }
+
+    auto failing = [](sqlite_async &db, const std::pair<int, int> &r)
+        -> asio::awaitable<std::vector<async_person>> {
+      if (r.first > 20) {
+        throw std::runtime_error("slice failed");
+      }
+      co_return co_await db.query_s<async_person>("id >= ? and id < ?",
+                                                  r.first, r.second);
+    };
+    bool thrown = false;
+    try {
+      auto op = parallel_query(*pool, ranges, failing, 3);
+      co_await std::move(op);
+    } catch (const std::runtime_error &) {
+      thrown = true;
+    }
+    CHECK(thrown);
+
+    // a failed query returns no rows, it must not pass for an empty slice
+    auto missing = [](sqlite_async &db, const std::pair<int, int> &r)
+        -> asio::awaitable<std::vector<async_person>> {
+      if (r.first > 20) {
+        co_return co_await db.query_s<async_person>("no_such_column = ?",
+                                                    r.first);
+      }
+      co_return co_await db.query_s<async_person>("id >= ? and id < ?",
+                                                  r.first, r.second);
+    };
+    size_t failed_task = 0;
+    try {
+      auto op = parallel_query(*pool, ranges, missing, 3);
+      co_await std::move(op);
+    } catch (const parallel_query_error &e) {
+      failed_task = e.task;
+    }
+    CHECK(failed_task > 3);
+    auto stats = co_await pool->get_stats();
+    CHECK(std::get<1>(stats) == 3);
+
+    // a pool that throws while handing out connections
+    struct broken_pool {
+      asio::awaitable<std::shared_ptr<sqlite_async>> get() {
+        throw std::runtime_error("pool failed");
+        co_return nullptr;
+      }
+    } broken;
+    thrown = false;
+    try {
+      auto op = parallel_query(broken, ranges, slice, 3);
+      co_await std::move(op);
+    } catch (const std::runtime_error &e) {
+      thrown = std::string(e.what()) == "pool failed";
+    }
+    CHECK(thrown);
+
+    auto conn = co_await pool->get();
+    co_await conn->execute("drop table if exists async_person");
+    conn.reset();
+    co_await pool->close_all();
+  });
+}
+
+#endif